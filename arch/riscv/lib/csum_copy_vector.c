@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Vector accelerated copy and checksum
+ *
+ * The loop loads the source as bytes, so it does not care about alignment,
+ * optionally stores the bytes to the destination and adds them up as 16 bit
+ * words into 32 bit accumulators, all from the same vector registers.  This
+ * only needs Zve32x, so it is usable wherever has_vector() is true.
+ *
+ * The user copy variants run the same loop with the user side accesses
+ * covered by the exception table, like the vector uaccess routines.  Page
+ * faults are disabled meanwhile, so a fault ends the loop at once and the
+ * scalar uaccess routines copy and checksum whatever is left.
+ */
+
+#include <linux/export.h>
+#include <linux/instrumented.h>
+#include <linux/kernel.h>
+#include <linux/sizes.h>
+#include <linux/uaccess.h>
+
+#include <asm/asm-extable.h>
+#include <asm/checksum.h>
+#include <asm/simd.h>
+#include <asm/vector.h>
+
+/* Below this the vector context switch costs more than it saves */
+#define CSUM_VECTOR_THRESHOLD	256
+
+/*
+ * Each accumulator element, and their sum, must not overflow 32 bits.  At
+ * most 65536 words of 0xffff are added up per block, which fits.
+ */
+#define CSUM_VECTOR_BLOCK	SZ_128K
+
+static inline u64 csum_vector_fold64(u64 sum)
+{
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	sum = (sum & 0xffffffff) + (sum >> 32);
+	return sum;
+}
+
+/*
+ * Add up @words little endian 16 bit words at @src, copying them to @dst
+ * as well unless it is NULL.  @words must not exceed CSUM_VECTOR_BLOCK / 2.
+ */
+static u32 csum_vector_block(const u8 *src, u8 *dst, unsigned long words)
+{
+	unsigned long vl, bytes;
+	unsigned long sum;
+
+	asm volatile (
+		".option push\n\t"
+		".option arch, +zve32x\n\t"
+		"vsetvli	%[vl], x0, e32, m8, ta, ma\n\t"
+		"vmv.v.i	v8, 0\n"
+		"1:\n\t"
+		"vsetvli	%[vl], %[words], e16, m4, ta, ma\n\t"
+		"slli		%[bytes], %[vl], 1\n\t"
+		"vsetvli	x0, %[bytes], e8, m4, ta, ma\n\t"
+		"vle8.v		v0, (%[src])\n\t"
+		"beqz		%[dst], 2f\n\t"
+		"vse8.v		v0, (%[dst])\n\t"
+		"add		%[dst], %[dst], %[bytes]\n"
+		"2:\n\t"
+		"vsetvli	x0, %[vl], e16, m4, tu, ma\n\t"
+		"vwaddu.wv	v8, v8, v0\n\t"
+		"add		%[src], %[src], %[bytes]\n\t"
+		"sub		%[words], %[words], %[vl]\n\t"
+		"bnez		%[words], 1b\n\t"
+		"vsetvli	%[vl], x0, e32, m8, ta, ma\n\t"
+		"vmv.s.x	v16, x0\n\t"
+		"vredsum.vs	v16, v8, v16\n\t"
+		"vmv.x.s	%[sum], v16\n\t"
+		".option pop\n\t"
+		: [src] "+r" (src), [dst] "+r" (dst), [words] "+r" (words),
+		  [vl] "=&r" (vl), [bytes] "=&r" (bytes), [sum] "=&r" (sum)
+		:
+		: "memory");
+
+	return (u32)sum;
+}
+
+/*
+ * Checksum @len bytes at @src and copy them to @dst unless it is NULL, in a
+ * single pass.  The caller has to own the vector unit.
+ */
+static __wsum csum_vector(const void *src, void *dst, int len, __wsum wsum)
+{
+	const u8 *s = src;
+	u8 *d = dst;
+	u64 sum = (__force u32)wsum;
+	unsigned int n;
+
+	while (len > 1) {
+		n = min_t(unsigned int, len & ~1, CSUM_VECTOR_BLOCK);
+		sum += csum_vector_block(s, d, n / 2);
+		s += n;
+		if (d)
+			d += n;
+		len -= n;
+	}
+
+	/* A trailing odd byte is the low half of a little endian word */
+	if (len) {
+		if (d)
+			*d = *s;
+		sum += *s;
+	}
+
+	return (__force __wsum)csum_vector_fold64(sum);
+}
+
+static bool csum_vector_usable(int len)
+{
+	return has_vector() && len >= CSUM_VECTOR_THRESHOLD && may_use_simd();
+}
+
+__wsum csum_partial_copy_nocheck(const void *src, void *dst, int len)
+{
+	__wsum sum;
+
+	if (!csum_vector_usable(len)) {
+		memcpy(dst, src, len);
+		return csum_partial(dst, len, 0);
+	}
+
+	kernel_vector_begin();
+	sum = csum_vector(src, dst, len, 0);
+	kernel_vector_end();
+
+	return sum;
+}
+EXPORT_SYMBOL(csum_partial_copy_nocheck);
+
+/*
+ * Same as csum_vector_block() with one of @src and @dst in user space, and
+ * @dst always set.  A fault on either ends the loop; the sum of the words
+ * copied until then is stored in @sum and the number of words left, those
+ * of the faulting step included, is returned.
+ */
+static unsigned long csum_vector_user_block(const u8 *src, u8 *dst,
+					    unsigned long words, u32 *sum)
+{
+	unsigned long vl, bytes;
+	unsigned long res;
+
+	asm volatile (
+		".option push\n\t"
+		".option arch, +zve32x\n\t"
+		"vsetvli	%[vl], x0, e32, m8, ta, ma\n\t"
+		"vmv.v.i	v8, 0\n"
+		"1:\n\t"
+		"vsetvli	%[vl], %[words], e16, m4, ta, ma\n\t"
+		"slli		%[bytes], %[vl], 1\n\t"
+		"vsetvli	x0, %[bytes], e8, m4, ta, ma\n"
+		"2:\n\t"
+		"vle8.v		v0, (%[src])\n"
+		"3:\n\t"
+		"vse8.v		v0, (%[dst])\n\t"
+		"vsetvli	x0, %[vl], e16, m4, tu, ma\n\t"
+		"vwaddu.wv	v8, v8, v0\n\t"
+		"add		%[src], %[src], %[bytes]\n\t"
+		"add		%[dst], %[dst], %[bytes]\n\t"
+		"sub		%[words], %[words], %[vl]\n\t"
+		"bnez		%[words], 1b\n"
+		"4:\n\t"
+		"vsetvli	%[vl], x0, e32, m8, ta, ma\n\t"
+		"vmv.s.x	v16, x0\n\t"
+		"vredsum.vs	v16, v8, v16\n\t"
+		"vmv.x.s	%[res], v16\n\t"
+		".option pop\n\t"
+		_ASM_EXTABLE(2b, 4b)
+		_ASM_EXTABLE(3b, 4b)
+		: [src] "+r" (src), [dst] "+r" (dst), [words] "+r" (words),
+		  [vl] "=&r" (vl), [bytes] "=&r" (bytes), [res] "=&r" (res)
+		:
+		: "memory");
+
+	*sum = (u32)res;
+	return words;
+}
+
+/*
+ * Checksum and copy @len bytes between a kernel and a user buffer, which
+ * the caller has checked with access_ok().  The sum of the bytes copied is
+ * added to *@wsum and the number of bytes left after a fault is returned.
+ * Those start at an even offset, so the scalar code can simply go on.
+ */
+static int csum_vector_user(const void *src, void *dst, int len, __wsum *wsum)
+{
+	const u8 *s = src;
+	u8 *d = dst;
+	u64 sum = (__force u32)*wsum;
+	unsigned long left;
+	unsigned int n;
+	u32 part;
+
+	kernel_vector_begin();
+	pagefault_disable();
+	__enable_user_access();
+
+	while (len > 1) {
+		n = min_t(unsigned int, len & ~1, CSUM_VECTOR_BLOCK);
+		left = csum_vector_user_block(s, d, n / 2, &part);
+		sum += part;
+		n -= left * 2;
+		s += n;
+		d += n;
+		len -= n;
+		if (left)
+			break;
+	}
+
+	__disable_user_access();
+	pagefault_enable();
+	kernel_vector_end();
+
+	*wsum = (__force __wsum)csum_vector_fold64(sum);
+	return len;
+}
+
+__wsum csum_and_copy_to_user(const void *src, void __user *dst, int len)
+{
+	__wsum sum = ~0U;
+	int done = 0;
+
+	if (!access_ok(dst, len))
+		return 0;
+
+	if (csum_vector_usable(len)) {
+		instrument_copy_to_user(dst, src, len);
+		done = len - csum_vector_user(src, (void __force *)dst, len,
+					      &sum);
+	}
+
+	if (copy_to_user(dst + done, src + done, len - done))
+		return 0;
+	return csum_partial(src + done, len - done, sum);
+}
+EXPORT_SYMBOL(csum_and_copy_to_user);
+
+__wsum csum_and_copy_from_user(const void __user *src, void *dst, int len)
+{
+	__wsum sum = ~0U;
+	int done = 0;
+
+	if (!access_ok(src, len))
+		return 0;
+
+	if (csum_vector_usable(len)) {
+		instrument_copy_from_user_before(dst, src, len);
+		done = len - csum_vector_user((const void __force *)src, dst,
+					      len, &sum);
+		instrument_copy_from_user_after(dst, src, len, len - done);
+	}
+
+	if (copy_from_user(dst + done, src + done, len - done))
+		return 0;
+	return csum_partial(dst + done, len - done, sum);
+}
+EXPORT_SYMBOL(csum_and_copy_from_user);
@@ -61,6 +61,96 @@ static void crypto_finalize_request(struct crypto_engine *engine,
 	kthread_queue_work(engine->kworker, &engine->pump_requests);
 }
 
+static struct crypto_engine_op *
+crypto_engine_req_op(struct crypto_async_request *req)
+{
+	struct crypto_engine_alg *alg;
+
+	if (!(req->tfm->__crt_alg->cra_flags & CRYPTO_ALG_ENGINE))
+		return NULL;
+
+	alg = container_of(req->tfm->__crt_alg, struct crypto_engine_alg, base);
+	return &alg->op;
+}
+
+/*
+ * Dequeue the requests following @req that belong to an algorithm with the
+ * same operations, up to the batch size.  Must hold the queue lock.
+ */
+static unsigned int crypto_engine_collect_batch(struct crypto_engine *engine,
+						struct crypto_engine_op *op,
+						struct crypto_async_request *req,
+						struct crypto_async_request *backlog)
+{
+	struct crypto_async_request *next;
+	unsigned int nreqs = 0;
+
+	lockdep_assert_held(&engine->queue_lock);
+
+	engine->batch[nreqs] = req;
+	engine->batch_backlog[nreqs++] = backlog;
+
+	while (nreqs < engine->batch_max && crypto_queue_len(&engine->queue)) {
+		next = list_first_entry(&engine->queue.list,
+					struct crypto_async_request, list);
+		if (crypto_engine_req_op(next) != op)
+			break;
+
+		engine->batch_backlog[nreqs] = crypto_get_backlog(&engine->queue);
+		engine->batch[nreqs++] = crypto_dequeue_request(&engine->queue);
+	}
+
+	return nreqs;
+}
+
+/*
+ * Hand the collected batch to the driver, or fail it with @err.  Returns
+ * false if the hardware did not take all of it and the rest has been put
+ * back at the head of the engine queue.
+ */
+static bool crypto_engine_run_batch(struct crypto_engine *engine,
+				    struct crypto_engine_op *op,
+				    unsigned int nreqs, int err)
+{
+	unsigned int done, i;
+	unsigned long flags;
+	int ret = err;
+
+	if (!ret) {
+		ret = op->do_many_requests(engine, engine->batch, nreqs);
+		if (ret < 0)
+			dev_err(engine->dev,
+				"Failed to do %u requests from queue: %d\n",
+				nreqs, ret);
+	}
+
+	if (ret < 0) {
+		for (i = 0; i < nreqs; i++)
+			crypto_request_complete(engine->batch[i], ret);
+		done = nreqs;
+	} else {
+		done = min_t(unsigned int, ret, nreqs);
+	}
+
+	if (done < nreqs) {
+		/* Requeue in reverse so the queue keeps the original order */
+		spin_lock_irqsave(&engine->queue_lock, flags);
+		for (i = nreqs; i-- > done;)
+			crypto_enqueue_request_head(&engine->queue,
+						    engine->batch[i]);
+		kthread_queue_work(engine->kworker, &engine->pump_requests);
+		spin_unlock_irqrestore(&engine->queue_lock, flags);
+	}
+
+	for (i = 0; i < done; i++) {
+		if (engine->batch_backlog[i])
+			crypto_request_complete(engine->batch_backlog[i],
+						-EINPROGRESS);
+	}
+
+	return done == nreqs;
+}
+
 /**
  * crypto_pump_requests - dequeue one request from engine queue to process
  * @engine: the hardware engine
@@ -74,10 +164,10 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 				 bool in_kthread)
 {
 	struct crypto_async_request *async_req, *backlog;
-	struct crypto_engine_alg *alg;
 	struct crypto_engine_op *op;
 	unsigned long flags;
 	bool was_busy = false;
+	unsigned int nreqs;
 	int ret;
 
 	spin_lock_irqsave(&engine->queue_lock, flags);
@@ -132,6 +222,16 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 	if (!engine->retry_support)
 		engine->cur_req = async_req;
 
+	/*
+	 * In batch mode, take the following requests for the same algorithm
+	 * along, so that the driver can submit them to the hardware together.
+	 */
+	op = crypto_engine_req_op(async_req);
+	nreqs = 1;
+	if (engine->batch_max > 1 && op && op->do_many_requests)
+		nreqs = crypto_engine_collect_batch(engine, op, async_req,
+						    backlog);
+
 	if (engine->busy)
 		was_busy = true;
 	else
@@ -140,19 +240,26 @@ static void crypto_pump_requests(struct crypto_engine *engine,
 	spin_unlock_irqrestore(&engine->queue_lock, flags);
 
 	/* Until here we get the request need to be encrypted successfully */
+	ret = 0;
 	if (!was_busy && engine->prepare_crypt_hardware) {
 		ret = engine->prepare_crypt_hardware(engine);
-		if (ret) {
+		if (ret)
 			dev_err(engine->dev, "failed to prepare crypt hardware\n");
-			goto req_err_1;
-		}
 	}
 
-	if (async_req->tfm->__crt_alg->cra_flags & CRYPTO_ALG_ENGINE) {
-		alg = container_of(async_req->tfm->__crt_alg,
-				   struct crypto_engine_alg, base);
-		op = &alg->op;
-	} else {
+	if (nreqs > 1) {
+		bool all_done = crypto_engine_run_batch(engine, op, nreqs, ret);
+
+		spin_lock_irqsave(&engine->queue_lock, flags);
+		if (!all_done)
+			goto out;
+		goto start_request;
+	}
+
+	if (ret)
+		goto req_err_1;
+
+	if (!op) {
 		dev_err(engine->dev, "failed to do request\n");
 		ret = -EINVAL;
 		goto req_err_1;
@@ -402,6 +509,31 @@ void crypto_finalize_skcipher_request(struct crypto_engine *engine,
 }
 EXPORT_SYMBOL_GPL(crypto_finalize_skcipher_request);
 
+/**
+ * crypto_finalize_requests - finalize a batch of requests that are done
+ * @engine: the hardware engine, which must have retry support
+ * @areqs: the requests that are done
+ * @errs: error number of each request, or NULL if all of them succeeded
+ * @nreqs: number of requests in @areqs
+ *
+ * Completes all requests and then kicks the request pump once for the
+ * whole batch instead of once per request.
+ */
+void crypto_finalize_requests(struct crypto_engine *engine, void *areqs[],
+			      const int errs[], unsigned int nreqs)
+{
+	unsigned int i;
+
+	WARN_ON_ONCE(!engine->retry_support);
+
+	lockdep_assert_in_softirq();
+	for (i = 0; i < nreqs; i++)
+		crypto_request_complete(areqs[i], errs ? errs[i] : 0);
+
+	kthread_queue_work(engine->kworker, &engine->pump_requests);
+}
+EXPORT_SYMBOL_GPL(crypto_finalize_requests);
+
 /**
  * crypto_engine_start - start the hardware engine
  * @engine: the hardware engine need to be started
@@ -549,6 +681,30 @@ struct crypto_engine *crypto_engine_alloc_init(struct device *dev, bool rt)
 }
 EXPORT_SYMBOL_GPL(crypto_engine_alloc_init);
 
+/**
+ * crypto_engine_set_batch - hand requests to the driver in batches
+ * @engine: the hardware engine, which must have retry support
+ * @max_reqs: maximum number of requests per batch, at most
+ * CRYPTO_ENGINE_MAX_BATCH
+ *
+ * Requests for algorithms that implement do_many_requests are then handed
+ * to the driver up to @max_reqs at a time. Must be called before the engine
+ * is started.
+ *
+ * Return 0 on success, else on fail.
+ */
+int crypto_engine_set_batch(struct crypto_engine *engine,
+			    unsigned int max_reqs)
+{
+	if (!engine->retry_support || !max_reqs ||
+	    max_reqs > CRYPTO_ENGINE_MAX_BATCH)
+		return -EINVAL;
+
+	engine->batch_max = max_reqs;
+	return 0;
+}
+EXPORT_SYMBOL_GPL(crypto_engine_set_batch);
+
 /**
  * crypto_engine_exit - free the resources of hardware engine when exit
  * @engine: the hardware engine need to be freed
@@ -0,0 +1,352 @@
+// SPDX-License-Identifier: GPL-2.0-or-later
+/*
+ * Virtual crypto engine
+ *
+ * A software-only driver built on the crypto engine, for exercising and
+ * measuring the engine without hardware.  It registers two async
+ * "cbc(aes)" implementations backed by a synchronous software fallback:
+ *
+ *   cbc-aes-vengine-single: one request at a time, the classic engine mode
+ *   cbc-aes-vengine-batch:  batch mode, requests are submitted to the
+ *                           "hardware" ring and completed in bulk
+ *
+ * The "hardware" is a ring of hw_depth requests that is processed from a
+ * work item, which stands in for the completion interrupt.  Both have a low
+ * priority so they are only used when asked for by driver name, e.g. with
+ * tcrypt mode=611.
+ */
+
+#include <crypto/aes.h>
+#include <crypto/engine.h>
+#include <crypto/internal/engine.h>
+#include <crypto/internal/skcipher.h>
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/platform_device.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+#define VENGINE_QLEN	256
+
+static unsigned int batch = 16;
+module_param(batch, uint, 0444);
+MODULE_PARM_DESC(batch, "Maximum number of requests per batch of the batch engine");
+
+static unsigned int hw_depth = 32;
+module_param(hw_depth, uint, 0444);
+MODULE_PARM_DESC(hw_depth, "Number of requests the virtual hardware can hold");
+
+struct vengine_dev {
+	struct crypto_engine *engine;
+	bool batch;
+
+	spinlock_t lock;
+	struct list_head ring;		/* requests accepted by the hardware */
+	unsigned int inflight;
+	struct work_struct irq_work;
+};
+
+struct vengine_alg {
+	struct skcipher_engine_alg alg;
+	struct vengine_dev vdev;
+};
+
+struct vengine_tfm_ctx {
+	struct crypto_skcipher *fallback;
+};
+
+struct vengine_reqctx {
+	struct list_head node;
+	struct skcipher_request *req;
+	bool enc;
+	struct skcipher_request fallback_req;	/* keep at the end */
+};
+
+static struct platform_device *vengine_pdev;
+
+static struct vengine_dev *vengine_dev_of(struct crypto_skcipher *tfm)
+{
+	struct skcipher_engine_alg *ealg =
+		container_of(crypto_skcipher_alg(tfm), struct skcipher_engine_alg, base);
+
+	return &container_of(ealg, struct vengine_alg, alg)->vdev;
+}
+
+static int vengine_run(struct skcipher_request *req)
+{
+	struct crypto_skcipher *tfm = crypto_skcipher_reqtfm(req);
+	struct vengine_tfm_ctx *ctx = crypto_skcipher_ctx(tfm);
+	struct vengine_reqctx *rctx = skcipher_request_ctx(req);
+
+	skcipher_request_set_tfm(&rctx->fallback_req, ctx->fallback);
+	skcipher_request_set_callback(&rctx->fallback_req, 0, NULL, NULL);
+	skcipher_request_set_crypt(&rctx->fallback_req, req->src, req->dst,
+				   req->cryptlen, req->iv);
+
+	return rctx->enc ? crypto_skcipher_encrypt(&rctx->fallback_req) :
+			   crypto_skcipher_decrypt(&rctx->fallback_req);
+}
+
+/* Process everything on the ring, as if the hardware raised an interrupt */
+static void vengine_irq_work(struct work_struct *work)
+{
+	struct vengine_dev *vdev = container_of(work, struct vengine_dev, irq_work);
+	void *areqs[CRYPTO_ENGINE_MAX_BATCH];
+	int errs[CRYPTO_ENGINE_MAX_BATCH];
+	struct vengine_reqctx *rctx, *tmp;
+	struct skcipher_request *req;
+	unsigned int n = 0;
+	LIST_HEAD(done);
+
+	spin_lock_bh(&vdev->lock);
+	list_splice_init(&vdev->ring, &done);
+	spin_unlock_bh(&vdev->lock);
+
+	list_for_each_entry_safe(rctx, tmp, &done, node) {
+		req = rctx->req;
+		list_del(&rctx->node);
+
+		errs[n] = vengine_run(req);
+
+		spin_lock_bh(&vdev->lock);
+		vdev->inflight--;
+		spin_unlock_bh(&vdev->lock);
+
+		local_bh_disable();
+		if (!vdev->batch) {
+			crypto_finalize_skcipher_request(vdev->engine, req, errs[n]);
+		} else {
+			areqs[n++] = &req->base;
+			if (n == ARRAY_SIZE(areqs) || list_empty(&done)) {
+				crypto_finalize_requests(vdev->engine, areqs,
+							 errs, n);
+				n = 0;
+			}
+		}
+		local_bh_enable();
+	}
+}
+
+/* Put up to @nreqs requests on the ring, returns how many fit */
+static unsigned int vengine_submit(struct vengine_dev *vdev, void *areqs[],
+				   unsigned int nreqs)
+{
+	struct skcipher_request *req;
+	struct vengine_reqctx *rctx;
+	unsigned int i;
+
+	spin_lock_bh(&vdev->lock);
+	nreqs = min(nreqs, hw_depth - vdev->inflight);
+	for (i = 0; i < nreqs; i++) {
+		req = container_of(areqs[i], struct skcipher_request, base);
+		rctx = skcipher_request_ctx(req);
+		list_add_tail(&rctx->node, &vdev->ring);
+	}
+	vdev->inflight += nreqs;
+	spin_unlock_bh(&vdev->lock);
+
+	if (nreqs)
+		queue_work(system_unbound_wq, &vdev->irq_work);
+
+	return nreqs;
+}
+
+static int vengine_do_one_request(struct crypto_engine *engine, void *areq)
+{
+	struct skcipher_request *req =
+		container_of(areq, struct skcipher_request, base);
+	struct vengine_dev *vdev = vengine_dev_of(crypto_skcipher_reqtfm(req));
+
+	return vengine_submit(vdev, &areq, 1) ? 0 : -ENOSPC;
+}
+
+static int vengine_do_many_requests(struct crypto_engine *engine,
+				    void *areqs[], unsigned int nreqs)
+{
+	struct skcipher_request *req =
+		container_of(areqs[0], struct skcipher_request, base);
+	struct vengine_dev *vdev = vengine_dev_of(crypto_skcipher_reqtfm(req));
+
+	return vengine_submit(vdev, areqs, nreqs);
+}
+
+static int vengine_crypt(struct skcipher_request *req, bool enc)
+{
+	struct vengine_dev *vdev = vengine_dev_of(crypto_skcipher_reqtfm(req));
+	struct vengine_reqctx *rctx = skcipher_request_ctx(req);
+
+	rctx->req = req;
+	rctx->enc = enc;
+	return crypto_transfer_skcipher_request_to_engine(vdev->engine, req);
+}
+
+static int vengine_encrypt(struct skcipher_request *req)
+{
+	return vengine_crypt(req, true);
+}
+
+static int vengine_decrypt(struct skcipher_request *req)
+{
+	return vengine_crypt(req, false);
+}
+
+static int vengine_setkey(struct crypto_skcipher *tfm, const u8 *key,
+			  unsigned int keylen)
+{
+	struct vengine_tfm_ctx *ctx = crypto_skcipher_ctx(tfm);
+
+	crypto_skcipher_clear_flags(ctx->fallback, CRYPTO_TFM_REQ_MASK);
+	crypto_skcipher_set_flags(ctx->fallback, crypto_skcipher_get_flags(tfm) &
+						 CRYPTO_TFM_REQ_MASK);
+	return crypto_skcipher_setkey(ctx->fallback, key, keylen);
+}
+
+static int vengine_init_tfm(struct crypto_skcipher *tfm)
+{
+	struct vengine_tfm_ctx *ctx = crypto_skcipher_ctx(tfm);
+
+	ctx->fallback = crypto_alloc_skcipher(crypto_tfm_alg_name(&tfm->base), 0,
+					      CRYPTO_ALG_ASYNC |
+					      CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback))
+		return PTR_ERR(ctx->fallback);
+
+	crypto_skcipher_set_reqsize(tfm, sizeof(struct vengine_reqctx) +
+				    crypto_skcipher_reqsize(ctx->fallback));
+	return 0;
+}
+
+static void vengine_exit_tfm(struct crypto_skcipher *tfm)
+{
+	struct vengine_tfm_ctx *ctx = crypto_skcipher_ctx(tfm);
+
+	crypto_free_skcipher(ctx->fallback);
+}
+
+#define VENGINE_CBC_AES(drv)						\
+{									\
+	.alg.base = {							\
+		.base = {						\
+			.cra_name	 = "cbc(aes)",			\
+			.cra_driver_name = "cbc-aes-vengine-" drv,	\
+			.cra_priority	 = 1,				\
+			.cra_flags	 = CRYPTO_ALG_ASYNC |		\
+					   CRYPTO_ALG_NEED_FALLBACK,	\
+			.cra_blocksize	 = AES_BLOCK_SIZE,		\
+			.cra_ctxsize	 = sizeof(struct vengine_tfm_ctx), \
+			.cra_module	 = THIS_MODULE,			\
+		},							\
+		.init		= vengine_init_tfm,			\
+		.exit		= vengine_exit_tfm,			\
+		.setkey		= vengine_setkey,			\
+		.encrypt	= vengine_encrypt,			\
+		.decrypt	= vengine_decrypt,			\
+		.min_keysize	= AES_MIN_KEY_SIZE,			\
+		.max_keysize	= AES_MAX_KEY_SIZE,			\
+		.ivsize		= AES_BLOCK_SIZE,			\
+	},								\
+	.alg.op = {							\
+		.do_one_request	= vengine_do_one_request,		\
+		.do_many_requests = vengine_do_many_requests,		\
+	},								\
+}
+
+static struct vengine_alg vengine_algs[] = {
+	VENGINE_CBC_AES("single"),
+	VENGINE_CBC_AES("batch"),
+};
+
+static int vengine_init_dev(struct vengine_dev *vdev, bool batch_mode)
+{
+	struct device *dev = &vengine_pdev->dev;
+	int err;
+
+	spin_lock_init(&vdev->lock);
+	INIT_LIST_HEAD(&vdev->ring);
+	INIT_WORK(&vdev->irq_work, vengine_irq_work);
+	vdev->batch = batch_mode;
+
+	/*
+	 * The single request engine has no retry support, so it keeps one
+	 * request in flight and is kicked once per completed request.
+	 */
+	vdev->engine = crypto_engine_alloc_init_and_set(dev, batch_mode, NULL,
+							false, VENGINE_QLEN);
+	if (!vdev->engine)
+		return -ENOMEM;
+
+	if (batch_mode) {
+		err = crypto_engine_set_batch(vdev->engine, batch);
+		if (err)
+			goto err_exit;
+	}
+
+	err = crypto_engine_start(vdev->engine);
+	if (err)
+		goto err_exit;
+
+	return 0;
+
+err_exit:
+	crypto_engine_exit(vdev->engine);
+	return err;
+}
+
+static int __init vengine_mod_init(void)
+{
+	int i, err;
+
+	if (!batch || batch > CRYPTO_ENGINE_MAX_BATCH || !hw_depth)
+		return -EINVAL;
+
+	vengine_pdev = platform_device_register_simple("crypto-vengine",
+						       PLATFORM_DEVID_NONE,
+						       NULL, 0);
+	if (IS_ERR(vengine_pdev))
+		return PTR_ERR(vengine_pdev);
+
+	for (i = 0; i < ARRAY_SIZE(vengine_algs); i++) {
+		err = vengine_init_dev(&vengine_algs[i].vdev, i == 1);
+		if (err)
+			goto err_engines;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(vengine_algs); i++) {
+		err = crypto_engine_register_skcipher(&vengine_algs[i].alg);
+		if (err)
+			goto err_algs;
+	}
+
+	return 0;
+
+err_algs:
+	while (i--)
+		crypto_engine_unregister_skcipher(&vengine_algs[i].alg);
+	i = ARRAY_SIZE(vengine_algs);
+err_engines:
+	while (i--)
+		crypto_engine_exit(vengine_algs[i].vdev.engine);
+	platform_device_unregister(vengine_pdev);
+	return err;
+}
+
+static void __exit vengine_mod_exit(void)
+{
+	int i;
+
+	for (i = ARRAY_SIZE(vengine_algs) - 1; i >= 0; i--) {
+		crypto_engine_unregister_skcipher(&vengine_algs[i].alg);
+		/* The irq work finalizes requests, which kicks the engine */
+		flush_work(&vengine_algs[i].vdev.irq_work);
+		crypto_engine_exit(vengine_algs[i].vdev.engine);
+	}
+	platform_device_unregister(vengine_pdev);
+}
+
+module_init(vengine_mod_init);
+module_exit(vengine_mod_exit);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("Virtual crypto engine for testing the crypto engine");
@@ -15,22 +15,55 @@
 #include <linux/slab.h>
 #include <linux/kobject.h>
 #include <linux/cpu.h>
+#include <linux/ktime.h>
+#include <linux/percpu.h>
+#include <linux/topology.h>
 #include <crypto/pcrypt.h>
 
 static struct padata_instance *pencrypt;
 static struct padata_instance *pdecrypt;
 static struct kset           *pcrypt_kset;
 
+static unsigned int parallel_depth = 2;
+module_param(parallel_depth, uint, 0644);
+MODULE_PARM_DESC(parallel_depth, "Average number of requests in flight from which requests are parallelized (0: always)");
+
+static bool cache_local = true;
+module_param(cache_local, bool, 0444);
+MODULE_PARM_DESC(cache_local, "Run requests in the cache domain of the submitting CPU and serialize them in that of the CPU that set up the transform");
+
+struct pcrypt_stats {
+	u64 inline_requests;
+	u64 parallel_requests;
+	u64 reordered;
+	u64 reorder_ns;
+};
+
+static DEFINE_PER_CPU(struct pcrypt_stats, pcrypt_stats);
+static atomic64_t pcrypt_reorder_max_ns;
+
+/*
+ * Load of one direction of an instance: the requests that are in padata
+ * right now, and a moving average of that number scaled by 8.
+ */
+struct pcrypt_load {
+	atomic_t inflight;
+	unsigned int depth_avg;
+};
+
 struct pcrypt_instance_ctx {
 	struct crypto_aead_spawn spawn;
 	struct padata_shell *psenc;
 	struct padata_shell *psdec;
 	atomic_t tfm_count;
+	struct pcrypt_load enc_load;
+	struct pcrypt_load dec_load;
 };
 
 struct pcrypt_aead_ctx {
 	struct crypto_aead *child;
 	unsigned int cb_cpu;
+	bool child_sync;
 };
 
 static inline struct pcrypt_instance_ctx *pcrypt_tfm_ictx(
@@ -55,12 +88,79 @@ static int pcrypt_aead_setauthsize(struct crypto_aead *parent,
 	return crypto_aead_setauthsize(ctx->child, authsize);
 }
 
+/*
+ * With little load, the padata round trip and the reorder step only add
+ * latency, so run the request in the submitting context.  This is only done
+ * with a synchronous child and nothing of this direction in flight, so that
+ * completions still come in submission order.
+ */
+static bool pcrypt_run_inline(struct pcrypt_aead_ctx *ctx,
+			      struct pcrypt_load *load)
+{
+	unsigned int threshold = READ_ONCE(parallel_depth);
+	unsigned int inflight = atomic_read(&load->inflight);
+	unsigned int avg = READ_ONCE(load->depth_avg);
+
+	avg = avg - (avg >> 3) + inflight;
+	WRITE_ONCE(load->depth_avg, avg);
+
+	return threshold && ctx->child_sync && !inflight &&
+	       avg < threshold * 8;
+}
+
+static int pcrypt_do_parallel(struct pcrypt_aead_ctx *ctx,
+			      struct padata_shell *ps,
+			      struct pcrypt_load *load,
+			      struct pcrypt_request *preq)
+{
+	struct padata_priv *padata = pcrypt_request_padata(preq);
+	int err;
+
+	preq->inflight = &load->inflight;
+	atomic_inc(&load->inflight);
+
+	err = padata_do_parallel(ps, padata, &ctx->cb_cpu);
+	if (err) {
+		atomic_dec(&load->inflight);
+		return err;
+	}
+
+	this_cpu_inc(pcrypt_stats.parallel_requests);
+	return 0;
+}
+
+static void pcrypt_account_reorder(struct pcrypt_request *preq)
+{
+	u64 ns = ktime_get_ns() - preq->done_ns;
+	s64 max = atomic64_read(&pcrypt_reorder_max_ns);
+
+	this_cpu_inc(pcrypt_stats.reordered);
+	this_cpu_add(pcrypt_stats.reorder_ns, ns);
+	while (ns > max &&
+	       !atomic64_try_cmpxchg(&pcrypt_reorder_max_ns, &max, ns))
+		;
+}
+
+static void pcrypt_do_serial(struct padata_priv *padata)
+{
+	pcrypt_padata_request(padata)->done_ns = ktime_get_ns();
+	padata_do_serial(padata);
+}
+
 static void pcrypt_aead_serial(struct padata_priv *padata)
 {
 	struct pcrypt_request *preq = pcrypt_padata_request(padata);
 	struct aead_request *req = pcrypt_request_ctx(preq);
+	atomic_t *inflight = preq->inflight;
 
+	pcrypt_account_reorder(preq);
 	aead_request_complete(req->base.data, padata->info);
+
+	/*
+	 * Only now may a new request run inline, or it could complete ahead
+	 * of this one.  The request is gone, hence the saved pointer.
+	 */
+	atomic_dec(inflight);
 }
 
 static void pcrypt_aead_done(void *data, int err)
@@ -71,7 +171,7 @@ static void pcrypt_aead_done(void *data, int err)
 
 	padata->info = err;
 
-	padata_do_serial(padata);
+	pcrypt_do_serial(padata);
 }
 
 static void pcrypt_aead_enc(struct padata_priv *padata)
@@ -86,7 +186,7 @@ static void pcrypt_aead_enc(struct padata_priv *padata)
 		return;
 
 	padata->info = ret;
-	padata_do_serial(padata);
+	pcrypt_do_serial(padata);
 }
 
 static int pcrypt_aead_encrypt(struct aead_request *req)
@@ -114,7 +214,12 @@ static int pcrypt_aead_encrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_ad(creq, req->assoclen);
 
-	err = padata_do_parallel(ictx->psenc, padata, &ctx->cb_cpu);
+	if (pcrypt_run_inline(ctx, &ictx->enc_load)) {
+		this_cpu_inc(pcrypt_stats.inline_requests);
+		return crypto_aead_encrypt(creq);
+	}
+
+	err = pcrypt_do_parallel(ctx, ictx->psenc, &ictx->enc_load, preq);
 	if (!err)
 		return -EINPROGRESS;
 	if (err == -EBUSY) {
@@ -137,7 +242,7 @@ static void pcrypt_aead_dec(struct padata_priv *padata)
 		return;
 
 	padata->info = ret;
-	padata_do_serial(padata);
+	pcrypt_do_serial(padata);
 }
 
 static int pcrypt_aead_decrypt(struct aead_request *req)
@@ -165,7 +270,12 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 			       req->cryptlen, req->iv);
 	aead_request_set_ad(creq, req->assoclen);
 
-	err = padata_do_parallel(ictx->psdec, padata, &ctx->cb_cpu);
+	if (pcrypt_run_inline(ctx, &ictx->dec_load)) {
+		this_cpu_inc(pcrypt_stats.inline_requests);
+		return crypto_aead_decrypt(creq);
+	}
+
+	err = pcrypt_do_parallel(ctx, ictx->psdec, &ictx->dec_load, preq);
 	if (!err)
 		return -EINPROGRESS;
 	if (err == -EBUSY) {
@@ -176,6 +286,25 @@ static int pcrypt_aead_decrypt(struct aead_request *req)
 	return err;
 }
 
+/* Spread the transforms over the cache domain of the CPU setting them up */
+static unsigned int pcrypt_local_cb_cpu(unsigned int index, unsigned int cpu)
+{
+#ifdef CONFIG_SCHED_MC
+	const struct cpumask *domain;
+	unsigned int weight, local;
+
+	domain = cpu_coregroup_mask(raw_smp_processor_id());
+	weight = cpumask_weight_and(domain, cpu_online_mask);
+	if (!weight)
+		return cpu;
+
+	local = cpumask_nth_and(index % weight, domain, cpu_online_mask);
+	if (local < nr_cpu_ids)
+		return local;
+#endif
+	return cpu;
+}
+
 static int pcrypt_aead_init_tfm(struct crypto_aead *tfm)
 {
 	int cpu, cpu_index;
@@ -191,12 +320,22 @@ static int pcrypt_aead_init_tfm(struct crypto_aead *tfm)
 	for (cpu = 0; cpu < cpu_index; cpu++)
 		ctx->cb_cpu = cpumask_next(ctx->cb_cpu, cpu_online_mask);
 
+	/*
+	 * padata keeps the completions of a transform in order only as long
+	 * as they are all serialized on the same CPU, so the cache domain is
+	 * picked here once and not per request.
+	 */
+	if (cache_local)
+		ctx->cb_cpu = pcrypt_local_cb_cpu(cpu_index, ctx->cb_cpu);
+
 	cipher = crypto_spawn_aead(&ictx->spawn);
 
 	if (IS_ERR(cipher))
 		return PTR_ERR(cipher);
 
 	ctx->child = cipher;
+	ctx->child_sync = !(crypto_aead_alg(cipher)->base.cra_flags &
+			    CRYPTO_ALG_ASYNC);
 	crypto_aead_set_reqsize(tfm, sizeof(struct pcrypt_request) +
 				     sizeof(struct aead_request) +
 				     crypto_aead_reqsize(cipher));
@@ -324,6 +463,73 @@ static int pcrypt_sysfs_add(struct padata_instance *pinst, const char *name)
 	return ret;
 }
 
+static void pcrypt_stats_sum(struct pcrypt_stats *sum)
+{
+	int cpu;
+
+	memset(sum, 0, sizeof(*sum));
+	for_each_possible_cpu(cpu) {
+		struct pcrypt_stats *st = per_cpu_ptr(&pcrypt_stats, cpu);
+
+		sum->inline_requests += st->inline_requests;
+		sum->parallel_requests += st->parallel_requests;
+		sum->reordered += st->reordered;
+		sum->reorder_ns += st->reorder_ns;
+	}
+}
+
+static ssize_t inline_requests_show(struct kobject *kobj,
+				    struct kobj_attribute *attr, char *buf)
+{
+	struct pcrypt_stats sum;
+
+	pcrypt_stats_sum(&sum);
+	return sysfs_emit(buf, "%llu\n", sum.inline_requests);
+}
+
+static ssize_t parallel_requests_show(struct kobject *kobj,
+				      struct kobj_attribute *attr, char *buf)
+{
+	struct pcrypt_stats sum;
+
+	pcrypt_stats_sum(&sum);
+	return sysfs_emit(buf, "%llu\n", sum.parallel_requests);
+}
+
+static ssize_t reorder_delay_avg_ns_show(struct kobject *kobj,
+					 struct kobj_attribute *attr, char *buf)
+{
+	struct pcrypt_stats sum;
+
+	pcrypt_stats_sum(&sum);
+	return sysfs_emit(buf, "%llu\n", sum.reordered ?
+			  div64_u64(sum.reorder_ns, sum.reordered) : 0);
+}
+
+static ssize_t reorder_delay_max_ns_show(struct kobject *kobj,
+					 struct kobj_attribute *attr, char *buf)
+{
+	return sysfs_emit(buf, "%lld\n", atomic64_read(&pcrypt_reorder_max_ns));
+}
+
+static struct kobj_attribute inline_requests_attr = __ATTR_RO(inline_requests);
+static struct kobj_attribute parallel_requests_attr = __ATTR_RO(parallel_requests);
+static struct kobj_attribute reorder_delay_avg_ns_attr = __ATTR_RO(reorder_delay_avg_ns);
+static struct kobj_attribute reorder_delay_max_ns_attr = __ATTR_RO(reorder_delay_max_ns);
+
+static struct attribute *pcrypt_stats_attrs[] = {
+	&inline_requests_attr.attr,
+	&parallel_requests_attr.attr,
+	&reorder_delay_avg_ns_attr.attr,
+	&reorder_delay_max_ns_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group pcrypt_stats_group = {
+	.name = "stats",
+	.attrs = pcrypt_stats_attrs,
+};
+
 static int pcrypt_init_padata(struct padata_instance **pinst, const char *name)
 {
 	int ret = -ENOMEM;
@@ -332,7 +538,9 @@ static int pcrypt_init_padata(struct padata_instance **pinst, const char *name)
 	if (!*pinst)
 		return ret;
 
-	ret = pcrypt_sysfs_add(*pinst, name);
+	ret = padata_set_cache_local(*pinst, cache_local);
+	if (!ret)
+		ret = pcrypt_sysfs_add(*pinst, name);
 	if (ret)
 		padata_free(*pinst);
 
@@ -353,6 +561,10 @@ static int __init pcrypt_init(void)
 	if (!pcrypt_kset)
 		goto err;
 
+	err = sysfs_create_group(&pcrypt_kset->kobj, &pcrypt_stats_group);
+	if (err)
+		goto err_unreg_kset;
+
 	err = pcrypt_init_padata(&pencrypt, "pencrypt");
 	if (err)
 		goto err_unreg_kset;
@@ -378,6 +590,7 @@ static void __exit pcrypt_exit(void)
 	padata_free(pencrypt);
 	padata_free(pdecrypt);
 
+	sysfs_remove_group(&pcrypt_kset->kobj, &pcrypt_stats_group);
 	kset_unregister(pcrypt_kset);
 }
 
@@ -55,7 +55,20 @@ static void crypto_scomp_show(struct seq_file *m, struct crypto_alg *alg)
 
 static void crypto_scomp_show(struct seq_file *m, struct crypto_alg *alg)
 {
+	struct scomp_alg *scomp = __crypto_scomp_alg(alg);
+	unsigned long direct = 0, bounced = 0;
+	struct scomp_stats *stats;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		stats = per_cpu_ptr(scomp->stats, cpu);
+		direct += READ_ONCE(stats->direct);
+		bounced += READ_ONCE(stats->bounced);
+	}
+
 	seq_puts(m, "type         : scomp\n");
+	seq_printf(m, "direct       : %lu\n", direct);
+	seq_printf(m, "bounced      : %lu\n", bounced);
 }
 
 static void crypto_scomp_free_scratches(void)
@@ -110,13 +123,52 @@ static int crypto_scomp_init_tfm(struct crypto_tfm *tfm)
 	return ret;
 }
 
+/*
+ * Return the linear kernel address of the first @len bytes described by @sg
+ * if they can be accessed in place, i.e. if all entries are lowmem and follow
+ * each other in the direct map.  This covers the common single-entry case as
+ * well as large folios that were added to the scatterlist page by page.
+ */
+static void *scomp_sg_virt(struct scatterlist *sg, unsigned int len)
+{
+	void *start, *end;
+
+	if (!sg || PageHighMem(sg_page(sg)))
+		return NULL;
+
+	start = sg_virt(sg);
+	end = start;
+	for (; sg; sg = sg_next(sg)) {
+		if (PageHighMem(sg_page(sg)) || sg_virt(sg) != end)
+			return NULL;
+		end += sg->length;
+		if (end - start >= len)
+			return start;
+	}
+
+	return NULL;
+}
+
+static void scomp_flush_dcache_sg(struct scatterlist *sg, unsigned int len)
+{
+	unsigned int i, n;
+
+	for (; sg && len; sg = sg_next(sg)) {
+		n = min(sg->length, len);
+		for (i = 0; i < DIV_ROUND_UP(sg->offset + n, PAGE_SIZE); i++)
+			flush_dcache_page(sg_page(sg) + i);
+		len -= n;
+	}
+}
+
 static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 {
 	struct crypto_acomp *tfm = crypto_acomp_reqtfm(req);
 	void **tfm_ctx = acomp_tfm_ctx(tfm);
 	struct crypto_scomp *scomp = *tfm_ctx;
+	struct scomp_alg *alg = crypto_scomp_alg(scomp);
 	void **ctx = acomp_request_ctx(req);
-	struct scomp_scratch *scratch;
+	struct scomp_scratch *scratch = NULL;
 	void *src, *dst;
 	unsigned int dlen;
 	int ret;
@@ -132,22 +184,27 @@ static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 
 	dlen = req->dlen;
 
-	scratch = raw_cpu_ptr(&scomp_scratch);
-	spin_lock(&scratch->lock);
-
-	if (sg_nents(req->src) == 1 && !PageHighMem(sg_page(req->src))) {
-		src = page_to_virt(sg_page(req->src)) + req->src->offset;
+	src = scomp_sg_virt(req->src, req->slen);
+	dst = scomp_sg_virt(req->dst, dlen);
+
+	/* The scratch buffers, and hence their lock, are only needed if
+	 * either side cannot be accessed in place.
+	 */
+	if (!src || !dst) {
+		scratch = raw_cpu_ptr(&scomp_scratch);
+		spin_lock(&scratch->lock);
+		if (!src) {
+			scatterwalk_map_and_copy(scratch->src, req->src, 0,
+						 req->slen, 0);
+			src = scratch->src;
+		}
+		if (!dst)
+			dst = scratch->dst;
+		this_cpu_inc(alg->stats->bounced);
 	} else {
-		scatterwalk_map_and_copy(scratch->src, req->src, 0,
-					 req->slen, 0);
-		src = scratch->src;
+		this_cpu_inc(alg->stats->direct);
 	}
 
-	if (req->dst && sg_nents(req->dst) == 1 && !PageHighMem(sg_page(req->dst)))
-		dst = page_to_virt(sg_page(req->dst)) + req->dst->offset;
-	else
-		dst = scratch->dst;
-
 	if (dir)
 		ret = crypto_scomp_compress(scomp, src, req->slen,
 					    dst, &req->dlen, *ctx);
@@ -165,20 +222,15 @@ static int scomp_acomp_comp_decomp(struct acomp_req *req, int dir)
 			ret = -ENOSPC;
 			goto out;
 		}
-		if (dst == scratch->dst) {
+		if (scratch && dst == scratch->dst)
 			scatterwalk_map_and_copy(scratch->dst, req->dst, 0,
 						 req->dlen, 1);
-		} else {
-			int nr_pages = DIV_ROUND_UP(req->dst->offset + req->dlen, PAGE_SIZE);
-			int i;
-			struct page *dst_page = sg_page(req->dst);
-
-			for (i = 0; i < nr_pages; i++)
-				flush_dcache_page(dst_page + i);
-		}
+		else
+			scomp_flush_dcache_sg(req->dst, req->dlen);
 	}
 out:
-	spin_unlock(&scratch->lock);
+	if (scratch)
+		spin_unlock(&scratch->lock);
 	return ret;
 }
 
@@ -280,19 +332,32 @@ static const struct crypto_type crypto_scomp_type = {
 int crypto_register_scomp(struct scomp_alg *alg)
 {
 	struct crypto_alg *base = &alg->calg.base;
+	int ret;
 
 	comp_prepare_alg(&alg->calg);
 
 	base->cra_type = &crypto_scomp_type;
 	base->cra_flags |= CRYPTO_ALG_TYPE_SCOMPRESS;
 
-	return crypto_register_alg(base);
+	alg->stats = alloc_percpu(struct scomp_stats);
+	if (!alg->stats)
+		return -ENOMEM;
+
+	ret = crypto_register_alg(base);
+	if (ret) {
+		free_percpu(alg->stats);
+		alg->stats = NULL;
+	}
+
+	return ret;
 }
 EXPORT_SYMBOL_GPL(crypto_register_scomp);
 
 void crypto_unregister_scomp(struct scomp_alg *alg)
 {
 	crypto_unregister_alg(&alg->base);
+	free_percpu(alg->stats);
+	alg->stats = NULL;
 }
 EXPORT_SYMBOL_GPL(crypto_unregister_scomp);
 
@@ -8,6 +8,7 @@
  * SHA224 Support Copyright 2007 Intel Corporation <jonathan.lynch@intel.com>
  */
 #include <crypto/internal/hash.h>
+#include <linux/bitops.h>
 #include <linux/init.h>
 #include <linux/module.h>
 #include <linux/mm.h>
@@ -58,12 +59,144 @@ int crypto_sha256_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL(crypto_sha256_finup);
 
+/*
+ * Two-way interleaved SHA-256 block function for crypto_shash_finup_mb().
+ * The two message streams are independent, so interleaving their rounds
+ * gives superscalar CPUs twice the instruction level parallelism of the
+ * strictly sequential single-stream rounds.
+ */
+static const u32 sha256_2way_K[64] = {
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+	0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+	0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+	0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+	0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+	0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+	0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+	0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+	0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+#define Ch(x, y, z)	((z) ^ ((x) & ((y) ^ (z))))
+#define Maj(x, y, z)	(((x) & (y)) | ((z) & ((x) | (y))))
+#define S0(x)		(ror32(x, 2) ^ ror32(x, 13) ^ ror32(x, 22))
+#define S1(x)		(ror32(x, 6) ^ ror32(x, 11) ^ ror32(x, 25))
+#define s0(x)		(ror32(x, 7) ^ ror32(x, 18) ^ ((x) >> 3))
+#define s1(x)		(ror32(x, 17) ^ ror32(x, 19) ^ ((x) >> 10))
+
+/*
+ * The message schedule is kept in a rolling window of 16 words per stream,
+ * which keeps the stack usage of the two streams below that of one W[64].
+ */
+#define SHA256_2WAY_W(W, i)						\
+	((i) < 16 ? W[(i) & 15] :					\
+	 (W[(i) & 15] += s1(W[((i) - 2) & 15]) + W[((i) - 7) & 15] +	\
+			 s0(W[((i) - 15) & 15])))
+
+#define SHA256_2WAY_ROUND(i, a, b, c, d, e, f, g, h)			\
+	do {								\
+		u32 t0 = h##0 + S1(e##0) + Ch(e##0, f##0, g##0) +	\
+			 sha256_2way_K[i] + SHA256_2WAY_W(W0, i);	\
+		u32 t1 = h##1 + S1(e##1) + Ch(e##1, f##1, g##1) +	\
+			 sha256_2way_K[i] + SHA256_2WAY_W(W1, i);	\
+		d##0 += t0;						\
+		d##1 += t1;						\
+		h##0 = t0 + S0(a##0) + Maj(a##0, b##0, c##0);		\
+		h##1 = t1 + S0(a##1) + Maj(a##1, b##1, c##1);		\
+	} while (0)
+
+static void sha256_transform_2way(u32 *state0, u32 *state1,
+				  const u8 *in0, const u8 *in1)
+{
+	u32 a0, b0, c0, d0, e0, f0, g0, h0;
+	u32 a1, b1, c1, d1, e1, f1, g1, h1;
+	u32 W0[16], W1[16];
+	int i;
+
+	for (i = 0; i < 16; i++) {
+		W0[i] = get_unaligned_be32(in0 + 4 * i);
+		W1[i] = get_unaligned_be32(in1 + 4 * i);
+	}
+
+	a0 = state0[0]; b0 = state0[1]; c0 = state0[2]; d0 = state0[3];
+	e0 = state0[4]; f0 = state0[5]; g0 = state0[6]; h0 = state0[7];
+	a1 = state1[0]; b1 = state1[1]; c1 = state1[2]; d1 = state1[3];
+	e1 = state1[4]; f1 = state1[5]; g1 = state1[6]; h1 = state1[7];
+
+	for (i = 0; i < 64; i += 8) {
+		SHA256_2WAY_ROUND(i + 0, a, b, c, d, e, f, g, h);
+		SHA256_2WAY_ROUND(i + 1, h, a, b, c, d, e, f, g);
+		SHA256_2WAY_ROUND(i + 2, g, h, a, b, c, d, e, f);
+		SHA256_2WAY_ROUND(i + 3, f, g, h, a, b, c, d, e);
+		SHA256_2WAY_ROUND(i + 4, e, f, g, h, a, b, c, d);
+		SHA256_2WAY_ROUND(i + 5, d, e, f, g, h, a, b, c);
+		SHA256_2WAY_ROUND(i + 6, c, d, e, f, g, h, a, b);
+		SHA256_2WAY_ROUND(i + 7, b, c, d, e, f, g, h, a);
+	}
+
+	state0[0] += a0; state0[1] += b0; state0[2] += c0; state0[3] += d0;
+	state0[4] += e0; state0[5] += f0; state0[6] += g0; state0[7] += h0;
+	state1[0] += a1; state1[1] += b1; state1[2] += c1; state1[3] += d1;
+	state1[4] += e1; state1[5] += f1; state1[6] += g1; state1[7] += h1;
+
+	memzero_explicit(W0, sizeof(W0));
+	memzero_explicit(W1, sizeof(W1));
+}
+
+/*
+ * The full blocks of both messages are hashed interleaved.  The at most two
+ * padded tail blocks are then finished one message at a time, through the
+ * buffer already in each state, so no tail buffers are needed on the stack.
+ * @desc is left untouched, as ->finup_mb requires.
+ */
+static int crypto_sha256_finup_2way(struct shash_desc *desc,
+				    const u8 * const data[], unsigned int len,
+				    u8 * const outs[], unsigned int num_msgs)
+{
+	const struct sha256_state *sctx = shash_desc_ctx(desc);
+	unsigned int blocks = len / SHA256_BLOCK_SIZE;
+	unsigned int done = blocks * SHA256_BLOCK_SIZE;
+	struct sha256_state st[2];
+	unsigned int i;
+
+	/* Only messages continuing on a block boundary are interleaved. */
+	if (sctx->count % SHA256_BLOCK_SIZE)
+		return -EOPNOTSUPP;
+
+	st[0] = *sctx;
+	st[1] = *sctx;
+	for (i = 0; i < blocks; i++)
+		sha256_transform_2way(st[0].state, st[1].state,
+				      data[0] + i * SHA256_BLOCK_SIZE,
+				      data[1] + i * SHA256_BLOCK_SIZE);
+
+	for (i = 0; i < 2; i++) {
+		st[i].count += done;
+		sha256_update(&st[i], data[i] + done, len - done);
+		if (crypto_shash_digestsize(desc->tfm) == SHA224_DIGEST_SIZE)
+			sha224_final(&st[i], outs[i]);
+		else
+			sha256_final(&st[i], outs[i]);
+	}
+
+	return 0;
+}
+
 static struct shash_alg sha256_algs[2] = { {
 	.digestsize	=	SHA256_DIGEST_SIZE,
 	.init		=	sha256_base_init,
 	.update		=	crypto_sha256_update,
 	.final		=	crypto_sha256_final,
 	.finup		=	crypto_sha256_finup,
+	.finup_mb	=	crypto_sha256_finup_2way,
+	.mb_max_msgs	=	2,
 	.descsize	=	sizeof(struct sha256_state),
 	.base		=	{
 		.cra_name	=	"sha256",
@@ -78,6 +211,8 @@ static struct shash_alg sha256_algs[2] = { {
 	.update		=	crypto_sha256_update,
 	.final		=	crypto_sha256_final,
 	.finup		=	crypto_sha256_finup,
+	.finup_mb	=	crypto_sha256_finup_2way,
+	.mb_max_msgs	=	2,
 	.descsize	=	sizeof(struct sha256_state),
 	.base		=	{
 		.cra_name	=	"sha224",
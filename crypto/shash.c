@@ -75,6 +75,57 @@ int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 }
 EXPORT_SYMBOL_GPL(crypto_shash_finup);
 
+/*
+ * Finish one message on a copy of @desc, which later messages still start
+ * from.  Kept out of line so that the copy is only on the stack while a
+ * message is hashed on its own, not while ->finup_mb runs.
+ */
+static noinline_for_stack int shash_finup_copy(struct shash_desc *desc,
+					       const u8 *data, unsigned int len,
+					       u8 *out)
+{
+	struct crypto_shash *tfm = desc->tfm;
+	SHASH_DESC_ON_STACK(copy, tfm);
+	int err;
+
+	copy->tfm = tfm;
+	memcpy(shash_desc_ctx(copy), shash_desc_ctx(desc),
+	       crypto_shash_descsize(tfm));
+	err = crypto_shash_alg(tfm)->finup(copy, data, len, out);
+	shash_desc_zero(copy);
+
+	return err;
+}
+
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs)
+{
+	struct shash_alg *alg = crypto_shash_alg(desc->tfm);
+	unsigned int i, n;
+	int err = 0;
+
+	for (i = 0; i < num_msgs && !err; i += n) {
+		n = min(num_msgs - i, alg->mb_max_msgs);
+		if (n > 1) {
+			/* ->finup_mb leaves @desc as it is */
+			err = alg->finup_mb(desc, data + i, len, outs + i, n);
+			if (err != -EOPNOTSUPP)
+				continue;
+		}
+
+		/* Only the last message may consume @desc */
+		n = 1;
+		if (i + 1 == num_msgs)
+			err = alg->finup(desc, data[i], len, outs[i]);
+		else
+			err = shash_finup_copy(desc, data[i], len, outs[i]);
+	}
+
+	return err;
+}
+EXPORT_SYMBOL_GPL(crypto_shash_finup_mb);
+
 static int shash_default_digest(struct shash_desc *desc, const u8 *data,
 				unsigned int len, u8 *out)
 {
@@ -211,6 +262,8 @@ static void crypto_shash_show(struct seq_file *m, struct crypto_alg *alg)
 	seq_printf(m, "type         : shash\n");
 	seq_printf(m, "blocksize    : %u\n", alg->cra_blocksize);
 	seq_printf(m, "digestsize   : %u\n", salg->digestsize);
+	if (salg->mb_max_msgs > 1)
+		seq_printf(m, "mb_max_msgs  : %u\n", salg->mb_max_msgs);
 }
 
 const struct crypto_type crypto_shash_type = {
@@ -314,6 +367,11 @@ static int shash_prepare_alg(struct shash_alg *alg)
 	if ((alg->export && !alg->import) || (alg->import && !alg->export))
 		return -EINVAL;
 
+	if (!alg->finup_mb)
+		alg->mb_max_msgs = 1;
+	else if (alg->mb_max_msgs < 2 || alg->mb_max_msgs > HASH_MAX_MB_MSGS)
+		return -EINVAL;
+
 	err = hash_prepare_alg(&alg->halg);
 	if (err)
 		return err;
@@ -956,6 +956,159 @@ static void test_hash_speed(const char *algo, unsigned int secs,
 	return test_ahash_speed_common(algo, secs, speed, CRYPTO_ALG_ASYNC);
 }
 
+static int test_mb_shash_round(struct shash_desc *desc,
+			       const u8 * const data[], unsigned int len,
+			       u8 * const outs[], unsigned int num, bool mb)
+{
+	unsigned int i;
+	int ret;
+
+	if (mb)
+		return crypto_shash_init(desc) ?:
+		       crypto_shash_finup_mb(desc, data, len, outs, num);
+
+	for (i = 0; i < num; i++) {
+		ret = crypto_shash_digest(desc, data[i], len, outs[i]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+static int test_mb_shash_jiffies(struct shash_desc *desc,
+				 const u8 * const data[], unsigned int len,
+				 u8 * const outs[], unsigned int num, bool mb,
+				 int secs)
+{
+	unsigned long start, end;
+	int bcount;
+	int ret;
+
+	for (start = jiffies, end = start + secs * HZ, bcount = 0;
+	     time_before(jiffies, end); bcount++) {
+		ret = test_mb_shash_round(desc, data, len, outs, num, mb);
+		if (ret)
+			return ret;
+	}
+
+	pr_cont("%6u opers/sec, %9lu bytes/sec\n",
+		bcount * num / secs, ((long)bcount * num * len) / secs);
+
+	return 0;
+}
+
+static int test_mb_shash_cycles(struct shash_desc *desc,
+				const u8 * const data[], unsigned int len,
+				u8 * const outs[], unsigned int num, bool mb)
+{
+	unsigned long cycles = 0;
+	int ret, i;
+
+	/* Warm-up run. */
+	for (i = 0; i < 4; i++) {
+		ret = test_mb_shash_round(desc, data, len, outs, num, mb);
+		if (ret)
+			return ret;
+	}
+
+	/* The real thing. */
+	for (i = 0; i < 8; i++) {
+		cycles_t start, end;
+
+		start = get_cycles();
+		ret = test_mb_shash_round(desc, data, len, outs, num, mb);
+		end = get_cycles();
+		if (ret)
+			return ret;
+
+		cycles += end - start;
+	}
+
+	pr_cont("%6lu cycles/operation, %4lu cycles/byte\n",
+		cycles / (8 * num), cycles / (8 * num * len));
+
+	return 0;
+}
+
+/*
+ * Compare hashing @num_mb equal-length messages one by one with hashing them
+ * through crypto_shash_finup_mb(), after checking that both give the same
+ * digests.
+ */
+static void test_mb_shash_speed(const char *algo, unsigned int secs,
+				unsigned int num_mb)
+{
+	static const unsigned int lens[] = { 512, 1024, 4096 };
+	const u8 *data[HASH_MAX_MB_MSGS];
+	u8 *outs[HASH_MAX_MB_MSGS];
+	struct crypto_shash *tfm;
+	struct shash_desc *desc;
+	unsigned int i, j, num;
+	u8 *output;
+	int ret;
+
+	tfm = crypto_alloc_shash(algo, 0, 0);
+	if (IS_ERR(tfm)) {
+		pr_err("failed to load transform for %s: %ld\n",
+		       algo, PTR_ERR(tfm));
+		return;
+	}
+
+	num = clamp(num_mb, 1U, (unsigned int)HASH_MAX_MB_MSGS);
+	pr_info("testing speed of multibuffer %s (%s), %u messages, batch size %u\n",
+		algo, get_driver_name(crypto_shash, tfm), num,
+		crypto_shash_mb_max_msgs(tfm));
+
+	desc = kmalloc(sizeof(*desc) + crypto_shash_descsize(tfm), GFP_KERNEL);
+	output = kmalloc_array(2 * num, MAX_DIGEST_SIZE, GFP_KERNEL);
+	if (!desc || !output || crypto_shash_digestsize(tfm) > MAX_DIGEST_SIZE)
+		goto out;
+	desc->tfm = tfm;
+
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		for (j = 0; j < TVMEMSIZE; j++)
+			memset(tvmem[j], 0xff - j, PAGE_SIZE);
+		for (j = 0; j < num; j++)
+			data[j] = (u8 *)tvmem[j % TVMEMSIZE] +
+				  (j / TVMEMSIZE) * 8 % (PAGE_SIZE - lens[i] + 1);
+		for (j = 0; j < num; j++)
+			outs[j] = output + (num + j) * MAX_DIGEST_SIZE;
+		ret = test_mb_shash_round(desc, data, lens[i], outs, num, true);
+		for (j = 0; j < num && !ret; j++)
+			outs[j] = output + j * MAX_DIGEST_SIZE;
+		ret = ret ?: test_mb_shash_round(desc, data, lens[i], outs,
+						 num, false);
+		if (ret || memcmp(output, output + num * MAX_DIGEST_SIZE,
+				  num * MAX_DIGEST_SIZE)) {
+			pr_err("multibuffer digests differ from single ones (%d)\n",
+			       ret);
+			break;
+		}
+
+		for (j = 0; j < 2; j++) {
+			pr_info("test%3u (%5u byte messages, %s): ", i,
+				lens[i], j ? "multibuffer" : "one by one");
+			if (secs) {
+				ret = test_mb_shash_jiffies(desc, data, lens[i],
+							    outs, num, j, secs);
+				cond_resched();
+			} else {
+				ret = test_mb_shash_cycles(desc, data, lens[i],
+							   outs, num, j);
+			}
+			if (ret) {
+				pr_err("hashing failed ret=%d\n", ret);
+				goto out;
+			}
+		}
+	}
+
+out:
+	kfree(output);
+	kfree(desc);
+	crypto_free_shash(tfm);
+}
+
 struct test_mb_skcipher_data {
 	struct scatterlist sg[XBUFSIZE];
 	struct skcipher_request *req;
@@ -2398,6 +2551,10 @@ static int do_test(const char *alg, u32 type, u32 mask, int m, u32 num_mb)
 	case 499:
 		break;
 
+	case 450:
+		test_mb_shash_speed(alg ?: "sha256", sec, num_mb);
+		break;
+
 	case 500:
 		test_acipher_speed("ecb(aes)", ENCRYPT, sec, NULL, 0,
 				   speed_template_16_24_32);
@@ -2816,6 +2973,18 @@ static int do_test(const char *alg, u32 type, u32 mask, int m, u32 num_mb)
 				       speed_template_16_32, num_mb);
 		break;
 
+	case 611:
+		/* crypto engine in single request vs. batch mode */
+		test_mb_skcipher_speed("cbc-aes-vengine-single", ENCRYPT, sec,
+				       NULL, 0, speed_template_16_24_32, num_mb);
+		test_mb_skcipher_speed("cbc-aes-vengine-batch", ENCRYPT, sec,
+				       NULL, 0, speed_template_16_24_32, num_mb);
+		test_mb_skcipher_speed("cbc-aes-vengine-single", DECRYPT, sec,
+				       NULL, 0, speed_template_16_24_32, num_mb);
+		test_mb_skcipher_speed("cbc-aes-vengine-batch", DECRYPT, sec,
+				       NULL, 0, speed_template_16_24_32, num_mb);
+		break;
+
 	}
 
 	return ret;
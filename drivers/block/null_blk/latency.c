@@ -0,0 +1,391 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Completion latency profiles for timer completions (irqmode=2).
+ *
+ * A profile is written as a single line:
+ *
+ *   default                         completion_nsec for every request
+ *   fixed NSEC                      NSEC for every request
+ *   bimodal FAST SLOW PERMILLE      SLOW for PERMILLE/1000 requests, else FAST
+ *   lognormal MEDIAN SIGMA          log-normal around MEDIAN, SIGMA in 1/1000
+ *   table PERMILLE:NSEC ...         percentile table, linearly interpolated
+ *
+ * The device profile applies unless the first sector of a request falls into
+ * one of the sector ranges that carry their own profile.
+ */
+#include <linux/random.h>
+#include <linux/math64.h>
+#include "null_blk.h"
+
+/* Fixed point log-normal sampling, Q16 */
+#define LAT_Q			16
+#define LAT_ONE			(1 << LAT_Q)
+#define LAT_LOG2E		94548	/* log2(e) */
+
+static const char * const null_lat_names[] = {
+	[NULLB_LAT_DEFAULT]	= "default",
+	[NULLB_LAT_FIXED]	= "fixed",
+	[NULLB_LAT_BIMODAL]	= "bimodal",
+	[NULLB_LAT_LOGNORMAL]	= "lognormal",
+	[NULLB_LAT_TABLE]	= "table",
+};
+
+/* 2^x for x in [0, 1) as Q16, Taylor series of e^(x ln2) to the 4th term */
+static u32 null_lat_exp2_frac(u32 f)
+{
+	u64 p = 630;
+
+	p = 3638 + ((p * f) >> LAT_Q);
+	p = 15743 + ((p * f) >> LAT_Q);
+	p = 45426 + ((p * f) >> LAT_Q);
+	return LAT_ONE + ((p * f) >> LAT_Q);
+}
+
+static u64 null_lat_lognormal(const struct nullb_lat_profile *prof)
+{
+	s64 z = -6 * LAT_ONE, t;
+	u64 nsec;
+	u32 r;
+	int i, k;
+
+	/* Irwin-Hall: the sum of 12 uniform [0, 1) minus 6 is about N(0, 1) */
+	for (i = 0; i < 6; i++) {
+		r = get_random_u32();
+		z += (r & 0xffff) + (r >> 16);
+	}
+
+	/* e^(sigma z) = 2^(sigma z log2(e)) */
+	t = div_s64(z * prof->param, 1000);
+	t = (t * LAT_LOG2E) >> LAT_Q;
+	k = t >> LAT_Q;
+
+	nsec = mul_u64_u32_shr(prof->nsec,
+			       null_lat_exp2_frac(t & (LAT_ONE - 1)), LAT_Q);
+	if (k >= 0) {
+		if (nsec > (NULLB_LAT_MAX_NSEC >> k))
+			return NULLB_LAT_MAX_NSEC;
+		return nsec << k;
+	}
+	return k > -64 ? nsec >> -k : 0;
+}
+
+static u64 null_lat_table(const struct nullb_lat_profile *prof)
+{
+	const struct nullb_lat_point *lo, *hi;
+	u32 u = get_random_u32_below(1000 * 1000);
+	unsigned int i;
+
+	for (i = 0; i < prof->nr_points - 1; i++)
+		if (u < prof->points[i].permille * 1000)
+			break;
+
+	hi = &prof->points[i];
+	if (!i)
+		return hi->nsec;
+
+	lo = hi - 1;
+	return lo->nsec + div_u64((hi->nsec - lo->nsec) *
+				  (u - lo->permille * 1000),
+				  (hi->permille - lo->permille) * 1000);
+}
+
+u64 null_lat_sample(struct nullb_device *dev, sector_t sector)
+{
+	const struct nullb_lat_profile *prof = &dev->latency;
+	unsigned int i;
+
+	for (i = 0; i < dev->nr_lat_ranges; i++) {
+		if (sector < dev->lat_ranges[i].start)
+			break;
+		if (sector <= dev->lat_ranges[i].end) {
+			prof = &dev->lat_ranges[i].prof;
+			break;
+		}
+	}
+
+	switch (prof->dist) {
+	case NULLB_LAT_FIXED:
+		return prof->nsec;
+	case NULLB_LAT_BIMODAL:
+		if (get_random_u32_below(1000) < prof->param)
+			return prof->slow_nsec;
+		return prof->nsec;
+	case NULLB_LAT_LOGNORMAL:
+		return null_lat_lognormal(prof);
+	case NULLB_LAT_TABLE:
+		return null_lat_table(prof);
+	default:
+		return dev->completion_nsec;
+	}
+}
+
+static int null_lat_parse_table(struct nullb_lat_profile *prof, char *spec)
+{
+	struct nullb_lat_point *pt;
+	unsigned int permille;
+	char *tok;
+	u64 nsec;
+	int n;
+
+	while ((tok = strsep(&spec, " \t")) != NULL) {
+		if (!*tok)
+			continue;
+		if (prof->nr_points == NULLB_LAT_POINTS_MAX)
+			return -EINVAL;
+		if (sscanf(tok, "%u:%llu%n", &permille, &nsec, &n) != 2 ||
+		    tok[n] || permille > 1000 || nsec > NULLB_LAT_MAX_NSEC)
+			return -EINVAL;
+
+		/* Percentiles and latencies must both increase */
+		if (prof->nr_points) {
+			pt = &prof->points[prof->nr_points - 1];
+			if (permille <= pt->permille || nsec < pt->nsec)
+				return -EINVAL;
+		} else if (!permille) {
+			return -EINVAL;
+		}
+
+		pt = &prof->points[prof->nr_points++];
+		pt->permille = permille;
+		pt->nsec = nsec;
+	}
+
+	if (!prof->nr_points ||
+	    prof->points[prof->nr_points - 1].permille != 1000)
+		return -EINVAL;
+	return 0;
+}
+
+/* Parse a profile from @spec, which is modified */
+static int null_lat_parse(struct nullb_lat_profile *prof, char *spec)
+{
+	struct nullb_lat_profile p = {};
+	char *name;
+	int n = 0;
+
+	spec = strim(spec);
+	name = strsep(&spec, " \t");
+	if (spec)
+		spec = skip_spaces(spec);
+	else
+		spec = "";
+
+	if (!*name || !strcmp(name, "default")) {
+		p.dist = NULLB_LAT_DEFAULT;
+		if (*spec)
+			return -EINVAL;
+	} else if (!strcmp(name, "fixed")) {
+		p.dist = NULLB_LAT_FIXED;
+		if (sscanf(spec, "%llu%n", &p.nsec, &n) != 1 || spec[n])
+			return -EINVAL;
+	} else if (!strcmp(name, "bimodal")) {
+		p.dist = NULLB_LAT_BIMODAL;
+		if (sscanf(spec, "%llu %llu %u%n", &p.nsec, &p.slow_nsec,
+			   &p.param, &n) != 3 || spec[n] || p.param > 1000 ||
+		    p.slow_nsec > NULLB_LAT_MAX_NSEC)
+			return -EINVAL;
+	} else if (!strcmp(name, "lognormal")) {
+		p.dist = NULLB_LAT_LOGNORMAL;
+		if (sscanf(spec, "%llu %u%n", &p.nsec, &p.param, &n) != 2 ||
+		    spec[n] || p.param > NULLB_LAT_SIGMA_MAX)
+			return -EINVAL;
+	} else if (!strcmp(name, "table")) {
+		p.dist = NULLB_LAT_TABLE;
+		if (null_lat_parse_table(&p, spec))
+			return -EINVAL;
+	} else {
+		return -EINVAL;
+	}
+
+	if (p.nsec > NULLB_LAT_MAX_NSEC)
+		return -EINVAL;
+
+	*prof = p;
+	return 0;
+}
+
+static int null_lat_print(const struct nullb_lat_profile *prof, char *buf,
+			  size_t size)
+{
+	int i, len;
+
+	len = scnprintf(buf, size, "%s", null_lat_names[prof->dist]);
+
+	switch (prof->dist) {
+	case NULLB_LAT_FIXED:
+		len += scnprintf(buf + len, size - len, " %llu", prof->nsec);
+		break;
+	case NULLB_LAT_BIMODAL:
+		len += scnprintf(buf + len, size - len, " %llu %llu %u",
+				 prof->nsec, prof->slow_nsec, prof->param);
+		break;
+	case NULLB_LAT_LOGNORMAL:
+		len += scnprintf(buf + len, size - len, " %llu %u",
+				 prof->nsec, prof->param);
+		break;
+	case NULLB_LAT_TABLE:
+		for (i = 0; i < prof->nr_points; i++)
+			len += scnprintf(buf + len, size - len, " %u:%llu",
+					 prof->points[i].permille,
+					 prof->points[i].nsec);
+		break;
+	default:
+		break;
+	}
+
+	return len;
+}
+
+ssize_t null_lat_show(struct nullb_device *dev, char *page)
+{
+	int len;
+
+	len = null_lat_print(&dev->latency, page, PAGE_SIZE);
+	len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+	return len;
+}
+
+ssize_t null_lat_store(struct nullb_device *dev, const char *page,
+		       size_t count)
+{
+	char *buf;
+	int ret;
+
+	buf = kstrndup(page, count, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = null_lat_parse(&dev->latency, buf);
+	kfree(buf);
+
+	return ret ? ret : count;
+}
+
+ssize_t null_lat_ranges_show(struct nullb_device *dev, char *page)
+{
+	struct nullb_lat_range *r;
+	unsigned int i;
+	int len = 0;
+
+	for (i = 0; i < dev->nr_lat_ranges; i++) {
+		r = &dev->lat_ranges[i];
+		len += scnprintf(page + len, PAGE_SIZE - len, "%llu-%llu ",
+				 (unsigned long long)r->start,
+				 (unsigned long long)r->end);
+		len += null_lat_print(&r->prof, page + len, PAGE_SIZE - len);
+		len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+	}
+
+	return len;
+}
+
+static int null_lat_range_add(struct nullb_device *dev, u64 start, u64 end,
+			      char *spec)
+{
+	struct nullb_lat_profile prof;
+	unsigned int i;
+	int ret;
+
+	ret = null_lat_parse(&prof, spec);
+	if (ret)
+		return ret;
+
+	if (dev->nr_lat_ranges == NULLB_LAT_RANGES_MAX)
+		return -ENOSPC;
+
+	if (!dev->lat_ranges) {
+		dev->lat_ranges = kcalloc(NULLB_LAT_RANGES_MAX,
+					  sizeof(*dev->lat_ranges), GFP_KERNEL);
+		if (!dev->lat_ranges)
+			return -ENOMEM;
+	}
+
+	/* Ranges are kept sorted and may not overlap */
+	for (i = 0; i < dev->nr_lat_ranges; i++) {
+		if (end < dev->lat_ranges[i].start)
+			break;
+		if (start <= dev->lat_ranges[i].end)
+			return -EEXIST;
+	}
+
+	memmove(&dev->lat_ranges[i + 1], &dev->lat_ranges[i],
+		(dev->nr_lat_ranges - i) * sizeof(*dev->lat_ranges));
+	dev->lat_ranges[i].start = start;
+	dev->lat_ranges[i].end = end;
+	dev->lat_ranges[i].prof = prof;
+	dev->nr_lat_ranges++;
+
+	return 0;
+}
+
+static int null_lat_range_del(struct nullb_device *dev, u64 start, u64 end)
+{
+	unsigned int i;
+
+	for (i = 0; i < dev->nr_lat_ranges; i++) {
+		if (dev->lat_ranges[i].start == start &&
+		    dev->lat_ranges[i].end == end) {
+			dev->nr_lat_ranges--;
+			memmove(&dev->lat_ranges[i], &dev->lat_ranges[i + 1],
+				(dev->nr_lat_ranges - i) *
+				sizeof(*dev->lat_ranges));
+			return 0;
+		}
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * "+START-END PROFILE" adds a profile for sectors START to END inclusive,
+ * "-START-END" removes it again.
+ */
+ssize_t null_lat_ranges_store(struct nullb_device *dev, const char *page,
+			      size_t count)
+{
+	char *orig, *buf, *tmp, *spec;
+	u64 start, end;
+	char op;
+	int ret;
+
+	orig = kstrndup(page, count, GFP_KERNEL);
+	if (!orig)
+		return -ENOMEM;
+
+	buf = strstrip(orig);
+
+	ret = -EINVAL;
+	op = buf[0];
+	if (op != '+' && op != '-')
+		goto out;
+	spec = buf + 1;
+	tmp = strsep(&spec, " \t");
+	buf = strchr(tmp, '-');
+	if (!buf)
+		goto out;
+	*buf = '\0';
+	ret = kstrtoull(tmp, 0, &start);
+	if (ret)
+		goto out;
+	ret = kstrtoull(buf + 1, 0, &end);
+	if (ret)
+		goto out;
+	ret = -EINVAL;
+	if (start > end)
+		goto out;
+
+	if (op == '+')
+		ret = null_lat_range_add(dev, start, end, spec ? spec : "");
+	else if (!spec || !*skip_spaces(spec))
+		ret = null_lat_range_del(dev, start, end);
+out:
+	kfree(orig);
+	return ret ? ret : count;
+}
+
+void null_lat_free(struct nullb_device *dev)
+{
+	kfree(dev->lat_ranges);
+	dev->lat_ranges = NULL;
+	dev->nr_lat_ranges = 0;
+}
@@ -568,6 +568,51 @@ static ssize_t nullb_device_badblocks_store(struct config_item *item,
 }
 CONFIGFS_ATTR(nullb_device_, badblocks);
 
+static ssize_t nullb_device_latency_show(struct config_item *item, char *page)
+{
+	return null_lat_show(to_nullb_device(item), page);
+}
+
+static ssize_t nullb_device_latency_store(struct config_item *item,
+					  const char *page, size_t count)
+{
+	struct nullb_device *dev = to_nullb_device(item);
+	ssize_t ret;
+
+	mutex_lock(&lock);
+	if (test_bit(NULLB_DEV_FL_CONFIGURED, &dev->flags))
+		ret = -EBUSY;
+	else
+		ret = null_lat_store(dev, page, count);
+	mutex_unlock(&lock);
+
+	return ret;
+}
+CONFIGFS_ATTR(nullb_device_, latency);
+
+static ssize_t nullb_device_latency_ranges_show(struct config_item *item,
+						char *page)
+{
+	return null_lat_ranges_show(to_nullb_device(item), page);
+}
+
+static ssize_t nullb_device_latency_ranges_store(struct config_item *item,
+						 const char *page, size_t count)
+{
+	struct nullb_device *dev = to_nullb_device(item);
+	ssize_t ret;
+
+	mutex_lock(&lock);
+	if (test_bit(NULLB_DEV_FL_CONFIGURED, &dev->flags))
+		ret = -EBUSY;
+	else
+		ret = null_lat_ranges_store(dev, page, count);
+	mutex_unlock(&lock);
+
+	return ret;
+}
+CONFIGFS_ATTR(nullb_device_, latency_ranges);
+
 static ssize_t nullb_device_zone_readonly_store(struct config_item *item,
 						const char *page, size_t count)
 {
@@ -589,6 +634,8 @@ CONFIGFS_ATTR_WO(nullb_device_, zone_offline);
 static struct configfs_attribute *nullb_device_attrs[] = {
 	&nullb_device_attr_size,
 	&nullb_device_attr_completion_nsec,
+	&nullb_device_attr_latency,
+	&nullb_device_attr_latency_ranges,
 	&nullb_device_attr_submit_queues,
 	&nullb_device_attr_poll_queues,
 	&nullb_device_attr_home_node,
@@ -701,12 +748,12 @@ static ssize_t memb_group_features_show(struct config_item *item, char *page)
 	return snprintf(page, PAGE_SIZE,
 			"badblocks,blocking,blocksize,cache_size,fua,"
 			"completion_nsec,discard,home_node,hw_queue_depth,"
-			"irqmode,max_sectors,mbps,memory_backed,no_sched,"
-			"poll_queues,power,queue_mode,shared_tag_bitmap,"
-			"shared_tags,size,submit_queues,use_per_node_hctx,"
-			"virt_boundary,zoned,zone_capacity,zone_max_active,"
-			"zone_max_open,zone_nr_conv,zone_offline,zone_readonly,"
-			"zone_size,zone_append_max_sectors,zone_full\n");
+			"irqmode,latency,latency_ranges,max_sectors,mbps,"
+			"memory_backed,no_sched,poll_queues,power,queue_mode,"
+			"shared_tag_bitmap,shared_tags,size,submit_queues,"
+			"use_per_node_hctx,virt_boundary,zoned,zone_capacity,"
+			"zone_max_active,zone_max_open,zone_nr_conv,zone_offline,"
+			"zone_readonly,zone_size,zone_append_max_sectors,zone_full\n");
 }
 
 CONFIGFS_ATTR_RO(memb_group_, features);
@@ -803,6 +850,7 @@ static void null_free_dev(struct nullb_device *dev)
 		return;
 
 	null_free_zoned_dev(dev);
+	null_lat_free(dev);
 	badblocks_exit(&dev->badblocks);
 	kfree(dev);
 }
@@ -817,7 +865,8 @@ static enum hrtimer_restart null_cmd_timer_expired(struct hrtimer *timer)
 
 static void null_cmd_end_timer(struct nullb_cmd *cmd)
 {
-	ktime_t kt = cmd->nq->dev->completion_nsec;
+	struct request *rq = blk_mq_rq_from_pdu(cmd);
+	ktime_t kt = null_lat_nsec(cmd->nq->dev, blk_rq_pos(rq));
 
 	hrtimer_start(&cmd->timer, kt, HRTIMER_MODE_REL);
 }
@@ -1108,17 +1157,20 @@ static int null_make_cache_space(struct nullb *nullb, unsigned long n)
 static int copy_to_nullb(struct nullb *nullb, struct page *source,
 	unsigned int off, sector_t sector, size_t n, bool is_fua)
 {
+	unsigned int bs_sects = nullb->dev->blocksize >> SECTOR_SHIFT;
 	size_t temp, count = 0;
 	unsigned int offset;
 	struct nullb_page *t_page;
+	sector_t s;
 
 	while (count < n) {
-		temp = min_t(size_t, nullb->dev->blocksize, n - count);
+		/* Fill the backing page up to its end with a single copy */
+		offset = (sector & SECTOR_MASK) << SECTOR_SHIFT;
+		temp = min_t(size_t, PAGE_SIZE - offset, n - count);
 
 		if (null_cache_active(nullb) && !is_fua)
 			null_make_cache_space(nullb, PAGE_SIZE);
 
-		offset = (sector & SECTOR_MASK) << SECTOR_SHIFT;
 		t_page = null_insert_page(nullb, sector,
 			!null_cache_active(nullb) || is_fua);
 		if (!t_page)
@@ -1126,10 +1178,13 @@ static int copy_to_nullb(struct nullb *nullb, struct page *source,
 
 		memcpy_page(t_page->page, offset, source, off + count, temp);
 
-		__set_bit(sector & SECTOR_MASK, t_page->bitmap);
+		for (s = sector; s < sector + (temp >> SECTOR_SHIFT);
+		     s += bs_sects) {
+			__set_bit(s & SECTOR_MASK, t_page->bitmap);
 
-		if (is_fua)
-			null_free_sector(nullb, sector, true);
+			if (is_fua)
+				null_free_sector(nullb, s, true);
+		}
 
 		count += temp;
 		sector += temp >> SECTOR_SHIFT;
@@ -1137,6 +1192,33 @@ static int copy_to_nullb(struct nullb *nullb, struct page *source,
 	return 0;
 }
 
+/*
+ * Copy @n bytes that lie within a single page of the data store in one go.
+ * This works if the page is missing or if all of its blocks in the range
+ * have been written, otherwise nothing is copied and false is returned.
+ */
+static bool copy_page_from_nullb(struct nullb *nullb, struct page *dest,
+	unsigned int off, sector_t sector, size_t n)
+{
+	unsigned int bs_sects = nullb->dev->blocksize >> SECTOR_SHIFT;
+	struct nullb_page *t_page;
+	sector_t s;
+
+	t_page = __null_lookup_page(nullb, sector, true, false);
+	if (!t_page) {
+		zero_user(dest, off, n);
+		return true;
+	}
+
+	for (s = sector; s < sector + (n >> SECTOR_SHIFT); s += bs_sects)
+		if (!test_bit(s & SECTOR_MASK, t_page->bitmap))
+			return false;
+
+	memcpy_page(dest, off, t_page->page,
+		    (sector & SECTOR_MASK) << SECTOR_SHIFT, n);
+	return true;
+}
+
 static int copy_from_nullb(struct nullb *nullb, struct page *dest,
 	unsigned int off, sector_t sector, size_t n)
 {
@@ -1145,9 +1227,18 @@ static int copy_from_nullb(struct nullb *nullb, struct page *dest,
 	struct nullb_page *t_page;
 
 	while (count < n) {
-		temp = min_t(size_t, nullb->dev->blocksize, n - count);
-
 		offset = (sector & SECTOR_MASK) << SECTOR_SHIFT;
+
+		/* Without a cache, a block can only be in the data store */
+		temp = min_t(size_t, PAGE_SIZE - offset, n - count);
+		if (!null_cache_active(nullb) &&
+		    copy_page_from_nullb(nullb, dest, off + count, sector, temp)) {
+			count += temp;
+			sector += temp >> SECTOR_SHIFT;
+			continue;
+		}
+
+		temp = min_t(size_t, nullb->dev->blocksize, n - count);
 		t_page = null_lookup_page(nullb, sector, false,
 			!null_cache_active(nullb));
 
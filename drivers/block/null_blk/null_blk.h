@@ -50,6 +50,40 @@ struct nullb_zone {
 	unsigned int capacity;
 };
 
+/* Completion latency distributions, see latency.c */
+enum nullb_lat_dist {
+	NULLB_LAT_DEFAULT,
+	NULLB_LAT_FIXED,
+	NULLB_LAT_BIMODAL,
+	NULLB_LAT_LOGNORMAL,
+	NULLB_LAT_TABLE,
+};
+
+#define NULLB_LAT_POINTS_MAX	16
+#define NULLB_LAT_RANGES_MAX	16
+#define NULLB_LAT_SIGMA_MAX	3000
+#define NULLB_LAT_MAX_NSEC	(10ULL * NSEC_PER_SEC)
+
+struct nullb_lat_point {
+	unsigned int permille;
+	u64 nsec;
+};
+
+struct nullb_lat_profile {
+	enum nullb_lat_dist dist;
+	unsigned int param; /* bimodal: slow permille, lognormal: sigma * 1000 */
+	u64 nsec; /* fixed, bimodal fast or lognormal median latency */
+	u64 slow_nsec; /* bimodal slow latency */
+	unsigned int nr_points;
+	struct nullb_lat_point points[NULLB_LAT_POINTS_MAX];
+};
+
+struct nullb_lat_range {
+	sector_t start;
+	sector_t end;
+	struct nullb_lat_profile prof;
+};
+
 struct nullb_device {
 	struct nullb *nullb;
 	struct config_group group;
@@ -76,6 +110,9 @@ struct nullb_device {
 
 	unsigned long size; /* device size in MB */
 	unsigned long completion_nsec; /* time in ns to complete a request */
+	struct nullb_lat_profile latency; /* completion latency profile */
+	struct nullb_lat_range *lat_ranges; /* per sector range profiles */
+	unsigned int nr_lat_ranges;
 	unsigned long cache_size; /* disk cache size in MB */
 	unsigned long zone_size; /* zone size in MB if device is zoned */
 	unsigned long zone_capacity; /* zone capacity in MB if device is zoned */
@@ -131,6 +168,23 @@ blk_status_t null_handle_discard(struct nullb_device *dev, sector_t sector,
 blk_status_t null_process_cmd(struct nullb_cmd *cmd, enum req_op op,
 			      sector_t sector, unsigned int nr_sectors);
 
+u64 null_lat_sample(struct nullb_device *dev, sector_t sector);
+ssize_t null_lat_show(struct nullb_device *dev, char *page);
+ssize_t null_lat_store(struct nullb_device *dev, const char *page,
+		       size_t count);
+ssize_t null_lat_ranges_show(struct nullb_device *dev, char *page);
+ssize_t null_lat_ranges_store(struct nullb_device *dev, const char *page,
+			      size_t count);
+void null_lat_free(struct nullb_device *dev);
+
+static inline u64 null_lat_nsec(struct nullb_device *dev, sector_t sector)
+{
+	if (likely(dev->latency.dist == NULLB_LAT_DEFAULT &&
+		   !dev->nr_lat_ranges))
+		return dev->completion_nsec;
+	return null_lat_sample(dev, sector);
+}
+
 #ifdef CONFIG_BLK_DEV_ZONED
 int null_init_zoned_dev(struct nullb_device *dev, struct queue_limits *lim);
 int null_register_zoned_dev(struct nullb *nullb);
@@ -794,10 +794,33 @@ static struct entry *get_entry(struct entry_alloc *ea, unsigned int index)
 #define HOTSPOT_UPDATE_PERIOD (HZ)
 #define CACHE_UPDATE_PERIOD (60ul * HZ)
 
+/*
+ * The buckets of the cache table are split into shards, each with its own
+ * lock, so that hits can be served without the policy lock.
+ */
+#define NR_SHARDS 64u
+
+/*
+ * Maximum number of demotions or writebacks queued in one go.
+ */
+#define BACKGROUND_BATCH 16u
+
+struct smq_shard {
+	spinlock_t lock;
+
+	/* cache_stats of the hits served under the shard lock */
+	unsigned int hits;
+	unsigned int misses;
+	unsigned long long fast_hits;
+} ____cacheline_aligned_in_smp;
+
 struct smq_policy {
 	struct dm_cache_policy policy;
 
-	/* protects everything */
+	/*
+	 * Protects everything.  Changes of the cache table also take the
+	 * lock of the shard, nested inside this one.
+	 */
 	spinlock_t lock;
 	dm_cblock_t cache_size;
 	sector_t cache_block_size;
@@ -842,6 +865,7 @@ struct smq_policy {
 	 */
 	struct smq_hash_table table;
 	struct smq_hash_table hotspot_table;
+	struct smq_shard shards[NR_SHARDS];
 
 	bool current_writeback_sentinels;
 	unsigned long next_writeback_period;
@@ -864,10 +888,80 @@ struct smq_policy {
 	 * even if the device is not idle.
 	 */
 	bool cleaner:1;
+
+	unsigned long long lookups;
+	unsigned long long promotions;
+	unsigned long long demotions;
+	unsigned long long writebacks;
 };
 
 /*----------------------------------------------------------------*/
 
+static struct smq_shard *get_shard(struct smq_policy *mq, unsigned int bucket)
+{
+	return mq->shards + (bucket & (NR_SHARDS - 1u));
+}
+
+static struct smq_shard *oblock_shard(struct smq_policy *mq, dm_oblock_t oblock)
+{
+	return get_shard(mq, hash_64(from_oblock(oblock), mq->table.hash_bits));
+}
+
+/*
+ * Changes to the cache table always hold the shard lock, so lookup_fast()
+ * can walk a bucket without the policy lock.
+ */
+static void table_insert(struct smq_policy *mq, struct entry *e)
+{
+	struct smq_shard *shard = oblock_shard(mq, e->oblock);
+	unsigned long flags;
+
+	spin_lock_irqsave(&shard->lock, flags);
+	h_insert(&mq->table, e);
+	spin_unlock_irqrestore(&shard->lock, flags);
+}
+
+static void table_remove(struct smq_policy *mq, struct entry *e)
+{
+	struct smq_shard *shard = oblock_shard(mq, e->oblock);
+	unsigned long flags;
+
+	spin_lock_irqsave(&shard->lock, flags);
+	h_remove(&mq->table, e);
+	spin_unlock_irqrestore(&shard->lock, flags);
+}
+
+static struct entry *table_lookup(struct smq_policy *mq, dm_oblock_t oblock)
+{
+	struct smq_shard *shard = oblock_shard(mq, oblock);
+	unsigned long flags;
+	struct entry *e;
+
+	spin_lock_irqsave(&shard->lock, flags);
+	e = h_lookup(&mq->table, oblock);
+	spin_unlock_irqrestore(&shard->lock, flags);
+
+	return e;
+}
+
+/*
+ * Moves the cache stats gathered by the shards into cache_stats.
+ */
+static void fold_shard_stats(struct smq_policy *mq)
+{
+	struct smq_shard *shard;
+	unsigned int i;
+
+	for (i = 0; i < NR_SHARDS; i++) {
+		shard = mq->shards + i;
+		spin_lock(&shard->lock);
+		mq->cache_stats.hits += shard->hits;
+		mq->cache_stats.misses += shard->misses;
+		shard->hits = shard->misses = 0u;
+		spin_unlock(&shard->lock);
+	}
+}
+
 static struct entry *get_sentinel(struct entry_alloc *ea, unsigned int level, bool which)
 {
 	return get_entry(ea, which ? level : NR_CACHE_LEVELS + level);
@@ -972,7 +1066,7 @@ static void push_queue(struct smq_policy *mq, struct entry *e)
 // !h, !q, a -> h, q, a
 static void push(struct smq_policy *mq, struct entry *e)
 {
-	h_insert(&mq->table, e);
+	table_insert(mq, e);
 	if (!e->pending_work)
 		push_queue(mq, e);
 }
@@ -987,7 +1081,7 @@ static void push_queue_front(struct smq_policy *mq, struct entry *e)
 
 static void push_front(struct smq_policy *mq, struct entry *e)
 {
-	h_insert(&mq->table, e);
+	table_insert(mq, e);
 	if (!e->pending_work)
 		push_queue_front(mq, e);
 }
@@ -1182,43 +1276,54 @@ static void clear_pending(struct smq_policy *mq, struct entry *e)
 	e->pending_work = false;
 }
 
-static void queue_writeback(struct smq_policy *mq, bool idle)
+/*
+ * Returns true if a writeback was queued.
+ */
+static bool queue_writeback(struct smq_policy *mq, bool idle)
 {
 	int r;
 	struct policy_work work;
 	struct entry *e;
 
 	e = q_peek(&mq->dirty, mq->dirty.nr_levels, idle);
-	if (e) {
-		mark_pending(mq, e);
-		q_del(&mq->dirty, e);
+	if (!e)
+		return false;
 
-		work.op = POLICY_WRITEBACK;
-		work.oblock = e->oblock;
-		work.cblock = infer_cblock(mq, e);
+	mark_pending(mq, e);
+	q_del(&mq->dirty, e);
 
-		r = btracker_queue(mq->bg_work, &work, NULL);
-		if (r) {
-			clear_pending(mq, e);
-			q_push_front(&mq->dirty, e);
-		}
+	work.op = POLICY_WRITEBACK;
+	work.oblock = e->oblock;
+	work.cblock = infer_cblock(mq, e);
+
+	r = btracker_queue(mq->bg_work, &work, NULL);
+	if (r) {
+		clear_pending(mq, e);
+		q_push_front(&mq->dirty, e);
+		return false;
 	}
+
+	mq->writebacks++;
+	return true;
 }
 
-static void queue_demotion(struct smq_policy *mq)
+/*
+ * Returns true if a demotion was queued.
+ */
+static bool queue_demotion(struct smq_policy *mq)
 {
 	int r;
 	struct policy_work work;
 	struct entry *e;
 
 	if (WARN_ON_ONCE(!mq->migrations_allowed))
-		return;
+		return false;
 
 	e = q_peek(&mq->clean, mq->clean.nr_levels / 2, true);
 	if (!e) {
 		if (!clean_target_met(mq, true))
 			queue_writeback(mq, false);
-		return;
+		return false;
 	}
 
 	mark_pending(mq, e);
@@ -1231,7 +1336,33 @@ static void queue_demotion(struct smq_policy *mq)
 	if (r) {
 		clear_pending(mq, e);
 		q_push_front(&mq->clean, e);
+		return false;
 	}
+
+	mq->demotions++;
+	return true;
+}
+
+/*
+ * Queue demotions until the free target is met, a batch at a time so that
+ * a busy cache does not come back here for every promotion.
+ */
+static void queue_demotions(struct smq_policy *mq)
+{
+	unsigned int i;
+
+	for (i = 0; i < BACKGROUND_BATCH && !free_target_met(mq); i++)
+		if (!queue_demotion(mq))
+			break;
+}
+
+static void queue_writebacks(struct smq_policy *mq, bool idle)
+{
+	unsigned int i;
+
+	for (i = 0; i < BACKGROUND_BATCH && !clean_target_met(mq, idle); i++)
+		if (!queue_writeback(mq, idle))
+			break;
 }
 
 static void queue_promotion(struct smq_policy *mq, dm_oblock_t oblock,
@@ -1249,8 +1380,7 @@ static void queue_promotion(struct smq_policy *mq, dm_oblock_t oblock,
 		 * We always claim to be 'idle' to ensure some demotions happen
 		 * with continuous loads.
 		 */
-		if (!free_target_met(mq))
-			queue_demotion(mq);
+		queue_demotions(mq);
 		return;
 	}
 
@@ -1270,6 +1400,8 @@ static void queue_promotion(struct smq_policy *mq, dm_oblock_t oblock,
 	r = btracker_queue(mq->bg_work, &work, workp);
 	if (r)
 		free_entry(&mq->cache_alloc, e);
+	else
+		mq->promotions++;
 }
 
 /*----------------------------------------------------------------*/
@@ -1382,7 +1514,8 @@ static int __lookup(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblo
 
 	*background_work = false;
 
-	e = h_lookup(&mq->table, oblock);
+	mq->lookups++;
+	e = table_lookup(mq, oblock);
 	if (e) {
 		stats_level_accessed(&mq->cache_stats, e->level);
 
@@ -1408,6 +1541,36 @@ static int __lookup(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblo
 	}
 }
 
+/*
+ * A hit only has to touch the queues the first time the block is hit in a
+ * cache period, see requeue().  After that the shard lock is enough.  The
+ * entry is not moved to the front of its bucket here, which is only an
+ * optimisation.
+ */
+static bool lookup_fast(struct smq_policy *mq, dm_oblock_t oblock, dm_cblock_t *cblock)
+{
+	unsigned int h = hash_64(from_oblock(oblock), mq->table.hash_bits);
+	struct smq_shard *shard = get_shard(mq, h);
+	struct entry *e, *prev;
+	unsigned long flags;
+	bool hit = false;
+
+	spin_lock_irqsave(&shard->lock, flags);
+	e = __h_lookup(&mq->table, h, oblock, &prev);
+	if (e && test_bit(from_cblock(infer_cblock(mq, e)), mq->cache_hit_bits)) {
+		if (e->level >= mq->cache_stats.hit_threshold)
+			shard->hits++;
+		else
+			shard->misses++;
+		shard->fast_hits++;
+		*cblock = infer_cblock(mq, e);
+		hit = true;
+	}
+	spin_unlock_irqrestore(&shard->lock, flags);
+
+	return hit;
+}
+
 static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t *cblock,
 		      int data_dir, bool fast_copy,
 		      bool *background_work)
@@ -1416,6 +1579,11 @@ static int smq_lookup(struct dm_cache_policy *p, dm_oblock_t oblock, dm_cblock_t
 	unsigned long flags;
 	struct smq_policy *mq = to_smq_policy(p);
 
+	if (lookup_fast(mq, oblock, cblock)) {
+		*background_work = false;
+		return 0;
+	}
+
 	spin_lock_irqsave(&mq->lock, flags);
 	r = __lookup(mq, oblock, cblock,
 		     data_dir, fast_copy,
@@ -1435,6 +1603,9 @@ static int smq_lookup_with_work(struct dm_cache_policy *p,
 	unsigned long flags;
 	struct smq_policy *mq = to_smq_policy(p);
 
+	if (lookup_fast(mq, oblock, cblock))
+		return 0;
+
 	spin_lock_irqsave(&mq->lock, flags);
 	r = __lookup(mq, oblock, cblock, data_dir, fast_copy, work, &background_queued);
 	spin_unlock_irqrestore(&mq->lock, flags);
@@ -1453,7 +1624,7 @@ static int smq_get_background_work(struct dm_cache_policy *p, bool idle,
 	r = btracker_issue(mq->bg_work, result);
 	if (r == -ENODATA) {
 		if (!clean_target_met(mq, idle)) {
-			queue_writeback(mq, idle);
+			queue_writebacks(mq, idle);
 			r = btracker_issue(mq->bg_work, result);
 		}
 	}
@@ -1491,7 +1662,7 @@ static void __complete_background_work(struct smq_policy *mq,
 	case POLICY_DEMOTE:
 		// h, !q, a
 		if (success) {
-			h_remove(&mq->table, e);
+			table_remove(mq, e);
 			free_entry(&mq->cache_alloc, e);
 			// !h, !q, !a
 		} else {
@@ -1595,7 +1766,7 @@ static int smq_invalidate_mapping(struct dm_cache_policy *p, dm_cblock_t cblock)
 
 	// FIXME: what if this block has pending background work?
 	del_queue(mq, e);
-	h_remove(&mq->table, e);
+	table_remove(mq, e);
 	free_entry(&mq->cache_alloc, e);
 	return 0;
 }
@@ -1631,6 +1802,7 @@ static void smq_tick(struct dm_cache_policy *p, bool can_block)
 
 	spin_lock_irqsave(&mq->lock, flags);
 	mq->tick++;
+	fold_shard_stats(mq);
 	update_sentinels(mq);
 	end_hotspot_period(mq);
 	end_cache_period(mq);
@@ -1684,6 +1856,30 @@ static int mq_emit_config_values(struct dm_cache_policy *p, char *result,
 	return 0;
 }
 
+static int smq_emit_config_values(struct dm_cache_policy *p, char *result,
+				  unsigned int maxlen, ssize_t *sz_ptr)
+{
+	struct smq_policy *mq = to_smq_policy(p);
+	unsigned long long fast_hits = 0;
+	unsigned long flags;
+	ssize_t sz = *sz_ptr;
+	unsigned int i;
+
+	spin_lock_irqsave(&mq->lock, flags);
+	for (i = 0; i < NR_SHARDS; i++) {
+		spin_lock(&mq->shards[i].lock);
+		fast_hits += mq->shards[i].fast_hits;
+		spin_unlock(&mq->shards[i].lock);
+	}
+
+	DMEMIT("10 lookups %llu fast_hits %llu promotions %llu demotions %llu writebacks %llu ",
+	       mq->lookups, fast_hits, mq->promotions, mq->demotions, mq->writebacks);
+	spin_unlock_irqrestore(&mq->lock, flags);
+
+	*sz_ptr = sz;
+	return 0;
+}
+
 /* Init the policy plugin interface function pointers. */
 static void init_policy_functions(struct smq_policy *mq, bool mimic_mq)
 {
@@ -1704,7 +1900,8 @@ static void init_policy_functions(struct smq_policy *mq, bool mimic_mq)
 	if (mimic_mq) {
 		mq->policy.set_config_value = mq_set_config_value;
 		mq->policy.emit_config_values = mq_emit_config_values;
-	}
+	} else
+		mq->policy.emit_config_values = smq_emit_config_values;
 }
 
 static bool too_many_hotspot_blocks(sector_t origin_size,
@@ -1788,6 +1985,8 @@ __smq_create(dm_cblock_t cache_size, sector_t origin_size, sector_t cache_block_
 
 	mq->tick = 0;
 	spin_lock_init(&mq->lock);
+	for (i = 0; i < NR_SHARDS; i++)
+		spin_lock_init(&mq->shards[i].lock);
 
 	q_init(&mq->hotspot, &mq->es, NR_HOTSPOT_LEVELS);
 	mq->hotspot.nr_top_levels = 8;
@@ -1865,7 +2064,7 @@ static struct dm_cache_policy *cleaner_create(dm_cblock_t cache_size,
 
 static struct dm_cache_policy_type smq_policy_type = {
 	.name = "smq",
-	.version = {2, 0, 0},
+	.version = {2, 1, 0},
 	.hint_size = 4,
 	.owner = THIS_MODULE,
 	.create = smq_create
@@ -1881,7 +2080,7 @@ static struct dm_cache_policy_type mq_policy_type = {
 
 static struct dm_cache_policy_type cleaner_policy_type = {
 	.name = "cleaner",
-	.version = {2, 0, 0},
+	.version = {2, 1, 0},
 	.hint_size = 4,
 	.owner = THIS_MODULE,
 	.create = cleaner_create,
@@ -1889,7 +2088,7 @@ static struct dm_cache_policy_type cleaner_policy_type = {
 
 static struct dm_cache_policy_type default_policy_type = {
 	.name = "default",
-	.version = {2, 0, 0},
+	.version = {2, 1, 0},
 	.hint_size = 4,
 	.owner = THIS_MODULE,
 	.create = smq_create,
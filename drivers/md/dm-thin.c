@@ -32,8 +32,10 @@
 #define MAPPING_POOL_SIZE 1024
 #define COMMIT_PERIOD HZ
 #define NO_SPACE_TIMEOUT_SECS 60
+#define MAP_CACHE_SIZE 1024
 
 static unsigned int no_space_timeout_secs = NO_SPACE_TIMEOUT_SECS;
+static unsigned int map_cache_size = MAP_CACHE_SIZE;
 
 DECLARE_DM_KCOPYD_THROTTLE_WITH_MODULE_PARM(snapshot_copy_throttle,
 		"A percentage of time allocated for copy on write");
@@ -252,6 +254,7 @@ struct pool {
 
 	struct work_struct worker;
 	struct workqueue_struct *wq;
+	struct workqueue_struct *lookup_wq;	/* runs the per-thin lookup workers */
 	struct throttle throttle;
 	struct delayed_work waker;
 	struct delayed_work no_space_timeout;
@@ -354,6 +357,23 @@ struct thin_c {
 	struct bio_list retry_on_resume_list;
 	struct rb_root sort_bio_list; /* sorted list of deferred bios */
 
+	/*
+	 * Cells whose mapping lookup would have blocked in the map function.
+	 * The lookup worker does the blocking lookup and issues the ones
+	 * that turn out to be mapped, so they need not wait for the pool's
+	 * single worker.  Everything else is passed on to that.
+	 */
+	struct list_head lookup_cells;
+	struct work_struct lookup_worker;
+
+	/*
+	 * Direct mapped cache of recently used, unshared mappings, read
+	 * under RCU.  Bumping map_gen invalidates all entries at once.
+	 */
+	struct thin_map __rcu **map_cache;
+	unsigned int map_cache_mask;
+	atomic_t map_gen;
+
 	/*
 	 * Ensures the thin is not destroyed until the worker has finished
 	 * iterating the active_thins list.
@@ -376,6 +396,134 @@ static sector_t block_to_sectors(struct pool *pool, dm_block_t b)
 		(b * pool->sectors_per_block);
 }
 
+/*----------------------------------------------------------------
+ * Mapping cache
+ *--------------------------------------------------------------*/
+
+struct thin_map {
+	dm_block_t virt_block;
+	dm_block_t data_block;
+	unsigned int gen;
+	struct rcu_head rcu;
+};
+
+static struct kmem_cache *_thin_map_cache;
+
+static int thin_map_cache_create(struct thin_c *tc)
+{
+	unsigned int size = READ_ONCE(map_cache_size);
+
+	atomic_set(&tc->map_gen, 0);
+	if (!size)
+		return 0;
+
+	size = roundup_pow_of_two(min(size, 1U << 20));
+	tc->map_cache = kvcalloc(size, sizeof(*tc->map_cache), GFP_KERNEL);
+	if (!tc->map_cache)
+		return -ENOMEM;
+	tc->map_cache_mask = size - 1;
+
+	return 0;
+}
+
+/* Only called once no lookups can be running any more */
+static void thin_map_cache_destroy(struct thin_c *tc)
+{
+	unsigned int i;
+
+	if (!tc->map_cache)
+		return;
+
+	for (i = 0; i <= tc->map_cache_mask; i++) {
+		struct thin_map *m = rcu_dereference_protected(tc->map_cache[i], 1);
+
+		if (m)
+			kmem_cache_free(_thin_map_cache, m);
+	}
+	kvfree(tc->map_cache);
+}
+
+static unsigned int thin_map_gen(struct thin_c *tc)
+{
+	return atomic_read(&tc->map_gen);
+}
+
+static bool thin_map_lookup(struct thin_c *tc, dm_block_t block,
+			    dm_block_t *data_block)
+{
+	struct thin_map *m;
+	bool found = false;
+
+	if (!tc->map_cache)
+		return false;
+
+	rcu_read_lock();
+	m = rcu_dereference(tc->map_cache[block & tc->map_cache_mask]);
+	if (m && m->virt_block == block && m->gen == thin_map_gen(tc)) {
+		*data_block = m->data_block;
+		found = true;
+	}
+	rcu_read_unlock();
+
+	return found;
+}
+
+/*
+ * Cache an unshared mapping.  @gen must have been sampled before the
+ * lookup that found the mapping, so that a mapping that was invalidated
+ * while the lookup ran never becomes visible.
+ */
+static void thin_map_insert(struct thin_c *tc, dm_block_t block,
+			    dm_block_t data_block, unsigned int gen)
+{
+	struct thin_map __rcu **slot;
+	struct thin_map *m, *old;
+
+	if (!tc->map_cache || gen != thin_map_gen(tc))
+		return;
+
+	slot = &tc->map_cache[block & tc->map_cache_mask];
+	rcu_read_lock();
+	m = rcu_dereference(*slot);
+	if (m && m->virt_block == block && m->data_block == data_block &&
+	    m->gen == gen) {
+		rcu_read_unlock();
+		return;
+	}
+	rcu_read_unlock();
+
+	m = kmem_cache_alloc(_thin_map_cache, GFP_NOWAIT | __GFP_NOWARN);
+	if (!m)
+		return;
+	m->virt_block = block;
+	m->data_block = data_block;
+	m->gen = gen;
+
+	old = unrcu_pointer(xchg(slot, RCU_INITIALIZER(m)));
+	if (old)
+		kfree_rcu(old, rcu);
+}
+
+/*
+ * Must be called whenever existing mappings of the thin may have been
+ * removed, replaced or become shared, before any bio held off by the
+ * change is released.
+ */
+static void thin_map_invalidate(struct thin_c *tc)
+{
+	atomic_inc(&tc->map_gen);
+}
+
+static void pool_map_invalidate(struct pool *pool)
+{
+	struct thin_c *tc;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(tc, &pool->active_thins, list)
+		thin_map_invalidate(tc);
+	rcu_read_unlock();
+}
+
 /*----------------------------------------------------------------*/
 
 struct discard_op {
@@ -1012,6 +1160,7 @@ static void process_prepared_mapping(struct dm_thin_new_mapping *m)
 		cell_error(pool, m->cell);
 		goto out;
 	}
+	thin_map_insert(tc, m->virt_begin, m->data_block, thin_map_gen(tc));
 
 	/*
 	 * Release any bios held while the block was being provisioned.
@@ -1062,6 +1211,7 @@ static void process_prepared_discard_no_passdown(struct dm_thin_new_mapping *m)
 	struct thin_c *tc = m->tc;
 
 	r = dm_thin_remove_range(tc->td, m->cell->key.block_begin, m->cell->key.block_end);
+	thin_map_invalidate(tc);
 	if (r) {
 		metadata_operation_failed(tc->pool, "dm_thin_remove_range", r);
 		bio_io_error(m->bio);
@@ -1158,6 +1308,7 @@ static void process_prepared_discard_passdown_pt1(struct dm_thin_new_mapping *m)
 	 * the function.
 	 */
 	r = dm_thin_remove_range(tc->td, m->virt_begin, m->virt_end);
+	thin_map_invalidate(tc);
 	if (r) {
 		metadata_operation_failed(pool, "dm_thin_remove_range", r);
 		bio_io_error(m->bio);
@@ -1957,18 +2108,21 @@ static void process_cell(struct thin_c *tc, struct dm_bio_prison_cell *cell)
 	struct bio *bio = cell->holder;
 	dm_block_t block = get_bio_block(tc, bio);
 	struct dm_thin_lookup_result lookup_result;
+	unsigned int gen;
 
 	if (tc->requeue_mode) {
 		cell_requeue(pool, cell);
 		return;
 	}
 
+	gen = thin_map_gen(tc);
 	r = dm_thin_find_block(tc->td, block, 1, &lookup_result);
 	switch (r) {
 	case 0:
 		if (lookup_result.shared)
 			process_shared_bio(tc, bio, block, &lookup_result, cell);
 		else {
+			thin_map_insert(tc, block, lookup_result.block, gen);
 			inc_all_io_entry(pool, bio);
 			remap_and_issue(tc, bio, lookup_result.block);
 			inc_remap_and_issue_cell(tc, cell, lookup_result.block);
@@ -2633,8 +2787,10 @@ static void set_pool_mode(struct pool *pool, enum pool_mode new_mode)
 	 */
 	pt->adjusted_pf.mode = new_mode;
 
-	if (old_mode != new_mode)
+	if (old_mode != new_mode) {
+		pool_map_invalidate(pool);
 		notify_of_pool_mode_change(pool);
+	}
 }
 
 static void abort_transaction(struct pool *pool)
@@ -2646,6 +2802,8 @@ static void abort_transaction(struct pool *pool)
 		DMERR("%s: failed to abort metadata transaction", dev_name);
 		set_pool_mode(pool, PM_FAIL);
 	}
+	/* Mappings made since the last commit have been rolled back */
+	pool_map_invalidate(pool);
 
 	if (dm_pool_metadata_set_needs_check(pool->pmd)) {
 		DMERR("%s: failed to set 'needs_check' flag in metadata", dev_name);
@@ -2704,6 +2862,64 @@ static void thin_defer_cell(struct thin_c *tc, struct dm_bio_prison_cell *cell)
 	wake_worker(pool);
 }
 
+static void thin_defer_lookup(struct thin_c *tc, struct dm_bio_prison_cell *cell)
+{
+	spin_lock_irq(&tc->lock);
+	list_add_tail(&cell->user_list, &tc->lookup_cells);
+	spin_unlock_irq(&tc->lock);
+
+	queue_work(tc->pool->lookup_wq, &tc->lookup_worker);
+}
+
+/*
+ * Per-thin worker for cells whose lookup would have blocked.  It does what
+ * the map function would have done had the metadata been in core, so that
+ * already provisioned I/O to different thins is remapped in parallel.
+ */
+static void do_thin_lookups(struct work_struct *ws)
+{
+	struct thin_c *tc = container_of(ws, struct thin_c, lookup_worker);
+	struct pool *pool = tc->pool;
+	struct dm_bio_prison_cell *cell, *tmp;
+	struct dm_thin_lookup_result result;
+	struct blk_plug plug;
+	struct bio *bio;
+	dm_block_t block;
+	unsigned int gen;
+	LIST_HEAD(cells);
+	int r;
+
+	spin_lock_irq(&tc->lock);
+	list_splice_init(&tc->lookup_cells, &cells);
+	spin_unlock_irq(&tc->lock);
+
+	blk_start_plug(&plug);
+	list_for_each_entry_safe(cell, tmp, &cells, user_list) {
+		list_del(&cell->user_list);
+		bio = cell->holder;
+
+		if (tc->requeue_mode || get_pool_mode(pool) != PM_WRITE) {
+			thin_defer_cell(tc, cell);
+			continue;
+		}
+
+		block = get_bio_block(tc, bio);
+		gen = thin_map_gen(tc);
+		r = dm_thin_find_block(tc->td, block, 1, &result);
+		if (r || result.shared) {
+			/* Provisioning, sharing and errors are the pool's job */
+			thin_defer_cell(tc, cell);
+			continue;
+		}
+
+		thin_map_insert(tc, block, result.block, gen);
+		inc_all_io_entry(pool, bio);
+		remap_and_issue(tc, bio, result.block);
+		inc_remap_and_issue_cell(tc, cell, result.block);
+	}
+	blk_finish_plug(&plug);
+}
+
 static void thin_hook_bio(struct thin_c *tc, struct bio *bio)
 {
 	struct dm_thin_endio_hook *h = dm_per_bio_data(bio, sizeof(struct dm_thin_endio_hook));
@@ -2727,6 +2943,7 @@ static int thin_bio_map(struct dm_target *ti, struct bio *bio)
 	struct dm_thin_lookup_result result;
 	struct dm_bio_prison_cell *virt_cell, *data_cell;
 	struct dm_cell_key key;
+	unsigned int gen;
 
 	thin_hook_bio(tc, bio);
 
@@ -2754,7 +2971,15 @@ static int thin_bio_map(struct dm_target *ti, struct bio *bio)
 	if (bio_detain(tc->pool, &key, bio, &virt_cell))
 		return DM_MAPIO_SUBMITTED;
 
-	r = dm_thin_find_block(td, block, 0, &result);
+	gen = thin_map_gen(tc);
+	if (thin_map_lookup(tc, block, &result.block)) {
+		result.shared = false;
+		r = 0;
+	} else {
+		r = dm_thin_find_block(td, block, 0, &result);
+		if (!r && !result.shared)
+			thin_map_insert(tc, block, result.block, gen);
+	}
 
 	/*
 	 * Note that we defer readahead too.
@@ -2794,10 +3019,13 @@ static int thin_bio_map(struct dm_target *ti, struct bio *bio)
 		return DM_MAPIO_REMAPPED;
 
 	case -ENODATA:
-	case -EWOULDBLOCK:
 		thin_defer_cell(tc, virt_cell);
 		return DM_MAPIO_SUBMITTED;
 
+	case -EWOULDBLOCK:
+		thin_defer_lookup(tc, virt_cell);
+		return DM_MAPIO_SUBMITTED;
+
 	default:
 		/*
 		 * Must always call bio_io_error on failure.
@@ -2922,6 +3150,8 @@ static void __pool_destroy(struct pool *pool)
 	cancel_delayed_work_sync(&pool->no_space_timeout);
 	if (pool->wq)
 		destroy_workqueue(pool->wq);
+	if (pool->lookup_wq)
+		destroy_workqueue(pool->lookup_wq);
 
 	if (pool->next_mapping)
 		mempool_free(pool->next_mapping, &pool->mapping_pool);
@@ -2992,6 +3222,14 @@ static struct pool *pool_create(struct mapped_device *pool_md,
 		goto bad_wq;
 	}
 
+	pool->lookup_wq = alloc_workqueue("dm-" DM_MSG_PREFIX "-lookup",
+					  WQ_MEM_RECLAIM | WQ_UNBOUND, 0);
+	if (!pool->lookup_wq) {
+		*error = "Error creating pool's lookup workqueue";
+		err_p = ERR_PTR(-ENOMEM);
+		goto bad_lookup_wq;
+	}
+
 	throttle_init(&pool->throttle);
 	INIT_WORK(&pool->worker, do_worker);
 	INIT_DELAYED_WORK(&pool->waker, do_waker);
@@ -3055,6 +3293,8 @@ static struct pool *pool_create(struct mapped_device *pool_md,
 bad_all_io_ds:
 	dm_deferred_set_destroy(pool->shared_read_ds);
 bad_shared_read_ds:
+	destroy_workqueue(pool->lookup_wq);
+bad_lookup_wq:
 	destroy_workqueue(pool->wq);
 bad_wq:
 	dm_kcopyd_client_destroy(pool->copier);
@@ -3673,6 +3913,7 @@ static void pool_postsuspend(struct dm_target *ti)
 
 	cancel_delayed_work_sync(&pool->waker);
 	cancel_delayed_work_sync(&pool->no_space_timeout);
+	flush_workqueue(pool->lookup_wq);
 	flush_workqueue(pool->wq);
 	(void) commit(pool);
 }
@@ -3742,6 +3983,8 @@ static int process_create_snap_mesg(unsigned int argc, char **argv, struct pool
 		return r;
 
 	r = dm_pool_create_snap(pool->pmd, dev_id, origin_dev_id);
+	/* The origin's mappings are shared now */
+	pool_map_invalidate(pool);
 	if (r) {
 		DMWARN("Creation of new snapshot %s of device %s failed.",
 		       argv[1], argv[2]);
@@ -4155,6 +4398,8 @@ static void thin_dtr(struct dm_target *ti)
 
 	thin_put(tc);
 	wait_for_completion(&tc->can_destroy);
+	flush_work(&tc->lookup_worker);
+	thin_map_cache_destroy(tc);
 
 	mutex_lock(&dm_thin_pool_table.mutex);
 
@@ -4207,6 +4452,14 @@ static int thin_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	bio_list_init(&tc->deferred_bio_list);
 	bio_list_init(&tc->retry_on_resume_list);
 	tc->sort_bio_list = RB_ROOT;
+	INIT_LIST_HEAD(&tc->lookup_cells);
+	INIT_WORK(&tc->lookup_worker, do_thin_lookups);
+
+	r = thin_map_cache_create(tc);
+	if (r) {
+		ti->error = "Error allocating mapping cache";
+		goto bad_origin_dev;
+	}
 
 	if (argc == 3) {
 		if (!strcmp(argv[0], argv[2])) {
@@ -4318,6 +4571,7 @@ static int thin_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	if (tc->origin_dev)
 		dm_put_device(ti, tc->origin_dev);
 bad_origin_dev:
+	thin_map_cache_destroy(tc);
 	kfree(tc);
 out_unlock:
 	mutex_unlock(&dm_thin_pool_table.mutex);
@@ -4383,6 +4637,9 @@ static void thin_postsuspend(struct dm_target *ti)
 {
 	struct thin_c *tc = ti->private;
 
+	/* Lookups still queued are handed to the pool worker */
+	flush_work(&tc->lookup_worker);
+
 	/*
 	 * The dm_noflush_suspending flag has been cleared by now, so
 	 * unfortunately we must always run this.
@@ -4523,6 +4780,10 @@ static int __init dm_thin_init(void)
 	if (!_new_mapping_cache)
 		return r;
 
+	_thin_map_cache = KMEM_CACHE(thin_map, 0);
+	if (!_thin_map_cache)
+		goto bad_thin_map_cache;
+
 	r = dm_register_target(&thin_target);
 	if (r)
 		goto bad_new_mapping_cache;
@@ -4536,6 +4797,8 @@ static int __init dm_thin_init(void)
 bad_thin_target:
 	dm_unregister_target(&thin_target);
 bad_new_mapping_cache:
+	kmem_cache_destroy(_thin_map_cache);
+bad_thin_map_cache:
 	kmem_cache_destroy(_new_mapping_cache);
 
 	return r;
@@ -4546,6 +4809,7 @@ static void dm_thin_exit(void)
 	dm_unregister_target(&thin_target);
 	dm_unregister_target(&pool_target);
 
+	kmem_cache_destroy(_thin_map_cache);
 	kmem_cache_destroy(_new_mapping_cache);
 
 	pool_table_exit();
@@ -4557,6 +4821,9 @@ module_exit(dm_thin_exit);
 module_param_named(no_space_timeout, no_space_timeout_secs, uint, 0644);
 MODULE_PARM_DESC(no_space_timeout, "Out of data space queue IO timeout in seconds");
 
+module_param(map_cache_size, uint, 0644);
+MODULE_PARM_DESC(map_cache_size, "Number of mappings cached per thin device, 0 to disable");
+
 MODULE_DESCRIPTION(DM_NAME " thin provisioning target");
 MODULE_AUTHOR("Joe Thornber <dm-devel@lists.linux.dev>");
 MODULE_LICENSE("GPL");
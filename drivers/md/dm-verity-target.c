@@ -210,6 +210,25 @@ int verity_hash(struct dm_verity *v, struct dm_verity_io *io,
 	return r;
 }
 
+/*
+ * Hash several data blocks at once.  Only used with shash_tfm, as
+ * v->mb_max_msgs is 1 for ahash.
+ */
+static int verity_hash_mb(struct dm_verity *v, struct dm_verity_io *io,
+			  const u8 * const data[], size_t len,
+			  u8 * const digests[], unsigned int num_blocks)
+{
+	struct shash_desc *desc = verity_io_hash_req(v, io);
+	int r;
+
+	desc->tfm = v->shash_tfm;
+	r = crypto_shash_import(desc, v->initial_hashstate) ?:
+	    crypto_shash_finup_mb(desc, data, len, digests, num_blocks);
+	if (unlikely(r))
+		DMERR("Error hashing blocks: %d", r);
+	return r;
+}
+
 static void verity_hash_at_level(struct dm_verity *v, sector_t block, int level,
 				 sector_t *hash_block, unsigned int *offset)
 {
@@ -413,6 +432,76 @@ int verity_hash_for_block(struct dm_verity *v, struct dm_verity_io *io,
 	return r;
 }
 
+/*
+ * Consecutive data blocks usually have their hashes in the same level 0 hash
+ * block.  Once that block has been verified, it is kept held while the rest
+ * of the bio is verified, and the wanted digests are copied straight out of
+ * it instead of looking the hash block up in dm-bufio for every data block.
+ */
+struct verity_hash_cursor {
+	struct dm_buffer *buf;
+	sector_t hash_block;
+	const u8 *data;
+};
+
+static bool verity_cursor_get_digest(struct dm_verity *v,
+				     struct verity_hash_cursor *c,
+				     sector_t block, u8 *digest, bool *is_zero)
+{
+	sector_t hash_block;
+	unsigned int offset;
+
+	if (!c->buf)
+		return false;
+
+	verity_hash_at_level(v, block, 0, &hash_block, &offset);
+	if (hash_block != c->hash_block) {
+		dm_bufio_release(c->buf);
+		c->buf = NULL;
+		return false;
+	}
+
+	memcpy(digest, c->data + offset, v->digest_size);
+	*is_zero = v->zero_digest &&
+		   !memcmp(v->zero_digest, digest, v->digest_size);
+	return true;
+}
+
+static void verity_cursor_fill(struct dm_verity *v,
+			       struct verity_hash_cursor *c, sector_t block)
+{
+	struct buffer_aux *aux;
+	struct dm_buffer *buf;
+	sector_t hash_block;
+	u8 *data;
+
+	if (!v->levels)
+		return;
+
+	verity_hash_at_level(v, block, 0, &hash_block, NULL);
+	data = dm_bufio_get(v->bufio, hash_block, &buf);
+	if (IS_ERR_OR_NULL(data))
+		return;
+
+	aux = dm_bufio_get_aux_data(buf);
+	if (!aux->hash_verified) {
+		dm_bufio_release(buf);
+		return;
+	}
+
+	c->buf = buf;
+	c->hash_block = hash_block;
+	c->data = data;
+}
+
+static void verity_cursor_release(struct verity_hash_cursor *c)
+{
+	if (c->buf) {
+		dm_bufio_release(c->buf);
+		c->buf = NULL;
+	}
+}
+
 static noinline int verity_recheck(struct dm_verity *v, struct dm_verity_io *io,
 				   sector_t cur_block, u8 *dest)
 {
@@ -489,6 +578,127 @@ static int verity_handle_data_hash_mismatch(struct dm_verity *v,
 	return 0;
 }
 
+static void verity_clear_pending_blocks(struct dm_verity_io *io)
+{
+	int i;
+
+	for (i = io->num_pending - 1; i >= 0; i--) {
+		kunmap_local(io->pending_blocks[i].data);
+		io->pending_blocks[i].data = NULL;
+	}
+	io->num_pending = 0;
+}
+
+static int verity_verify_pending_blocks(struct dm_verity *v,
+					struct dm_verity_io *io,
+					struct bio *bio)
+{
+	const unsigned int block_size = 1 << v->data_dev_block_bits;
+	const u8 *data[DM_VERITY_MAX_PENDING_DATA_BLOCKS];
+	u8 *real_digests[DM_VERITY_MAX_PENDING_DATA_BLOCKS];
+	int i, r;
+
+	if (io->num_pending == 1) {
+		struct pending_block *block = &io->pending_blocks[0];
+
+		r = verity_hash(v, io, block->data, block_size,
+				block->real_digest, !io->in_bh);
+	} else {
+		for (i = 0; i < io->num_pending; i++) {
+			data[i] = io->pending_blocks[i].data;
+			real_digests[i] = io->pending_blocks[i].real_digest;
+		}
+		r = verity_hash_mb(v, io, data, block_size, real_digests,
+				   io->num_pending);
+	}
+	if (unlikely(r))
+		return r;
+
+	this_cpu_add(v->stats->blocks, io->num_pending);
+
+	for (i = 0; i < io->num_pending; i++) {
+		struct pending_block *block = &io->pending_blocks[i];
+
+		if (likely(memcmp(block->real_digest, block->want_digest,
+				  v->digest_size) == 0)) {
+			if (v->validated_blocks)
+				set_bit(block->blkno, v->validated_blocks);
+			continue;
+		}
+		/* Recheck and FEC work on the digests in the io itself. */
+		memcpy(verity_io_want_digest(v, io), block->want_digest,
+		       v->digest_size);
+		r = verity_handle_data_hash_mismatch(v, io, bio, block->blkno,
+						     block->data);
+		if (unlikely(r))
+			return r;
+	}
+
+	return 0;
+}
+
+static void verity_prefetch_blocks(struct dm_verity *v, sector_t block,
+				   unsigned int n_blocks, unsigned short ioprio)
+{
+	int i;
+
+	for (i = v->levels - 2; i >= 0; i--) {
+		sector_t hash_block_start;
+		sector_t hash_block_end;
+
+		verity_hash_at_level(v, block, i, &hash_block_start, NULL);
+		verity_hash_at_level(v, block + n_blocks - 1, i, &hash_block_end, NULL);
+
+		if (!i) {
+			unsigned int cluster = READ_ONCE(dm_verity_prefetch_cluster);
+
+			cluster >>= v->data_dev_block_bits;
+			if (unlikely(!cluster))
+				goto no_prefetch_cluster;
+
+			if (unlikely(cluster & (cluster - 1)))
+				cluster = 1 << __fls(cluster);
+
+			hash_block_start &= ~(sector_t)(cluster - 1);
+			hash_block_end |= cluster - 1;
+			if (unlikely(hash_block_end >= v->hash_blocks))
+				hash_block_end = v->hash_blocks - 1;
+		}
+no_prefetch_cluster:
+		dm_bufio_prefetch_with_ioprio(v->bufio, hash_block_start,
+					hash_block_end - hash_block_start + 1,
+					ioprio);
+	}
+}
+
+/*
+ * Called before verifying an io in process context.  If the level 0 hash
+ * block is not cached yet, the prefetch queued by verity_map() has not run
+ * or has not completed, so issue the reads for all tree levels now.  Then
+ * the synchronous reads during verification wait for I/O that is already
+ * in flight for every level, instead of reading one level after another.
+ */
+static void verity_prefetch_missing(struct dm_verity *v,
+				    struct dm_verity_io *io,
+				    unsigned short ioprio)
+{
+	struct dm_buffer *buf;
+	sector_t hash_block;
+	void *data;
+
+	if (v->levels < 2)
+		return;
+
+	verity_hash_at_level(v, io->block, 0, &hash_block, NULL);
+	data = dm_bufio_get(v->bufio, hash_block, &buf);
+	if (!IS_ERR_OR_NULL(data)) {
+		dm_bufio_release(buf);
+		return;
+	}
+
+	verity_prefetch_blocks(v, io->block, io->n_blocks, ioprio);
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
@@ -499,7 +709,9 @@ static int verity_verify_io(struct dm_verity_io *io)
 	struct bvec_iter iter_copy;
 	struct bvec_iter *iter;
 	struct bio *bio = dm_bio_from_per_bio_data(io, v->ti->per_io_data_size);
+	struct verity_hash_cursor cursor = {};
 	unsigned int b;
+	int r;
 
 	if (static_branch_unlikely(&use_bh_wq_enabled) && io->in_bh) {
 		/*
@@ -508,13 +720,15 @@ static int verity_verify_io(struct dm_verity_io *io)
 		 */
 		iter_copy = io->iter;
 		iter = &iter_copy;
-	} else
+	} else {
 		iter = &io->iter;
+		verity_prefetch_missing(v, io, bio_prio(bio));
+	}
 
 	for (b = 0; b < io->n_blocks;
 	     b++, bio_advance_iter(bio, iter, block_size)) {
-		int r;
 		sector_t cur_block = io->block + b;
+		struct pending_block *block;
 		bool is_zero;
 		struct bio_vec bv;
 		void *data;
@@ -523,11 +737,16 @@ static int verity_verify_io(struct dm_verity_io *io)
 		    likely(test_bit(cur_block, v->validated_blocks)))
 			continue;
 
-		r = verity_hash_for_block(v, io, cur_block,
-					  verity_io_want_digest(v, io),
-					  &is_zero);
-		if (unlikely(r < 0))
-			return r;
+		block = &io->pending_blocks[io->num_pending];
+
+		if (!verity_cursor_get_digest(v, &cursor, cur_block,
+					      block->want_digest, &is_zero)) {
+			r = verity_hash_for_block(v, io, cur_block,
+						  block->want_digest, &is_zero);
+			if (unlikely(r < 0))
+				goto error;
+			verity_cursor_fill(v, &cursor, cur_block);
+		}
 
 		bv = bio_iter_iovec(bio, *iter);
 		if (unlikely(bv.bv_len < block_size)) {
@@ -538,7 +757,8 @@ static int verity_verify_io(struct dm_verity_io *io)
 			 * data block size to be greater than PAGE_SIZE.
 			 */
 			DMERR_LIMIT("unaligned io (data block spans pages)");
-			return -EIO;
+			r = -EIO;
+			goto error;
 		}
 
 		data = bvec_kmap_local(&bv);
@@ -553,28 +773,30 @@ static int verity_verify_io(struct dm_verity_io *io)
 			continue;
 		}
 
-		r = verity_hash(v, io, data, block_size,
-				verity_io_real_digest(v, io), !io->in_bh);
-		if (unlikely(r < 0)) {
-			kunmap_local(data);
-			return r;
+		block->data = data;
+		block->blkno = cur_block;
+		if (++io->num_pending == v->mb_max_msgs) {
+			r = verity_verify_pending_blocks(v, io, bio);
+			if (unlikely(r))
+				goto error;
+			verity_clear_pending_blocks(io);
 		}
+	}
 
-		if (likely(memcmp(verity_io_real_digest(v, io),
-				  verity_io_want_digest(v, io), v->digest_size) == 0)) {
-			if (v->validated_blocks)
-				set_bit(cur_block, v->validated_blocks);
-			kunmap_local(data);
-			continue;
-		}
-		r = verity_handle_data_hash_mismatch(v, io, bio, cur_block,
-						     data);
-		kunmap_local(data);
+	if (io->num_pending) {
+		r = verity_verify_pending_blocks(v, io, bio);
 		if (unlikely(r))
-			return r;
+			goto error;
+		verity_clear_pending_blocks(io);
 	}
 
+	verity_cursor_release(&cursor);
 	return 0;
+
+error:
+	verity_clear_pending_blocks(io);
+	verity_cursor_release(&cursor);
+	return r;
 }
 
 /*
@@ -594,6 +816,17 @@ static void restart_io_error(struct work_struct *w)
 /*
  * End one "io" structure with a given error.
  */
+static void verity_account_io(struct dm_verity *v, struct dm_verity_io *io)
+{
+	u64 ns = ktime_get_ns() - io->start_ns;
+	s64 max = atomic64_read(&v->max_verify_ns);
+
+	this_cpu_inc(v->stats->bios);
+	this_cpu_add(v->stats->verify_ns, ns);
+	while (ns > max && !atomic64_try_cmpxchg(&v->max_verify_ns, &max, ns))
+		;
+}
+
 static void verity_finish_io(struct dm_verity_io *io, blk_status_t status)
 {
 	struct dm_verity *v = io->v;
@@ -602,6 +835,9 @@ static void verity_finish_io(struct dm_verity_io *io, blk_status_t status)
 	bio->bi_end_io = io->orig_bi_end_io;
 	bio->bi_status = status;
 
+	if (io->start_ns)
+		verity_account_io(v, io);
+
 	if (!static_branch_unlikely(&use_bh_wq_enabled) || !io->in_bh)
 		verity_fec_finish_io(io);
 
@@ -664,6 +900,8 @@ static void verity_end_io(struct bio *bio)
 		return;
 	}
 
+	io->start_ns = ktime_get_ns();
+
 	if (static_branch_unlikely(&use_bh_wq_enabled) && io->v->use_bh_wq) {
 		INIT_WORK(&io->bh_work, verity_bh_work);
 		queue_work(system_bh_wq, &io->bh_work);
@@ -682,37 +920,8 @@ static void verity_prefetch_io(struct work_struct *work)
 {
 	struct dm_verity_prefetch_work *pw =
 		container_of(work, struct dm_verity_prefetch_work, work);
-	struct dm_verity *v = pw->v;
-	int i;
-
-	for (i = v->levels - 2; i >= 0; i--) {
-		sector_t hash_block_start;
-		sector_t hash_block_end;
-
-		verity_hash_at_level(v, pw->block, i, &hash_block_start, NULL);
-		verity_hash_at_level(v, pw->block + pw->n_blocks - 1, i, &hash_block_end, NULL);
-
-		if (!i) {
-			unsigned int cluster = READ_ONCE(dm_verity_prefetch_cluster);
-
-			cluster >>= v->data_dev_block_bits;
-			if (unlikely(!cluster))
-				goto no_prefetch_cluster;
-
-			if (unlikely(cluster & (cluster - 1)))
-				cluster = 1 << __fls(cluster);
-
-			hash_block_start &= ~(sector_t)(cluster - 1);
-			hash_block_end |= cluster - 1;
-			if (unlikely(hash_block_end >= v->hash_blocks))
-				hash_block_end = v->hash_blocks - 1;
-		}
-no_prefetch_cluster:
-		dm_bufio_prefetch_with_ioprio(v->bufio, hash_block_start,
-					hash_block_end - hash_block_start + 1,
-					pw->ioprio);
-	}
 
+	verity_prefetch_blocks(pw->v, pw->block, pw->n_blocks, pw->ioprio);
 	kfree(pw);
 }
 
@@ -782,6 +991,8 @@ static int verity_map(struct dm_target *ti, struct bio *bio)
 	io->block = bio->bi_iter.bi_sector >> (v->data_dev_block_bits - SECTOR_SHIFT);
 	io->n_blocks = bio->bi_iter.bi_size >> v->data_dev_block_bits;
 	io->had_mismatch = false;
+	io->num_pending = 0;
+	io->start_ns = 0;
 
 	bio->bi_end_io = verity_end_io;
 	bio->bi_private = io;
@@ -797,7 +1008,14 @@ static int verity_map(struct dm_target *ti, struct bio *bio)
 }
 
 /*
- * Status: V (valid) or C (corruption found)
+ * Status: V (valid) or C (corruption found), followed since target
+ * version 1.11.0 by:
+ *	<bios>		Number of bios verified.
+ *	<blocks>	Number of data blocks hashed.
+ *	<avg_us>	Average time from data read completion to bio
+ *			completion, in microseconds.
+ *	<max_us>	Maximum of that time, in microseconds.
+ * The first field is unchanged, so parsers that only read it still work.
  */
 static void verity_status(struct dm_target *ti, status_type_t type,
 			  unsigned int status_flags, char *result, unsigned int maxlen)
@@ -808,9 +1026,24 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 	unsigned int x;
 
 	switch (type) {
-	case STATUSTYPE_INFO:
+	case STATUSTYPE_INFO: {
+		struct dm_verity_stats sum = {};
+		int cpu;
+
+		for_each_possible_cpu(cpu) {
+			struct dm_verity_stats *st = per_cpu_ptr(v->stats, cpu);
+
+			sum.bios += st->bios;
+			sum.blocks += st->blocks;
+			sum.verify_ns += st->verify_ns;
+		}
 		DMEMIT("%c", v->hash_failed ? 'C' : 'V');
+		DMEMIT(" %llu %llu %llu %llu", sum.bios, sum.blocks,
+		       sum.bios ? div64_u64(sum.verify_ns,
+					    sum.bios * NSEC_PER_USEC) : 0,
+		       div_u64(atomic64_read(&v->max_verify_ns), NSEC_PER_USEC));
 		break;
+	}
 	case STATUSTYPE_TABLE:
 		DMEMIT("%u %s %s %u %u %llu %llu %s ",
 			v->version,
@@ -1035,6 +1268,7 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
+	free_percpu(v->stats);
 	kvfree(v->validated_blocks);
 	kfree(v->salt);
 	kfree(v->initial_hashstate);
@@ -1313,6 +1547,9 @@ static int verity_setup_hash_alg(struct dm_verity *v, const char *alg_name)
 		v->digest_size = crypto_shash_digestsize(shash);
 		v->hash_reqsize = sizeof(struct shash_desc) +
 				  crypto_shash_descsize(shash);
+		v->mb_max_msgs = min_t(unsigned int,
+				       crypto_shash_mb_max_msgs(shash),
+				       DM_VERITY_MAX_PENDING_DATA_BLOCKS);
 		DMINFO("%s using shash \"%s\"", alg_name, driver_name);
 	} else {
 		v->ahash_tfm = ahash;
@@ -1320,6 +1557,7 @@ static int verity_setup_hash_alg(struct dm_verity *v, const char *alg_name)
 		v->digest_size = crypto_ahash_digestsize(ahash);
 		v->hash_reqsize = sizeof(struct ahash_request) +
 				  crypto_ahash_reqsize(ahash);
+		v->mb_max_msgs = 1;
 		DMINFO("%s using ahash \"%s\"", alg_name, driver_name);
 	}
 	if ((1 << v->hash_dev_block_bits) < v->digest_size * 2) {
@@ -1407,6 +1645,13 @@ static int verity_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	ti->private = v;
 	v->ti = ti;
 
+	v->stats = alloc_percpu(struct dm_verity_stats);
+	if (!v->stats) {
+		ti->error = "Cannot allocate statistics";
+		r = -ENOMEM;
+		goto bad;
+	}
+
 	r = verity_fec_ctr_alloc(v);
 	if (r)
 		goto bad;
@@ -1761,7 +2006,7 @@ static struct target_type verity_target = {
 	.name		= "verity",
 /* Note: the LSMs depend on the singleton and immutable features */
 	.features	= DM_TARGET_SINGLETON | DM_TARGET_IMMUTABLE,
-	.version	= {1, 10, 0},
+	.version	= {1, 11, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
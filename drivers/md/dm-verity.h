@@ -19,6 +19,12 @@
 
 #define DM_VERITY_MAX_LEVELS		63
 
+/*
+ * Maximum number of data blocks that are hashed together with
+ * crypto_shash_finup_mb() before they are verified.
+ */
+#define DM_VERITY_MAX_PENDING_DATA_BLOCKS	2
+
 enum verity_mode {
 	DM_VERITY_MODE_EIO,
 	DM_VERITY_MODE_LOGGING,
@@ -33,6 +39,13 @@ enum verity_block_type {
 
 struct dm_verity_fec;
 
+/* Per-CPU verification statistics, summed up in the status output */
+struct dm_verity_stats {
+	u64 bios;		/* bios that went through verification */
+	u64 blocks;		/* data blocks hashed */
+	u64 verify_ns;		/* time from data read completion to bio end */
+};
+
 struct dm_verity {
 	struct dm_dev *data_dev;
 	struct dm_dev *hash_dev;
@@ -59,6 +72,7 @@ struct dm_verity {
 	unsigned char hash_per_block_bits;	/* log2(hashes in hash block) */
 	unsigned char levels;	/* the number of tree levels */
 	unsigned char version;
+	unsigned char mb_max_msgs; /* data blocks to hash at once */
 	bool hash_failed:1;	/* set if hash of any block failed */
 	bool use_bh_wq:1;	/* try to verify in BH wq before normal work-queue */
 	unsigned int digest_size;	/* digest size for the current hash algorithm */
@@ -79,6 +93,17 @@ struct dm_verity {
 
 	struct dm_io_client *io;
 	mempool_t recheck_pool;
+
+	struct dm_verity_stats __percpu *stats;
+	atomic64_t max_verify_ns;
+};
+
+/* A data block that has been mapped but not yet hashed and verified */
+struct pending_block {
+	void *data;
+	sector_t blkno;
+	u8 want_digest[HASH_MAX_DIGESTSIZE];
+	u8 real_digest[HASH_MAX_DIGESTSIZE];
 };
 
 struct dm_verity_io {
@@ -94,12 +119,17 @@ struct dm_verity_io {
 	bool in_bh;
 	bool had_mismatch;
 
+	u64 start_ns;	/* when verification of the data was started */
+
 	struct work_struct work;
 	struct work_struct bh_work;
 
 	u8 real_digest[HASH_MAX_DIGESTSIZE];
 	u8 want_digest[HASH_MAX_DIGESTSIZE];
 
+	int num_pending;
+	struct pending_block pending_blocks[DM_VERITY_MAX_PENDING_DATA_BLOCKS];
+
 	/*
 	 * This struct is followed by a variable-sized hash request of size
 	 * v->hash_reqsize, either a struct ahash_request or a struct shash_desc
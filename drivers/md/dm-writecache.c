@@ -16,6 +16,8 @@
 #include <linux/pfn_t.h>
 #include <linux/libnvdimm.h>
 #include <linux/delay.h>
+#include <linux/percpu.h>
+#include <linux/seqlock.h>
 #include "dm-io-tracker.h"
 
 #define DM_MSG_PREFIX "writecache"
@@ -28,6 +30,7 @@
 #define AUTOCOMMIT_BLOCKS_SSD		65536
 #define AUTOCOMMIT_BLOCKS_PMEM		64
 #define AUTOCOMMIT_MSEC			1000
+#define LOCKLESS_LOOKUP_DEPTH		(2 * BITS_PER_LONG)
 #define MAX_AGE_DIV			16
 #define MAX_AGE_UNSPECIFIED		-1UL
 #define PAUSE_WRITEBACK			(HZ * 3)
@@ -106,8 +109,14 @@ struct wc_entry {
 #endif
 #define WC_MODE_SORT_FREELIST(wc)		(!WC_MODE_PMEM(wc))
 
+struct wc_lockless_stats {
+	unsigned long long reads;
+	unsigned long long writes_around;
+};
+
 struct dm_writecache {
 	struct mutex lock;
+	seqcount_mutex_t tree_seq;	/* changes of tree, for lockless lookups */
 	struct list_head lru;
 	union {
 		struct list_head freelist;
@@ -216,6 +225,8 @@ struct dm_writecache {
 		unsigned long long flushes;
 		unsigned long long discards;
 	} stats;
+	/* blocks mapped to the origin without taking the lock */
+	struct wc_lockless_stats __percpu *lockless_stats;
 };
 
 #define WB_LIST_INLINE		16
@@ -664,8 +675,10 @@ static void writecache_insert_entry(struct dm_writecache *wc, struct wc_entry *i
 		else
 			node = &parent->rb_right;
 	}
-	rb_link_node(&ins->rb_node, parent, node);
+	write_seqcount_begin(&wc->tree_seq);
+	rb_link_node_rcu(&ins->rb_node, parent, node);
 	rb_insert_color(&ins->rb_node, &wc->tree);
+	write_seqcount_end(&wc->tree_seq);
 	list_add(&ins->lru, &wc->lru);
 	ins->age = jiffies;
 }
@@ -673,7 +686,52 @@ static void writecache_insert_entry(struct dm_writecache *wc, struct wc_entry *i
 static void writecache_unlink(struct dm_writecache *wc, struct wc_entry *e)
 {
 	list_del(&e->lru);
+	write_seqcount_begin(&wc->tree_seq);
 	rb_erase(&e->rb_node, &wc->tree);
+	write_seqcount_end(&wc->tree_seq);
+}
+
+/*
+ * Look up @block without wc->lock.  Returns true if the tree, as it was
+ * during the walk, has no entry for @block, and sets *next to the lowest
+ * cached sector above it, or -1 if there is none.
+ *
+ * Entries are never freed while the target exists, they only move between
+ * the tree and the freelist, so following stale pointers is harmless.  The
+ * walk is bounded in case it wanders off into the freetree, and tree_seq
+ * tells whether the result can be trusted.
+ */
+static bool writecache_lockless_miss(struct dm_writecache *wc, uint64_t block,
+				     uint64_t *next)
+{
+	struct rb_node *node;
+	unsigned int depth = 0;
+	unsigned int seq;
+	uint64_t sector;
+
+	seq = raw_read_seqcount(&wc->tree_seq);
+	if (seq & 1)
+		return false;
+
+	*next = -1;
+	node = READ_ONCE(wc->tree.rb_node);
+	while (node) {
+		struct wc_entry *e = container_of(node, struct wc_entry, rb_node);
+
+		if (unlikely(++depth > LOCKLESS_LOOKUP_DEPTH))
+			return false;
+		sector = read_original_sector(wc, e);
+		if (sector == block)
+			return false;
+		if (sector > block) {
+			*next = min(*next, sector);
+			node = READ_ONCE(node->rb_left);
+		} else {
+			node = READ_ONCE(node->rb_right);
+		}
+	}
+
+	return !read_seqcount_retry(&wc->tree_seq, seq);
 }
 
 static void writecache_add_to_freelist(struct dm_writecache *wc, struct wc_entry *e)
@@ -1178,11 +1236,16 @@ static int process_cleaner_mesg(unsigned int argc, char **argv, struct dm_writec
 
 static int process_clear_stats_mesg(unsigned int argc, char **argv, struct dm_writecache *wc)
 {
+	int cpu;
+
 	if (argc != 1)
 		return -EINVAL;
 
 	wc_lock(wc);
 	memset(&wc->stats, 0, sizeof(wc->stats));
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(wc->lockless_stats, cpu), 0,
+		       sizeof(struct wc_lockless_stats));
 	wc_unlock(wc);
 
 	return 0;
@@ -1538,6 +1601,59 @@ static enum wc_map_op writecache_map_discard(struct dm_writecache *wc, struct bi
 	return WC_MAP_RETURN;
 }
 
+/*
+ * Reads of blocks that are not cached, and writes that would go around the
+ * cache anyway, go straight to the origin without serializing on wc->lock.
+ * Hits, and anything racing with a change of the tree, take the locked
+ * path.  A write that completes after the lookup is concurrent with the
+ * bio, so missing it is fine.
+ *
+ * Writes that allocate a cache block still take the lock: the tree insert,
+ * the LRU order and seq_count together define what a commit covers.
+ */
+static bool writecache_map_lockless(struct dm_writecache *wc, struct bio *bio)
+{
+	sector_t sector = dm_target_offset(wc->ti, bio->bi_iter.bi_sector);
+	struct wc_lockless_stats *stats;
+	uint64_t next;
+
+	if (bio_op(bio) == REQ_OP_WRITE) {
+		if (!data_race(wc->cleaner) &&
+		    !(wc->metadata_only && !(bio->bi_opf & REQ_META)))
+			return false;
+		if (writecache_has_error(wc))
+			return false;
+	} else if (bio_op(bio) != REQ_OP_READ) {
+		return false;
+	}
+
+	if (unlikely(((unsigned int)sector | bio_sectors(bio)) &
+		     (wc->block_size / 512 - 1)))
+		return false;
+
+	if (!writecache_lockless_miss(wc, sector, &next))
+		return false;
+
+	bio->bi_iter.bi_sector = sector;
+	if (next - sector < bio_sectors(bio))
+		dm_accept_partial_bio(bio, next - sector);
+
+	stats = get_cpu_ptr(wc->lockless_stats);
+	if (bio_op(bio) == REQ_OP_READ) {
+		stats->reads += bio->bi_iter.bi_size >> wc->block_size_bits;
+	} else {
+		stats->writes_around += bio->bi_iter.bi_size >> wc->block_size_bits;
+		if (likely(wc->pause != 0)) {
+			dm_iot_io_begin(&wc->iot, 1);
+			bio->bi_private = (void *)2;
+		}
+	}
+	put_cpu_ptr(wc->lockless_stats);
+
+	bio_set_dev(bio, wc->dev->bdev);
+	return true;
+}
+
 static int writecache_map(struct dm_target *ti, struct bio *bio)
 {
 	struct dm_writecache *wc = ti->private;
@@ -1545,6 +1661,9 @@ static int writecache_map(struct dm_target *ti, struct bio *bio)
 
 	bio->bi_private = NULL;
 
+	if (!(bio->bi_opf & REQ_PREFLUSH) && writecache_map_lockless(wc, bio))
+		return DM_MAPIO_REMAPPED;
+
 	wc_lock(wc);
 
 	if (unlikely(bio->bi_opf & REQ_PREFLUSH)) {
@@ -2223,6 +2342,8 @@ static void writecache_dtr(struct dm_target *ti)
 
 	vfree(wc->dirty_bitmap);
 
+	free_percpu(wc->lockless_stats);
+
 	kfree(wc);
 }
 
@@ -2257,6 +2378,7 @@ static int writecache_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 	wc->ti = ti;
 
 	mutex_init(&wc->lock);
+	seqcount_mutex_init(&wc->tree_seq, &wc->lock);
 	wc->max_age = MAX_AGE_UNSPECIFIED;
 	writecache_poison_lists(wc);
 	init_waitqueue_head(&wc->freelist_wait);
@@ -2268,6 +2390,13 @@ static int writecache_ctr(struct dm_target *ti, unsigned int argc, char **argv)
 		init_waitqueue_head(&wc->bio_in_progress_wait[i]);
 	}
 
+	wc->lockless_stats = alloc_percpu(struct wc_lockless_stats);
+	if (!wc->lockless_stats) {
+		ti->error = "Cannot allocate statistics";
+		r = -ENOMEM;
+		goto bad;
+	}
+
 	wc->dm_io = dm_io_client_create();
 	if (IS_ERR(wc->dm_io)) {
 		r = PTR_ERR(wc->dm_io);
@@ -2683,19 +2812,28 @@ static void writecache_status(struct dm_target *ti, status_type_t type,
 	struct dm_writecache *wc = ti->private;
 	unsigned int extra_args;
 	unsigned int sz = 0;
+	unsigned long long lockless_reads, lockless_writes;
+	int cpu;
 
 	switch (type) {
 	case STATUSTYPE_INFO:
+		lockless_reads = lockless_writes = 0;
+		for_each_possible_cpu(cpu) {
+			struct wc_lockless_stats *stats = per_cpu_ptr(wc->lockless_stats, cpu);
+
+			lockless_reads += stats->reads;
+			lockless_writes += stats->writes_around;
+		}
 		DMEMIT("%ld %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
 		       writecache_has_error(wc),
 		       (unsigned long long)wc->n_blocks, (unsigned long long)wc->freelist_size,
 		       (unsigned long long)wc->writeback_size,
-		       wc->stats.reads,
+		       wc->stats.reads + lockless_reads,
 		       wc->stats.read_hits,
-		       wc->stats.writes,
+		       wc->stats.writes + lockless_writes,
 		       wc->stats.write_hits_uncommitted,
 		       wc->stats.write_hits_committed,
-		       wc->stats.writes_around,
+		       wc->stats.writes_around + lockless_writes,
 		       wc->stats.writes_allocate,
 		       wc->stats.writes_blocked_on_freelist,
 		       wc->stats.flushes,
@@ -1000,6 +1000,7 @@ static void stripe_add_to_batch_list(struct r5conf *conf,
 	}
 
 	atomic_inc(&sh->count);
+	this_cpu_inc(conf->percpu->stats.stripes_batched);
 unlock_out:
 	unlock_two_stripes(head, sh);
 out:
@@ -2102,6 +2103,10 @@ ops_run_reconstruct5(struct stripe_head *sh, struct raid5_percpu *percpu,
 	 * set ASYNC_TX_XOR_DROP_DST and ASYNC_TX_XOR_ZERO_DST
 	 * for the synchronous xor case
 	 */
+	percpu->stats.parity_stripes++;
+	percpu->stats.parity_bytes += (u64)(disks - 1) *
+				      RAID5_STRIPE_SIZE(sh->raid_conf);
+
 	last_stripe = !head_sh->batch_head ||
 		list_first_entry(&sh->batch_list,
 				 struct stripe_head, batch_list) == head_sh;
@@ -2132,6 +2137,53 @@ ops_run_reconstruct5(struct stripe_head *sh, struct raid5_percpu *percpu,
 	}
 }
 
+/*
+ * Without DMA offload async_gen_syndrome() computes the syndrome inline
+ * anyway, so for a full stripe write batch skip setting up an async_tx
+ * submission per stripe: run the raid6 routine over the whole batch back to
+ * back, while the pointer arrays are hot, and complete the head once.
+ */
+static bool
+ops_run_reconstruct6_batch(struct stripe_head *head_sh,
+			   struct raid5_percpu *percpu,
+			   struct dma_async_tx_descriptor *tx)
+{
+	struct r5conf *conf = head_sh->raid_conf;
+	struct stripe_head *sh = head_sh;
+	struct page **blocks;
+	unsigned int *offs;
+	void **ptrs;
+	int count, i, j = 0;
+
+	if (IS_ENABLED(CONFIG_ASYNC_TX_DMA) || tx || !head_sh->batch_head ||
+	    head_sh->reconstruct_state == reconstruct_state_prexor_drain_run)
+		return false;
+
+	do {
+		blocks = to_addr_page(percpu, j);
+		offs = to_addr_offs(sh, percpu);
+		ptrs = (void **)to_addr_conv(sh, percpu, j);
+
+		count = set_syndrome_sources(blocks, offs, sh, SYNDROME_SRC_ALL);
+		for (i = 0; i < count + 2; i++)
+			ptrs[i] = blocks[i] ? page_address(blocks[i]) + offs[i] :
+					      (void *)raid6_empty_zero_page;
+		raid6_call.gen_syndrome(count + 2, RAID5_STRIPE_SIZE(conf), ptrs);
+
+		percpu->stats.parity_stripes++;
+		percpu->stats.parity_bytes += (u64)(sh->disks - 2) *
+					      RAID5_STRIPE_SIZE(conf);
+		j++;
+		sh = list_first_entry(&sh->batch_list, struct stripe_head,
+				      batch_list);
+	} while (sh != head_sh);
+	percpu->stats.parity_batches++;
+
+	atomic_inc(&head_sh->count);
+	ops_complete_reconstruct(head_sh);
+	return true;
+}
+
 static void
 ops_run_reconstruct6(struct stripe_head *sh, struct raid5_percpu *percpu,
 		     struct dma_async_tx_descriptor *tx)
@@ -2161,6 +2213,9 @@ ops_run_reconstruct6(struct stripe_head *sh, struct raid5_percpu *percpu,
 		return;
 	}
 
+	if (ops_run_reconstruct6_batch(sh, percpu, tx))
+		return;
+
 again:
 	blocks = to_addr_page(percpu, j);
 	offs = to_addr_offs(sh, percpu);
@@ -2174,6 +2229,10 @@ ops_run_reconstruct6(struct stripe_head *sh, struct raid5_percpu *percpu,
 	}
 
 	count = set_syndrome_sources(blocks, offs, sh, synflags);
+	percpu->stats.parity_stripes++;
+	percpu->stats.parity_bytes += (u64)(sh->disks - 2) *
+				      RAID5_STRIPE_SIZE(sh->raid_conf);
+
 	last_stripe = !head_sh->batch_head ||
 		list_first_entry(&sh->batch_list,
 				 struct stripe_head, batch_list) == head_sh;
@@ -3340,6 +3399,13 @@ schedule_reconstruction(struct stripe_head *sh, struct stripe_head_state *s,
 	struct r5conf *conf = sh->raid_conf;
 	int level = conf->level;
 
+	if (!expand) {
+		if (rcw)
+			this_cpu_inc(conf->percpu->stats.rcw);
+		else
+			this_cpu_inc(conf->percpu->stats.rmw);
+	}
+
 	if (rcw) {
 		/*
 		 * In some cases, handle_stripe_dirtying initially decided to
@@ -4957,6 +5023,7 @@ static void handle_stripe(struct stripe_head *sh)
 		set_bit(STRIPE_HANDLE, &sh->state);
 		return;
 	}
+	this_cpu_inc(conf->percpu->stats.stripes_handled);
 
 	if (test_and_clear_bit(STRIPE_BATCH_ERR, &sh->state))
 		break_stripe_batch_list(sh, 0);
@@ -7208,11 +7275,52 @@ raid5_group_thread_cnt = __ATTR(group_thread_cnt, S_IRUGO | S_IWUSR,
 				raid5_show_group_thread_cnt,
 				raid5_store_group_thread_cnt);
 
+static ssize_t
+raid5_show_stripe_stats(struct mddev *mddev, char *page)
+{
+	struct raid5_stats sum = {}, *st;
+	struct r5conf *conf;
+	int cpu, ret = 0;
+
+	spin_lock(&mddev->lock);
+	conf = mddev->private;
+	if (conf && conf->percpu) {
+		for_each_possible_cpu(cpu) {
+			st = &per_cpu_ptr(conf->percpu, cpu)->stats;
+			sum.stripes_handled += READ_ONCE(st->stripes_handled);
+			sum.stripes_batched += READ_ONCE(st->stripes_batched);
+			sum.rcw += READ_ONCE(st->rcw);
+			sum.rmw += READ_ONCE(st->rmw);
+			sum.parity_stripes += READ_ONCE(st->parity_stripes);
+			sum.parity_batches += READ_ONCE(st->parity_batches);
+			sum.parity_bytes += READ_ONCE(st->parity_bytes);
+		}
+		ret = sprintf(page,
+			      "stripes_handled %llu\n"
+			      "stripes_batched %llu\n"
+			      "rcw %llu\n"
+			      "rmw %llu\n"
+			      "parity_stripes %llu\n"
+			      "parity_batches %llu\n"
+			      "parity_bytes %llu\n",
+			      sum.stripes_handled, sum.stripes_batched,
+			      sum.rcw, sum.rmw, sum.parity_stripes,
+			      sum.parity_batches, sum.parity_bytes);
+	}
+	spin_unlock(&mddev->lock);
+	return ret;
+}
+
+static struct md_sysfs_entry
+raid5_stripe_stats = __ATTR(stripe_stats, S_IRUGO, raid5_show_stripe_stats,
+			    NULL);
+
 static struct attribute *raid5_attrs[] =  {
 	&raid5_stripecache_size.attr,
 	&raid5_stripecache_active.attr,
 	&raid5_preread_bypass_threshold.attr,
 	&raid5_group_thread_cnt.attr,
+	&raid5_stripe_stats.attr,
 	&raid5_skip_copy.attr,
 	&raid5_rmw_level.attr,
 	&raid5_stripe_size.attr,
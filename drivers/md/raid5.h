@@ -561,6 +561,17 @@ struct r5pending_data {
 	struct bio_list bios;
 };
 
+/* Per-CPU counters, summed up by the stripe_stats sysfs attribute */
+struct raid5_stats {
+	u64		stripes_handled;
+	u64		stripes_batched;	/* added to a full stripe write batch */
+	u64		rcw;			/* reconstruct writes scheduled */
+	u64		rmw;			/* read-modify-writes scheduled */
+	u64		parity_stripes;		/* stripes parity was computed for */
+	u64		parity_batches;		/* batches computed inline in one go */
+	u64		parity_bytes;		/* data bytes covered by that parity */
+};
+
 struct raid5_percpu {
 	struct page	*spare_page; /* Used when checking P/Q in raid6 */
 	void		*scribble;  /* space for constructing buffer
@@ -569,6 +580,7 @@ struct raid5_percpu {
 				     */
 	int             scribble_obj_size;
 	local_lock_t    lock;
+	struct raid5_stats stats;
 };
 
 struct r5conf {
@@ -7,6 +7,8 @@
 #include <linux/module.h>
 #include <linux/init.h>
 #include <linux/slab.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/err.h>
 #include <linux/key.h>
 #include <linux/nvme-tcp.h>
@@ -135,6 +137,24 @@ enum nvme_tcp_recv_state {
 	NVME_TCP_RECV_DDGST,
 };
 
+/*
+ * Maximum number of data segments handed to the socket in one call, and
+ * number of requests sent per io_work round before looking at the receive
+ * side again.
+ */
+#define NVME_TCP_SEND_BVECS	16
+#define NVME_TCP_SEND_BUDGET	16
+
+struct nvme_tcp_queue_stats {
+	u64			send_calls;
+	u64			send_pdus;
+	u64			send_spliced;
+	u64			send_copied;
+	u64			recv_calls;
+	u64			recv_pdus;
+	u64			recv_copied;
+};
+
 struct nvme_tcp_ctrl;
 struct nvme_tcp_queue {
 	struct socket		*sock;
@@ -174,6 +194,8 @@ struct nvme_tcp_queue {
 	int                     tls_err;
 	struct page_frag_cache	pf_cache;
 
+	struct nvme_tcp_queue_stats stats;
+
 	void (*state_change)(struct sock *);
 	void (*data_ready)(struct sock *);
 	void (*write_space)(struct sock *);
@@ -195,11 +217,14 @@ struct nvme_tcp_ctrl {
 	struct delayed_work	connect_work;
 	struct nvme_tcp_request async_req;
 	u32			io_queues[HCTX_MAX_TYPES];
+
+	struct dentry		*debugfs;
 };
 
 static LIST_HEAD(nvme_tcp_ctrl_list);
 static DEFINE_MUTEX(nvme_tcp_ctrl_mutex);
 static struct workqueue_struct *nvme_tcp_wq;
+static struct dentry *nvme_tcp_debugfs;
 static const struct blk_mq_ops nvme_tcp_mq_ops;
 static const struct blk_mq_ops nvme_tcp_admin_mq_ops;
 static int nvme_tcp_try_send(struct nvme_tcp_queue *queue);
@@ -292,22 +317,6 @@ static inline bool nvme_tcp_has_inline_data(struct nvme_tcp_request *req)
 		req->data_len <= nvme_tcp_inline_data_size(req);
 }
 
-static inline struct page *nvme_tcp_req_cur_page(struct nvme_tcp_request *req)
-{
-	return req->iter.bvec->bv_page;
-}
-
-static inline size_t nvme_tcp_req_cur_offset(struct nvme_tcp_request *req)
-{
-	return req->iter.bvec->bv_offset + req->iter.iov_offset;
-}
-
-static inline size_t nvme_tcp_req_cur_length(struct nvme_tcp_request *req)
-{
-	return min_t(size_t, iov_iter_single_seg_count(&req->iter),
-			req->pdu_len - req->pdu_sent);
-}
-
 static inline size_t nvme_tcp_pdu_data_left(struct nvme_tcp_request *req)
 {
 	return rq_data_dir(blk_mq_rq_from_pdu(req)) == WRITE ?
@@ -780,6 +789,7 @@ static int nvme_tcp_recv_pdu(struct nvme_tcp_queue *queue, struct sk_buff *skb,
 	if (queue->pdu_remaining)
 		return 0;
 
+	queue->stats.recv_pdus++;
 	hdr = queue->pdu;
 	if (queue->hdr_digest) {
 		ret = nvme_tcp_verify_hdgst(queue, queue->pdu, hdr->hlen);
@@ -870,6 +880,7 @@ static int nvme_tcp_recv_data(struct nvme_tcp_queue *queue, struct sk_buff *skb,
 		*len -= recv_len;
 		*offset += recv_len;
 		queue->data_remaining -= recv_len;
+		queue->stats.recv_copied += recv_len;
 	}
 
 	if (!queue->data_remaining) {
@@ -1030,6 +1041,57 @@ static inline void nvme_tcp_done_send_req(struct nvme_tcp_queue *queue)
 	queue->request = NULL;
 }
 
+/*
+ * Describe as much of the current PDU as fits in @bvec, starting at the
+ * request iterator, without advancing it.  The segments are either all
+ * spliceable or all not, so that one call never needs to fall back to
+ * copying pages it could have spliced.
+ */
+static unsigned int nvme_tcp_req_fill_bvecs(struct nvme_tcp_request *req,
+		struct bio_vec *bvec, unsigned int max, size_t *lenp,
+		bool *splice)
+{
+	const struct bio_vec *src = req->iter.bvec;
+	size_t skip = req->iter.iov_offset;
+	size_t left = min_t(size_t, iov_iter_count(&req->iter),
+			req->pdu_len - req->pdu_sent);
+	unsigned int nr = 0;
+	size_t len = 0;
+
+	*splice = true;
+	while (left && nr < max) {
+		size_t seg = min_t(size_t, src->bv_len - skip, left);
+		bool ok = sendpages_ok(src->bv_page, seg, src->bv_offset + skip);
+
+		if (!nr)
+			*splice = ok;
+		else if (ok != *splice)
+			break;
+
+		bvec_set_page(&bvec[nr++], src->bv_page, seg,
+				src->bv_offset + skip);
+		len += seg;
+		left -= seg;
+		skip = 0;
+		src++;
+	}
+
+	*lenp = len;
+	return nr;
+}
+
+static void nvme_tcp_ddgst_update_bvecs(struct ahash_request *hash,
+		const struct bio_vec *bvec, size_t len)
+{
+	size_t seg;
+
+	for (; len; bvec++, len -= seg) {
+		seg = min_t(size_t, bvec->bv_len, len);
+		nvme_tcp_ddgst_update(hash, bvec->bv_page, bvec->bv_offset,
+				seg);
+	}
+}
+
 static void nvme_tcp_fail_request(struct nvme_tcp_request *req)
 {
 	if (nvme_tcp_async_req(req)) {
@@ -1050,34 +1112,41 @@ static int nvme_tcp_try_send_data(struct nvme_tcp_request *req)
 	u32 h2cdata_left = req->h2cdata_left;
 
 	while (true) {
-		struct bio_vec bvec;
+		struct bio_vec bvec[NVME_TCP_SEND_BVECS];
 		struct msghdr msg = {
 			.msg_flags = MSG_DONTWAIT | MSG_SPLICE_PAGES,
 		};
-		struct page *page = nvme_tcp_req_cur_page(req);
-		size_t offset = nvme_tcp_req_cur_offset(req);
-		size_t len = nvme_tcp_req_cur_length(req);
-		bool last = nvme_tcp_pdu_last_send(req, len);
 		int req_data_sent = req->data_sent;
+		unsigned int nr_bvec;
+		bool last, splice;
+		size_t len;
 		int ret;
 
+		nr_bvec = nvme_tcp_req_fill_bvecs(req, bvec, ARRAY_SIZE(bvec),
+				&len, &splice);
+		last = nvme_tcp_pdu_last_send(req, len);
+
 		if (last && !queue->data_digest && !nvme_tcp_queue_more(queue))
 			msg.msg_flags |= MSG_EOR;
 		else
 			msg.msg_flags |= MSG_MORE;
 
-		if (!sendpages_ok(page, len, offset))
+		if (!splice)
 			msg.msg_flags &= ~MSG_SPLICE_PAGES;
 
-		bvec_set_page(&bvec, page, len, offset);
-		iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, &bvec, 1, len);
+		iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, bvec, nr_bvec, len);
 		ret = sock_sendmsg(queue->sock, &msg);
+		queue->stats.send_calls++;
 		if (ret <= 0)
 			return ret;
 
+		if (splice)
+			queue->stats.send_spliced += ret;
+		else
+			queue->stats.send_copied += ret;
+
 		if (queue->data_digest)
-			nvme_tcp_ddgst_update(queue->snd_hash, page,
-					offset, ret);
+			nvme_tcp_ddgst_update_bvecs(queue->snd_hash, bvec, ret);
 
 		/*
 		 * update the request iterator except for the last payload send
@@ -1095,6 +1164,7 @@ static int nvme_tcp_try_send_data(struct nvme_tcp_request *req)
 				req->state = NVME_TCP_SEND_DDGST;
 				req->offset = 0;
 			} else {
+				queue->stats.send_pdus++;
 				if (h2cdata_left)
 					nvme_tcp_setup_h2c_data_pdu(req);
 				else
@@ -1128,6 +1198,7 @@ static int nvme_tcp_try_send_cmd_pdu(struct nvme_tcp_request *req)
 	bvec_set_virt(&bvec, (void *)pdu + req->offset, len);
 	iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, &bvec, 1, len);
 	ret = sock_sendmsg(queue->sock, &msg);
+	queue->stats.send_calls++;
 	if (unlikely(ret <= 0))
 		return ret;
 
@@ -1138,6 +1209,7 @@ static int nvme_tcp_try_send_cmd_pdu(struct nvme_tcp_request *req)
 			if (queue->data_digest)
 				crypto_ahash_init(queue->snd_hash);
 		} else {
+			queue->stats.send_pdus++;
 			nvme_tcp_done_send_req(queue);
 		}
 		return 1;
@@ -1166,6 +1238,7 @@ static int nvme_tcp_try_send_data_pdu(struct nvme_tcp_request *req)
 	bvec_set_virt(&bvec, (void *)pdu + req->offset, len);
 	iov_iter_bvec(&msg.msg_iter, ITER_SOURCE, &bvec, 1, len);
 	ret = sock_sendmsg(queue->sock, &msg);
+	queue->stats.send_calls++;
 	if (unlikely(ret <= 0))
 		return ret;
 
@@ -1199,10 +1272,12 @@ static int nvme_tcp_try_send_ddgst(struct nvme_tcp_request *req)
 		msg.msg_flags |= MSG_EOR;
 
 	ret = kernel_sendmsg(queue->sock, &msg, &iov, 1, iov.iov_len);
+	queue->stats.send_calls++;
 	if (unlikely(ret <= 0))
 		return ret;
 
 	if (offset + ret == NVME_TCP_DIGEST_LENGTH) {
+		queue->stats.send_pdus++;
 		if (h2cdata_left)
 			nvme_tcp_setup_h2c_data_pdu(req);
 		else
@@ -1275,6 +1350,7 @@ static int nvme_tcp_try_recv(struct nvme_tcp_queue *queue)
 	rd_desc.count = 1;
 	lock_sock(sk);
 	queue->nr_cqe = 0;
+	queue->stats.recv_calls++;
 	consumed = sock->ops->read_sock(sk, &rd_desc, nvme_tcp_recv_skb);
 	release_sock(sk);
 	return consumed;
@@ -1291,12 +1367,20 @@ static void nvme_tcp_io_work(struct work_struct *w)
 		int result;
 
 		if (mutex_trylock(&queue->send_mutex)) {
-			result = nvme_tcp_try_send(queue);
+			int budget = NVME_TCP_SEND_BUDGET;
+
+			/*
+			 * Send several requests back to back, MSG_MORE lets
+			 * the socket coalesce them into full segments.
+			 */
+			do {
+				result = nvme_tcp_try_send(queue);
+			} while (result > 0 && --budget);
 			mutex_unlock(&queue->send_mutex);
-			if (result > 0)
-				pending = true;
-			else if (unlikely(result < 0))
+			if (unlikely(result < 0))
 				break;
+			if (budget < NVME_TCP_SEND_BUDGET)
+				pending = true;
 		}
 
 		result = nvme_tcp_try_recv(queue);
@@ -1671,6 +1755,7 @@ static int nvme_tcp_alloc_queue(struct nvme_ctrl *nctrl, int qid,
 
 	mutex_init(&queue->queue_lock);
 	queue->ctrl = ctrl;
+	memset(&queue->stats, 0, sizeof(queue->stats));
 	init_llist_head(&queue->req_list);
 	INIT_LIST_HEAD(&queue->send_list);
 	mutex_init(&queue->send_mutex);
@@ -2383,10 +2468,43 @@ static void nvme_tcp_stop_ctrl(struct nvme_ctrl *ctrl)
 	cancel_delayed_work_sync(&to_tcp_ctrl(ctrl)->connect_work);
 }
 
+static int nvme_tcp_queue_stats_show(struct seq_file *m, void *v)
+{
+	struct nvme_tcp_ctrl *ctrl = m->private;
+	struct nvme_tcp_queue_stats *st;
+	int i;
+
+	seq_puts(m, "queue send_calls send_pdus send_spliced send_copied recv_calls recv_pdus recv_copied\n");
+	for (i = 0; i < ctrl->ctrl.queue_count; i++) {
+		if (!test_bit(NVME_TCP_Q_ALLOCATED, &ctrl->queues[i].flags))
+			continue;
+
+		st = &ctrl->queues[i].stats;
+		seq_printf(m, "%d %llu %llu %llu %llu %llu %llu %llu\n", i,
+			   READ_ONCE(st->send_calls), READ_ONCE(st->send_pdus),
+			   READ_ONCE(st->send_spliced), READ_ONCE(st->send_copied),
+			   READ_ONCE(st->recv_calls), READ_ONCE(st->recv_pdus),
+			   READ_ONCE(st->recv_copied));
+	}
+
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(nvme_tcp_queue_stats);
+
+static void nvme_tcp_debugfs_add_ctrl(struct nvme_tcp_ctrl *ctrl)
+{
+	ctrl->debugfs = debugfs_create_dir(dev_name(ctrl->ctrl.device),
+					   nvme_tcp_debugfs);
+	debugfs_create_file("queue_stats", 0444, ctrl->debugfs, ctrl,
+			    &nvme_tcp_queue_stats_fops);
+}
+
 static void nvme_tcp_free_ctrl(struct nvme_ctrl *nctrl)
 {
 	struct nvme_tcp_ctrl *ctrl = to_tcp_ctrl(nctrl);
 
+	debugfs_remove_recursive(ctrl->debugfs);
+
 	if (list_empty(&ctrl->list))
 		goto free_ctrl;
 
@@ -2825,6 +2943,8 @@ static struct nvme_ctrl *nvme_tcp_create_ctrl(struct device *dev,
 	dev_info(ctrl->ctrl.device, "new ctrl: NQN \"%s\", addr %pISp, hostnqn: %s\n",
 		nvmf_ctrl_subsysnqn(&ctrl->ctrl), &ctrl->addr, opts->host->nqn);
 
+	nvme_tcp_debugfs_add_ctrl(ctrl);
+
 	mutex_lock(&nvme_tcp_ctrl_mutex);
 	list_add_tail(&ctrl->list, &nvme_tcp_ctrl_list);
 	mutex_unlock(&nvme_tcp_ctrl_mutex);
@@ -2873,6 +2993,8 @@ static int __init nvme_tcp_init_module(void)
 	if (!nvme_tcp_wq)
 		return -ENOMEM;
 
+	nvme_tcp_debugfs = debugfs_create_dir("nvme_tcp", NULL);
+
 	nvmf_register_transport(&nvme_tcp_transport);
 	return 0;
 }
@@ -2889,6 +3011,7 @@ static void __exit nvme_tcp_cleanup_module(void)
 	mutex_unlock(&nvme_tcp_ctrl_mutex);
 	flush_workqueue(nvme_delete_wq);
 
+	debugfs_remove_recursive(nvme_tcp_debugfs);
 	destroy_workqueue(nvme_tcp_wq);
 }
 
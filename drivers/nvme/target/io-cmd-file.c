@@ -13,6 +13,8 @@
 
 #define NVMET_MIN_MPOOL_OBJ		16
 
+static void nvmet_file_retry_work(struct work_struct *w);
+
 void nvmet_file_ns_revalidate(struct nvmet_ns *ns)
 {
 	ns->size = i_size_read(ns->file->f_mapping->host);
@@ -64,6 +66,9 @@ int nvmet_file_ns_enable(struct nvmet_ns *ns)
 		goto err;
 	}
 
+	init_llist_head(&ns->file_retry_list);
+	INIT_WORK(&ns->file_retry_work, nvmet_file_retry_work);
+
 	return ret;
 err:
 	fput(ns->file);
@@ -215,6 +220,111 @@ static void nvmet_file_submit_buffered_io(struct nvmet_req *req)
 	queue_work(buffered_io_wq, &req->f.work);
 }
 
+/*
+ * Buffered reads that miss the page cache do not need a thread to wait for
+ * the page cache to be filled.  Like io_uring, arm a wait_page_queue entry
+ * with IOCB_WAITQ: the read starts readahead and returns -EIOCBQUEUED, and
+ * the entry is woken once the folio is unlocked.  Woken reads are collected
+ * per namespace and retried in a batch by a single work item.  Anything the
+ * file system cannot do this way falls back to a blocking read on
+ * buffered_io_wq.
+ */
+static int nvmet_file_read_wake(struct wait_queue_entry *wait,
+		unsigned int mode, int sync, void *key)
+{
+	struct wait_page_queue *wpq =
+		container_of(wait, struct wait_page_queue, wait);
+	struct nvmet_req *req = wait->private;
+	struct nvmet_ns *ns = req->ns;
+
+	if (!wake_page_match(wpq, key))
+		return 0;
+
+	list_del_init(&wait->entry);
+	if (llist_add(&req->f.lentry, &ns->file_retry_list))
+		queue_work(buffered_io_wq, &ns->file_retry_work);
+	return 1;
+}
+
+static void nvmet_file_read_async(struct nvmet_req *req)
+{
+	struct kiocb *iocb = &req->f.iocb;
+	struct wait_page_queue *wpq = &req->f.wpq;
+	struct iov_iter iter;
+	ssize_t ret = 0;
+
+	iov_iter_bvec(&iter, ITER_DEST, req->f.bvec, req->sg_cnt,
+		      req->transfer_len);
+	iov_iter_advance(&iter, req->f.done);
+
+	while (iov_iter_count(&iter)) {
+		wpq->wait.func = nvmet_file_read_wake;
+		wpq->wait.private = req;
+		wpq->wait.flags = 0;
+		INIT_LIST_HEAD(&wpq->wait.entry);
+
+		memset(iocb, 0, sizeof(*iocb));
+		iocb->ki_pos = (le64_to_cpu(req->cmd->rw.slba) <<
+				req->ns->blksize_shift) + req->f.done;
+		iocb->ki_filp = req->ns->file;
+		iocb->ki_flags = IOCB_WAITQ | iocb->ki_filp->f_iocb_flags;
+		iocb->ki_waitq = wpq;
+
+		ret = req->ns->file->f_op->read_iter(iocb, &iter);
+		if (ret == -EIOCBQUEUED)
+			return;
+		if (ret == -EAGAIN) {
+			nvmet_file_submit_buffered_io(req);
+			return;
+		}
+		if (ret <= 0)
+			break;
+		req->f.done += ret;
+	}
+
+	nvmet_file_io_done(iocb, ret < 0 ? ret : req->f.done);
+}
+
+static void nvmet_file_retry_work(struct work_struct *w)
+{
+	struct nvmet_ns *ns = container_of(w, struct nvmet_ns, file_retry_work);
+	struct nvmet_req *req, *next;
+	struct llist_node *node;
+	struct blk_plug plug;
+
+	node = llist_reverse_order(llist_del_all(&ns->file_retry_list));
+
+	blk_start_plug(&plug);
+	llist_for_each_entry_safe(req, next, node, f.lentry)
+		nvmet_file_read_async(req);
+	blk_finish_plug(&plug);
+}
+
+static bool nvmet_file_can_read_async(struct nvmet_req *req)
+{
+	return req->cmd->rw.opcode == nvme_cmd_read &&
+		likely(!req->f.mpool_alloc) &&
+		(req->ns->file->f_op->fop_flags & FOP_BUFFER_RASYNC);
+}
+
+static void nvmet_file_submit_read_async(struct nvmet_req *req)
+{
+	loff_t pos = le64_to_cpu(req->cmd->rw.slba) << req->ns->blksize_shift;
+	struct scatterlist *sg;
+	int i;
+
+	if (unlikely(pos + req->transfer_len > req->ns->size)) {
+		nvmet_file_io_done(&req->f.iocb, -ENOSPC);
+		return;
+	}
+
+	for_each_sg(req->sg, sg, req->sg_cnt, i)
+		bvec_set_page(&req->f.bvec[i], sg_page(sg), sg->length,
+			      sg->offset);
+	req->f.done = 0;
+	nvmet_file_read_async(req);
+}
+
 static void nvmet_file_execute_rw(struct nvmet_req *req)
 {
 	ssize_t nr_bvec = req->sg_cnt;
@@ -245,7 +355,10 @@ static void nvmet_file_execute_rw(struct nvmet_req *req)
 		    (req->ns->file->f_mode & FMODE_NOWAIT) &&
 		    nvmet_file_execute_io(req, IOCB_NOWAIT))
 			return;
-		nvmet_file_submit_buffered_io(req);
+		if (nvmet_file_can_read_async(req))
+			nvmet_file_submit_read_async(req);
+		else
+			nvmet_file_submit_buffered_io(req);
 	} else
 		nvmet_file_execute_io(req, 0);
 }
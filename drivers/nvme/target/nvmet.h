@@ -12,12 +12,14 @@
 #include <linux/kref.h>
 #include <linux/percpu-refcount.h>
 #include <linux/list.h>
+#include <linux/llist.h>
 #include <linux/mutex.h>
 #include <linux/uuid.h>
 #include <linux/nvme.h>
 #include <linux/configfs.h>
 #include <linux/rcupdate.h>
 #include <linux/blkdev.h>
+#include <linux/pagemap.h>
 #include <linux/radix-tree.h>
 #include <linux/t10-pi.h>
 
@@ -80,6 +82,10 @@ struct nvmet_ns {
 	struct completion	disable_done;
 	mempool_t		*bvec_pool;
 
+	/* buffered reads ready to be retried, see io-cmd-file.c */
+	struct llist_head	file_retry_list;
+	struct work_struct	file_retry_work;
+
 	struct pci_dev		*p2p_dev;
 	int			use_p2pmem;
 	int			pi_type;
@@ -383,6 +389,9 @@ struct nvmet_req {
 			struct kiocb            iocb;
 			struct bio_vec          *bvec;
 			struct work_struct      work;
+			struct wait_page_queue	wpq;
+			struct llist_node	lentry;
+			size_t			done;
 		} f;
 		struct {
 			struct bio		inline_bio;
@@ -2,15 +2,33 @@
 #include <linux/pm_qos.h>
 #include <linux/notifier.h>
 #include <linux/err.h>
-#include <linux/spinlock_types.h>
+#include <linux/spinlock.h>
+#include <linux/hash.h>
+#include <kunit/visibility.h>
 #include "atomic_qos.h"
 
-/*
- * locking rule: all changes to constraints or notifiers lists
- * or pm_qos_object list and pm_qos_objects need to happen with pm_qos_lock
- * held, taken with _irqsave.  One lock to rule them all
- */
-static DEFINE_SPINLOCK(atomic_pm_qos_lock);
+static void atomic_pm_qos_constraints_init(struct atomic_pm_qos_constraints *c,
+					   s32 value, enum pm_qos_type type,
+					   struct atomic_notifier_head *notifiers)
+{
+	struct atomic_pm_qos_shard *shard;
+	int i;
+
+	for (i = 0; i < ATOMIC_QOS_SHARDS; i++) {
+		shard = &c->shards[i];
+		spin_lock_init(&shard->lock);
+		plist_head_init(&shard->list);
+		shard->value = value;
+	}
+	c->target_value = value;
+	c->default_value = value;
+	c->no_constraint_value = value;
+	c->type = type;
+
+	spin_lock_init(&c->notify_lock);
+	c->notifiers = notifiers;
+	ATOMIC_INIT_NOTIFIER_HEAD(notifiers);
+}
 
 /**
  * atomic_freq_constraints_init - Initialize frequency QoS constraints.
@@ -18,26 +36,12 @@ static DEFINE_SPINLOCK(atomic_pm_qos_lock);
  */
 void atomic_freq_constraints_init(struct atomic_freq_constraints *qos)
 {
-	struct atomic_pm_qos_constraints *c;
-
-	c = &qos->min_freq;
-	plist_head_init(&c->list);
-	c->target_value = FREQ_QOS_MIN_DEFAULT_VALUE;
-	c->default_value = FREQ_QOS_MIN_DEFAULT_VALUE;
-	c->no_constraint_value = FREQ_QOS_MIN_DEFAULT_VALUE;
-	c->type = PM_QOS_MAX;
-	c->notifiers = &qos->min_freq_notifiers;
-	ATOMIC_INIT_NOTIFIER_HEAD(c->notifiers);
-
-	c = &qos->max_freq;
-	plist_head_init(&c->list);
-	c->target_value = FREQ_QOS_MAX_DEFAULT_VALUE;
-	c->default_value = FREQ_QOS_MAX_DEFAULT_VALUE;
-	c->no_constraint_value = FREQ_QOS_MAX_DEFAULT_VALUE;
-	c->type = PM_QOS_MIN;
-	c->notifiers = &qos->max_freq_notifiers;
-	ATOMIC_INIT_NOTIFIER_HEAD(c->notifiers);
+	atomic_pm_qos_constraints_init(&qos->min_freq, FREQ_QOS_MIN_DEFAULT_VALUE,
+				       PM_QOS_MAX, &qos->min_freq_notifiers);
+	atomic_pm_qos_constraints_init(&qos->max_freq, FREQ_QOS_MAX_DEFAULT_VALUE,
+				       PM_QOS_MIN, &qos->max_freq_notifiers);
 }
+EXPORT_SYMBOL_IF_KUNIT(atomic_freq_constraints_init);
 
 
 /**
@@ -70,6 +74,7 @@ int atomic_freq_qos_add_notifier(struct atomic_freq_constraints *qos,
 
 	return ret;
 }
+EXPORT_SYMBOL_IF_KUNIT(atomic_freq_qos_add_notifier);
 
 /**
  * atomic_freq_qos_remove_notifier - Remove frequency QoS change notifier.
@@ -101,18 +106,20 @@ int atomic_freq_qos_remove_notifier(struct atomic_freq_constraints *qos,
 
 	return ret;
 }
+EXPORT_SYMBOL_IF_KUNIT(atomic_freq_qos_remove_notifier);
 
-static int pm_qos_get_value(struct atomic_pm_qos_constraints *c)
+static int pm_qos_get_value(struct atomic_pm_qos_constraints *c,
+			    struct atomic_pm_qos_shard *shard)
 {
-	if (plist_head_empty(&c->list))
+	if (plist_head_empty(&shard->list))
 		return c->no_constraint_value;
 
 	switch (c->type) {
 	case PM_QOS_MIN:
-		return plist_first(&c->list)->prio;
+		return plist_first(&shard->list)->prio;
 
 	case PM_QOS_MAX:
-		return plist_last(&c->list)->prio;
+		return plist_last(&shard->list)->prio;
 
 	default:
 		WARN(1, "Unknown PM QoS type in %s\n", __func__);
@@ -120,9 +127,43 @@ static int pm_qos_get_value(struct atomic_pm_qos_constraints *c)
 	}
 }
 
-static void pm_qos_set_value(struct atomic_pm_qos_constraints *c, s32 value)
+static s32 pm_qos_aggregate(struct atomic_pm_qos_constraints *c)
 {
-	WRITE_ONCE(c->target_value, value);
+	s32 value = c->no_constraint_value, v;
+	int i;
+
+	for (i = 0; i < ATOMIC_QOS_SHARDS; i++) {
+		v = READ_ONCE(c->shards[i].value);
+		if (c->type == PM_QOS_MIN ? v < value : v > value)
+			value = v;
+	}
+
+	return value;
+}
+
+/*
+ * Fold the shard values into the target value and tell the notifiers if it
+ * changed.  Every updater whose shard value changed gets here after
+ * publishing it, so whoever takes notify_lock last sees all of them, and the
+ * last notification is never a stale one.
+ */
+static int atomic_pm_qos_notify(struct atomic_pm_qos_constraints *c)
+{
+	unsigned long flags;
+	s32 value;
+	int ret = 0;
+
+	spin_lock_irqsave(&c->notify_lock, flags);
+	value = pm_qos_aggregate(c);
+	if (value != c->target_value) {
+		WRITE_ONCE(c->target_value, value);
+		if (c->notifiers)
+			atomic_notifier_call_chain(c->notifiers, value, NULL);
+		ret = 1;
+	}
+	spin_unlock_irqrestore(&c->notify_lock, flags);
+
+	return ret;
 }
 
 /**
@@ -140,17 +181,22 @@ static void pm_qos_set_value(struct atomic_pm_qos_constraints *c, s32 value)
  * @value in it and add it to the list again), and PM_QOS_REMOVE_REQ (remove
  * @node from the list, ignore @value).
  *
+ * Only the lock of the shard @node belongs to is taken, and notify_lock if
+ * that shard's aggregate changes.
+ *
  * Return: 1 if the aggregate constraint value has changed, 0  otherwise.
  */
 static int atomic_pm_qos_update_target(struct atomic_pm_qos_constraints *c, struct plist_node *node,
 			 enum pm_qos_req_action action, int value)
 {
+	struct atomic_pm_qos_shard *shard;
 	int prev_value, curr_value, new_value;
 	unsigned long flags;
 
-	spin_lock_irqsave(&atomic_pm_qos_lock, flags);
+	shard = &c->shards[hash_ptr(node, ATOMIC_QOS_SHARD_BITS)];
+	spin_lock_irqsave(&shard->lock, flags);
 
-	prev_value = pm_qos_get_value(c);
+	prev_value = shard->value;
 	if (value == PM_QOS_DEFAULT_VALUE)
 		new_value = c->default_value;
 	else
@@ -158,36 +204,33 @@ static int atomic_pm_qos_update_target(struct atomic_pm_qos_constraints *c, stru
 
 	switch (action) {
 	case PM_QOS_REMOVE_REQ:
-		plist_del(node, &c->list);
+		plist_del(node, &shard->list);
 		break;
 	case PM_QOS_UPDATE_REQ:
 		/*
 		 * To change the list, atomically remove, reinit with new value
 		 * and add, then see if the aggregate has changed.
 		 */
-		plist_del(node, &c->list);
+		plist_del(node, &shard->list);
 		fallthrough;
 	case PM_QOS_ADD_REQ:
 		plist_node_init(node, new_value);
-		plist_add(node, &c->list);
+		plist_add(node, &shard->list);
 		break;
 	default:
 		/* no action */
 		break;
 	}
 
-	curr_value = pm_qos_get_value(c);
-	pm_qos_set_value(c, curr_value);
+	curr_value = pm_qos_get_value(c, shard);
+	WRITE_ONCE(shard->value, curr_value);
 
-	spin_unlock_irqrestore(&atomic_pm_qos_lock, flags);
+	spin_unlock_irqrestore(&shard->lock, flags);
 
 	if (prev_value == curr_value)
 		return 0;
 
-	if (c->notifiers)
-		atomic_notifier_call_chain(c->notifiers, curr_value, NULL);
-
-	return 1;
+	return atomic_pm_qos_notify(c);
 }
 
 /**
@@ -252,6 +295,7 @@ int atomic_freq_qos_add_request(struct atomic_freq_constraints *qos,
 
 	return ret;
 }
+EXPORT_SYMBOL_IF_KUNIT(atomic_freq_qos_add_request);
 
 /**
  * atomic_freq_qos_update_request - Modify existing frequency QoS request.
@@ -274,3 +318,4 @@ int atomic_freq_qos_update_request(struct atomic_freq_qos_request *req, s32 new_
 
 	return atomic_freq_qos_apply(req, PM_QOS_UPDATE_REQ, new_value);
 }
+EXPORT_SYMBOL_IF_KUNIT(atomic_freq_qos_update_request);
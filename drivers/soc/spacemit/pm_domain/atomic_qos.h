@@ -6,18 +6,40 @@
 #include <linux/notifier.h>
 #include <linux/err.h>
 #include <linux/spinlock_types.h>
+#include <linux/compiler.h>
+#include <linux/cache.h>
+#include <linux/bug.h>
+
+#define ATOMIC_QOS_SHARD_BITS	3
+#define ATOMIC_QOS_SHARDS	(1 << ATOMIC_QOS_SHARD_BITS)
+
+/*
+ * The requests of a constraint are spread over shards by request address,
+ * each with its own list and lock, and the aggregate of the shard's list.
+ */
+struct atomic_pm_qos_shard {
+	spinlock_t lock;
+	struct plist_head list;
+	s32 value;
+} ____cacheline_aligned_in_smp;
 
 /*
  * Note: The lockless read path depends on the CPU accessing target_value
  * or effective_flags atomically.  Atomic access is only guaranteed on all CPU
  * types linux supports for 32 bit quantites
+ *
+ * locking rule: a shard's list and value are protected by the shard lock.
+ * target_value, the aggregate over all shards, and the notifier calls are
+ * protected by notify_lock, which is only taken when a shard value changes.
  */
 struct atomic_pm_qos_constraints {
-	struct plist_head list;
+	struct atomic_pm_qos_shard shards[ATOMIC_QOS_SHARDS];
 	s32 target_value;	/* Do not change to 64 bit */
 	s32 default_value;
 	s32 no_constraint_value;
 	enum pm_qos_type type;
+
+	spinlock_t notify_lock;
 	struct atomic_notifier_head *notifiers;
 };
 
@@ -34,6 +56,27 @@ struct atomic_freq_qos_request {
 	struct atomic_freq_constraints *qos;
 };
 
+/**
+ * atomic_freq_qos_read_value - Get frequency QoS constraint for a given list.
+ * @qos: Constraints to evaluate.
+ * @type: QoS request type.
+ *
+ * Lockless, may be called from any context.
+ */
+static inline s32 atomic_freq_qos_read_value(struct atomic_freq_constraints *qos,
+					     enum freq_qos_req_type type)
+{
+	switch (type) {
+	case FREQ_QOS_MIN:
+		return READ_ONCE(qos->min_freq.target_value);
+	case FREQ_QOS_MAX:
+		return READ_ONCE(qos->max_freq.target_value);
+	default:
+		WARN_ON(1);
+		return PM_QOS_DEFAULT_VALUE;
+	}
+}
+
 /**
  * atomic_freq_constraints_init - Initialize frequency QoS constraints.
  * @qos: Frequency QoS constraints to initialize.
@@ -0,0 +1,250 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * KUnit tests for the atomic frequency QoS constraints
+ */
+
+#include <kunit/test.h>
+#include <linux/bitmap.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/hash.h>
+#include <linux/kthread.h>
+#include <linux/slab.h>
+#include "atomic_qos.h"
+
+#define QOS_TEST_THREADS	8
+#define QOS_TEST_UPDATES	20000
+#define QOS_TEST_REQUESTS	64
+
+struct qos_test_notifier {
+	struct notifier_block nb;
+	atomic_t calls;
+	s32 last;
+};
+
+static int qos_test_notifier_call(struct notifier_block *nb,
+				  unsigned long value, void *data)
+{
+	struct qos_test_notifier *n = container_of(nb, struct qos_test_notifier, nb);
+
+	atomic_inc(&n->calls);
+	WRITE_ONCE(n->last, value);
+	return NOTIFY_OK;
+}
+
+static void qos_test_notifier_init(struct qos_test_notifier *n)
+{
+	n->nb.notifier_call = qos_test_notifier_call;
+	atomic_set(&n->calls, 0);
+	n->last = -1;
+}
+
+static void atomic_qos_test_defaults(struct kunit *test)
+{
+	struct atomic_freq_constraints qos;
+
+	atomic_freq_constraints_init(&qos);
+
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(&qos, FREQ_QOS_MIN),
+			FREQ_QOS_MIN_DEFAULT_VALUE);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(&qos, FREQ_QOS_MAX),
+			FREQ_QOS_MAX_DEFAULT_VALUE);
+}
+
+static void atomic_qos_test_aggregate(struct kunit *test)
+{
+	struct atomic_freq_qos_request min1, min2, max1, max2;
+	struct atomic_freq_constraints qos;
+	struct qos_test_notifier n;
+
+	atomic_freq_constraints_init(&qos);
+	qos_test_notifier_init(&n);
+	KUNIT_ASSERT_EQ(test, atomic_freq_qos_add_notifier(&qos, FREQ_QOS_MAX, &n.nb), 0);
+
+	/* The min constraint is the largest request, the max the smallest */
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_add_request(&qos, &min1, FREQ_QOS_MIN, 100), 1);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_add_request(&qos, &min2, FREQ_QOS_MIN, 50), 0);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(&qos, FREQ_QOS_MIN), 100);
+
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_add_request(&qos, &max1, FREQ_QOS_MAX, 800), 1);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_add_request(&qos, &max2, FREQ_QOS_MAX, 900), 0);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(&qos, FREQ_QOS_MAX), 800);
+	KUNIT_EXPECT_EQ(test, atomic_read(&n.calls), 1);
+	KUNIT_EXPECT_EQ(test, n.last, 800);
+
+	/* Same value, nothing to do */
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_update_request(&max1, 800), 0);
+
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_update_request(&max1, 1000), 1);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(&qos, FREQ_QOS_MAX), 900);
+	KUNIT_EXPECT_EQ(test, n.last, 900);
+
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_update_request(&min1, 10), 1);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(&qos, FREQ_QOS_MIN), 50);
+
+	/* The min list must not notify the max notifier */
+	KUNIT_EXPECT_EQ(test, atomic_read(&n.calls), 2);
+
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_update_request(&max2, -1), -EINVAL);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_remove_notifier(&qos, FREQ_QOS_MAX, &n.nb), 0);
+}
+
+/* Requests spread over the shards still aggregate to one target value */
+static void atomic_qos_test_shards(struct kunit *test)
+{
+	struct atomic_freq_qos_request *reqs;
+	struct atomic_freq_constraints *qos;
+	struct qos_test_notifier n;
+	DECLARE_BITMAP(used, ATOMIC_QOS_SHARDS) = {};
+	int i;
+
+	qos = kunit_kzalloc(test, sizeof(*qos), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, qos);
+	reqs = kunit_kcalloc(test, QOS_TEST_REQUESTS, sizeof(*reqs), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, reqs);
+
+	atomic_freq_constraints_init(qos);
+	qos_test_notifier_init(&n);
+	KUNIT_ASSERT_EQ(test, atomic_freq_qos_add_notifier(qos, FREQ_QOS_MAX, &n.nb), 0);
+
+	for (i = 0; i < QOS_TEST_REQUESTS; i++) {
+		__set_bit(hash_ptr(&reqs[i].pnode, ATOMIC_QOS_SHARD_BITS), used);
+		KUNIT_ASSERT_GE(test, atomic_freq_qos_add_request(qos, &reqs[i],
+					FREQ_QOS_MAX, 2000 - i), 0);
+	}
+	/* Otherwise this would not test anything the single list did not */
+	KUNIT_EXPECT_GT(test, bitmap_weight(used, ATOMIC_QOS_SHARDS), 1);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(qos, FREQ_QOS_MAX),
+			2000 - QOS_TEST_REQUESTS + 1);
+
+	/*
+	 * Raise the lowest request in turn, so the minimum moves from shard
+	 * to shard, and every step raises the target value.
+	 */
+	for (i = QOS_TEST_REQUESTS - 1; i > 0; i--) {
+		KUNIT_EXPECT_EQ(test, atomic_freq_qos_update_request(&reqs[i], 3000), 1);
+		KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(qos, FREQ_QOS_MAX),
+				2000 - i + 1);
+		KUNIT_EXPECT_EQ(test, n.last, 2000 - i + 1);
+	}
+	/* Every add lowered the target and every update raised it */
+	KUNIT_EXPECT_EQ(test, atomic_read(&n.calls), 2 * QOS_TEST_REQUESTS - 1);
+
+	/* Lowering a request that stays above the minimum changes nothing */
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_update_request(&reqs[1], 2500), 0);
+	KUNIT_EXPECT_EQ(test, atomic_read(&n.calls), 2 * QOS_TEST_REQUESTS - 1);
+
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_remove_notifier(qos, FREQ_QOS_MAX, &n.nb), 0);
+}
+
+struct qos_test_thread {
+	struct atomic_freq_qos_request req;
+	struct completion done;
+	u32 seed;
+	s32 final;
+};
+
+static void qos_test_hammer(struct qos_test_thread *t)
+{
+	unsigned long flags;
+	u32 state = t->seed;
+	unsigned int i;
+
+	for (i = 0; i < QOS_TEST_UPDATES; i++) {
+		/* xorshift32 */
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		/* The driver updates from atomic context, so do the same */
+		local_irq_save(flags);
+		atomic_freq_qos_update_request(&t->req, state % 1000 + 1);
+		local_irq_restore(flags);
+
+		if (!(i & 255))
+			cond_resched();
+	}
+	atomic_freq_qos_update_request(&t->req, t->final);
+}
+
+static int qos_test_thread_fn(void *data)
+{
+	struct qos_test_thread *t = data;
+
+	qos_test_hammer(t);
+	kthread_complete_and_exit(&t->done, 0);
+}
+
+static void atomic_qos_test_concurrent(struct kunit *test)
+{
+	struct atomic_freq_qos_request cpu_min;
+	struct atomic_freq_constraints *qos;
+	struct qos_test_thread *threads;
+	struct task_struct *tsk;
+	struct qos_test_notifier n;
+	unsigned int i, nr;
+	s32 expected = S32_MAX;
+
+	qos = kunit_kzalloc(test, sizeof(*qos), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, qos);
+	threads = kunit_kcalloc(test, QOS_TEST_THREADS, sizeof(*threads), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_NULL(test, threads);
+
+	atomic_freq_constraints_init(qos);
+	qos_test_notifier_init(&n);
+	KUNIT_ASSERT_EQ(test, atomic_freq_qos_add_notifier(qos, FREQ_QOS_MAX, &n.nb), 0);
+
+	/* Traffic on the other constraint of the same object meanwhile */
+	KUNIT_ASSERT_GE(test, atomic_freq_qos_add_request(qos, &cpu_min, FREQ_QOS_MIN, 1), 0);
+
+	nr = clamp_t(unsigned int, num_online_cpus(), 2, QOS_TEST_THREADS);
+	for (i = 0; i < nr; i++) {
+		threads[i].seed = i * 2654435761U + 1;
+		threads[i].final = 500 + i * 7;
+		expected = min(expected, threads[i].final);
+		init_completion(&threads[i].done);
+		KUNIT_ASSERT_GE(test, atomic_freq_qos_add_request(qos, &threads[i].req,
+								  FREQ_QOS_MAX, 1000), 0);
+	}
+
+	for (i = 0; i < nr; i++) {
+		tsk = kthread_run(qos_test_thread_fn, &threads[i], "atomic_qos_test/%u", i);
+		if (IS_ERR(tsk)) {
+			/* Run it here instead so that every request settles */
+			qos_test_hammer(&threads[i]);
+			complete(&threads[i].done);
+		}
+	}
+
+	for (i = 0; i < QOS_TEST_UPDATES; i++)
+		atomic_freq_qos_update_request(&cpu_min, i % 100 + 1);
+
+	for (i = 0; i < nr; i++)
+		wait_for_completion(&threads[i].done);
+
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(qos, FREQ_QOS_MAX), expected);
+	/* However the updates raced, the last notification carries the result */
+	KUNIT_EXPECT_EQ(test, READ_ONCE(n.last), expected);
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_read_value(qos, FREQ_QOS_MIN),
+			(QOS_TEST_UPDATES - 1) % 100 + 1);
+
+	KUNIT_EXPECT_EQ(test, atomic_freq_qos_remove_notifier(qos, FREQ_QOS_MAX, &n.nb), 0);
+}
+
+static struct kunit_case atomic_qos_test_cases[] = {
+	KUNIT_CASE(atomic_qos_test_defaults),
+	KUNIT_CASE(atomic_qos_test_aggregate),
+	KUNIT_CASE(atomic_qos_test_shards),
+	KUNIT_CASE_SLOW(atomic_qos_test_concurrent),
+	{}
+};
+
+static struct kunit_suite atomic_qos_test_suite = {
+	.name = "spacemit-atomic-qos",
+	.test_cases = atomic_qos_test_cases,
+};
+kunit_test_suite(atomic_qos_test_suite);
+
+MODULE_IMPORT_NS(EXPORTED_FOR_KUNIT_TESTING);
+MODULE_DESCRIPTION("KUnit tests for the SpacemiT atomic frequency QoS");
+MODULE_LICENSE("GPL");
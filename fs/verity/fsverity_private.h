@@ -18,6 +18,12 @@
  */
 #define FS_VERITY_MAX_LEVELS		8
 
+/*
+ * Maximum number of data blocks that are hashed together with
+ * crypto_shash_finup_mb() before they are verified.
+ */
+#define FS_VERITY_MAX_PENDING_DATA_BLOCKS	2
+
 /* A hash algorithm supported by fs-verity */
 struct fsverity_hash_alg {
 	struct crypto_shash *tfm; /* hash tfm, allocated on demand */
@@ -84,6 +90,9 @@ const u8 *fsverity_prepare_hash_state(const struct fsverity_hash_alg *alg,
 				      const u8 *salt, size_t salt_size);
 int fsverity_hash_block(const struct merkle_tree_params *params,
 			const struct inode *inode, const void *data, u8 *out);
+int fsverity_hash_blocks(const struct merkle_tree_params *params,
+			 const struct inode *inode, const void * const data[],
+			 u8 * const outs[], unsigned int num_blocks);
 int fsverity_hash_buffer(const struct fsverity_hash_alg *alg,
 			 const void *data, size_t size, u8 *out);
 void __init fsverity_check_hash_algs(void);
@@ -79,7 +79,9 @@ static bool is_hash_block_verified(struct fsverity_info *vi, struct page *hpage,
 }
 
 /*
- * Verify a single data block against the file's Merkle tree.
+ * Verify a single data block against the file's Merkle tree.  @data_hash is
+ * the hash of the data block, which the caller computed already so that it
+ * can hash several data blocks at once.
  *
  * In principle, we need to verify the entire path to the root node.  However,
  * for efficiency the filesystem may cache the hash blocks.  Therefore we need
@@ -90,7 +92,8 @@ static bool is_hash_block_verified(struct fsverity_info *vi, struct page *hpage,
  */
 static bool
 verify_data_block(struct inode *inode, struct fsverity_info *vi,
-		  const void *data, u64 data_pos, unsigned long max_ra_pages)
+		  const void *data, const u8 *data_hash, u64 data_pos,
+		  unsigned long max_ra_pages)
 {
 	const struct merkle_tree_params *params = &vi->tree_params;
 	const unsigned int hsize = params->digest_size;
@@ -115,8 +118,13 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 	 */
 	u64 hidx = data_pos >> params->log_blocksize;
 
-	/* Up to 1 + FS_VERITY_MAX_LEVELS pages may be mapped at once */
-	BUILD_BUG_ON(1 + FS_VERITY_MAX_LEVELS > KM_MAX_IDX);
+	/*
+	 * Up to FS_VERITY_MAX_PENDING_DATA_BLOCKS + FS_VERITY_MAX_LEVELS pages
+	 * may be mapped at once, as the caller keeps all pending data blocks
+	 * mapped.
+	 */
+	BUILD_BUG_ON(FS_VERITY_MAX_PENDING_DATA_BLOCKS + FS_VERITY_MAX_LEVELS >
+		     KM_MAX_IDX);
 
 	if (unlikely(data_pos >= inode->i_size)) {
 		/*
@@ -221,11 +229,11 @@ verify_data_block(struct inode *inode, struct fsverity_info *vi,
 		put_page(hpage);
 	}
 
-	/* Finally, verify the data block. */
-	if (fsverity_hash_block(params, inode, data, real_hash) != 0)
-		goto error;
-	if (memcmp(want_hash, real_hash, hsize) != 0)
+	/* Finally, verify the data block, which was hashed by the caller. */
+	if (memcmp(want_hash, data_hash, hsize) != 0) {
+		memcpy(real_hash, data_hash, hsize);
 		goto corrupted;
+	}
 	return true;
 
 corrupted:
@@ -248,7 +256,11 @@ verify_data_blocks(struct folio *data_folio, size_t len, size_t offset,
 {
 	struct inode *inode = data_folio->mapping->host;
 	struct fsverity_info *vi = inode->i_verity_info;
-	const unsigned int block_size = vi->tree_params.block_size;
+	const struct merkle_tree_params *params = &vi->tree_params;
+	const unsigned int block_size = params->block_size;
+	const unsigned int max_pending =
+		min_t(unsigned int, FS_VERITY_MAX_PENDING_DATA_BLOCKS,
+		      crypto_shash_mb_max_msgs(params->hash_alg->tfm));
 	u64 pos = (u64)data_folio->index << PAGE_SHIFT;
 
 	if (WARN_ON_ONCE(len <= 0 || !IS_ALIGNED(len | offset, block_size)))
@@ -257,17 +269,32 @@ verify_data_blocks(struct folio *data_folio, size_t len, size_t offset,
 			 folio_test_uptodate(data_folio)))
 		return false;
 	do {
-		void *data;
+		u8 hashes[FS_VERITY_MAX_PENDING_DATA_BLOCKS]
+			 [FS_VERITY_MAX_DIGEST_SIZE];
+		const void *data[FS_VERITY_MAX_PENDING_DATA_BLOCKS];
+		u8 *outs[FS_VERITY_MAX_PENDING_DATA_BLOCKS];
+		unsigned int i, n;
 		bool valid;
 
-		data = kmap_local_folio(data_folio, offset);
-		valid = verify_data_block(inode, vi, data, pos + offset,
-					  max_ra_pages);
-		kunmap_local(data);
+		n = min_t(size_t, max_pending, len >> params->log_blocksize);
+		for (i = 0; i < n; i++) {
+			data[i] = kmap_local_folio(data_folio,
+						   offset + i * block_size);
+			outs[i] = hashes[i];
+		}
+
+		valid = fsverity_hash_blocks(params, inode, data, outs, n) == 0;
+		for (i = 0; i < n && valid; i++)
+			valid = verify_data_block(inode, vi, data[i], hashes[i],
+						  pos + offset + i * block_size,
+						  max_ra_pages);
+
+		while (n--)
+			kunmap_local(data[n]);
 		if (!valid)
 			return false;
-		offset += block_size;
-		len -= block_size;
+		offset += i * block_size;
+		len -= i * block_size;
 	} while (len);
 	return true;
 }
@@ -14,16 +14,25 @@
 #include <crypto/skcipher.h>
 #include <linux/types.h>
 
+/* Maximum number of requests handed to a driver at once in batch mode */
+#define CRYPTO_ENGINE_MAX_BATCH	32
+
 struct crypto_engine;
 struct device;
 
 /*
  * struct crypto_engine_op - crypto hardware engine operations
  * @do_one_request: do encryption for current request
+ * @do_many_requests: optional, do encryption for several queued requests of
+ * this algorithm at once when the engine runs in batch mode. Returns how many
+ * of them, counting from the first, the hardware accepted. The others are put
+ * back at the head of the engine queue. A negative error fails all of them.
  */
 struct crypto_engine_op {
 	int (*do_one_request)(struct crypto_engine *engine,
 			      void *areq);
+	int (*do_many_requests)(struct crypto_engine *engine,
+				void *areqs[], unsigned int nreqs);
 };
 
 struct aead_engine_alg {
@@ -71,6 +80,8 @@ void crypto_finalize_kpp_request(struct crypto_engine *engine,
 				 struct kpp_request *req, int err);
 void crypto_finalize_skcipher_request(struct crypto_engine *engine,
 				      struct skcipher_request *req, int err);
+void crypto_finalize_requests(struct crypto_engine *engine, void *areqs[],
+			      const int errs[], unsigned int nreqs);
 int crypto_engine_start(struct crypto_engine *engine);
 int crypto_engine_stop(struct crypto_engine *engine);
 struct crypto_engine *crypto_engine_alloc_init(struct device *dev, bool rt);
@@ -78,6 +89,8 @@ struct crypto_engine *crypto_engine_alloc_init_and_set(struct device *dev,
 						       bool retry_support,
 						       int (*cbk_do_batch)(struct crypto_engine *engine),
 						       bool rt, int qlen);
+int crypto_engine_set_batch(struct crypto_engine *engine,
+			    unsigned int max_reqs);
 void crypto_engine_exit(struct crypto_engine *engine);
 
 int crypto_engine_register_aead(struct aead_engine_alg *alg);
@@ -158,6 +158,9 @@ struct shash_desc {
 
 #define HASH_MAX_DIGESTSIZE	 64
 
+/* Maximum value of shash_alg.mb_max_msgs */
+#define HASH_MAX_MB_MSGS	8
+
 /*
  * Worst case is hmac(sha3-224-generic).  Its context is a nested 'shash_desc'
  * containing a 'struct sha3_state'.
@@ -191,6 +194,15 @@ struct shash_desc {
  *	      This is a counterpart to @init_tfm, used to remove
  *	      various changes set in @init_tfm.
  * @clone_tfm: Copy transform into new object, may allocate memory.
+ * @finup_mb: **[optional]** Finish hashing several equal-length messages that
+ *	      all continue from the state in @desc, writing one digest per
+ *	      message.  Called with 2 to @mb_max_msgs messages.  It must not
+ *	      modify @desc, which later batches start from.  It may decline a
+ *	      request (e.g. for a partial block in @desc) by returning
+ *	      -EOPNOTSUPP, in which case the messages are hashed one at a time.
+ * @mb_max_msgs: Maximum number of messages @finup_mb can process at once.
+ *		 Must not exceed HASH_MAX_MB_MSGS.  Ignored, and set to 1, if
+ *		 @finup_mb is not implemented.
  * @descsize: Size of the operational state for the message digest. This state
  * 	      size is the memory size that needs to be allocated for
  *	      shash_desc.__ctx
@@ -213,7 +225,11 @@ struct shash_alg {
 	int (*init_tfm)(struct crypto_shash *tfm);
 	void (*exit_tfm)(struct crypto_shash *tfm);
 	int (*clone_tfm)(struct crypto_shash *dst, struct crypto_shash *src);
+	int (*finup_mb)(struct shash_desc *desc, const u8 * const data[],
+			unsigned int len, u8 * const outs[],
+			unsigned int num_msgs);
 
+	unsigned int mb_max_msgs;
 	unsigned int descsize;
 
 	union {
@@ -752,6 +768,18 @@ static inline unsigned int crypto_shash_statesize(struct crypto_shash *tfm)
 	return crypto_shash_alg(tfm)->statesize;
 }
 
+/**
+ * crypto_shash_mb_max_msgs() - obtain the multibuffer batch size
+ * @tfm: cipher handle
+ *
+ * Return: the number of messages crypto_shash_finup_mb() hashes
+ *	   concurrently, 1 if the algorithm only hashes one message at a time
+ */
+static inline unsigned int crypto_shash_mb_max_msgs(struct crypto_shash *tfm)
+{
+	return crypto_shash_alg(tfm)->mb_max_msgs;
+}
+
 static inline u32 crypto_shash_get_flags(struct crypto_shash *tfm)
 {
 	return crypto_tfm_get_flags(crypto_shash_tfm(tfm));
@@ -944,6 +972,29 @@ int crypto_shash_final(struct shash_desc *desc, u8 *out);
 int crypto_shash_finup(struct shash_desc *desc, const u8 *data,
 		       unsigned int len, u8 *out);
 
+/**
+ * crypto_shash_finup_mb() - finish hashing several messages at once
+ * @desc: operational state handle holding the state all messages start from,
+ *	  typically an initialized or a salted state
+ * @data: the messages
+ * @len: length of each message in bytes
+ * @outs: output buffers, one per message, each filled with a message digest
+ * @num_msgs: number of messages
+ *
+ * This is equivalent to calling crypto_shash_finup() for every message on its
+ * own copy of @desc, but lets algorithms that can interleave independent
+ * messages (see crypto_shash_mb_max_msgs()) process them concurrently.  Any
+ * number of messages is accepted; they are split into batches as needed.
+ * The state in @desc is consumed.
+ *
+ * Context: Any context.
+ * Return: 0 if all message digests were successfully calculated; < 0 if an
+ *	   error occurred
+ */
+int crypto_shash_finup_mb(struct shash_desc *desc, const u8 * const data[],
+			  unsigned int len, u8 * const outs[],
+			  unsigned int num_msgs);
+
 static inline void shash_desc_zero(struct shash_desc *desc)
 {
 	memzero_explicit(desc,
@@ -43,6 +43,10 @@ struct device;
  * @pump_requests: work struct for scheduling work to the request pump
  * @priv_data: the engine private data
  * @cur_req: the current request which is on processing
+ * @batch_max: maximum number of requests per batch, 0 if not in batch mode
+ * @batch: requests of the batch the request pump is handing to the driver
+ * @batch_backlog: backlogged requests that entered the queue when each
+ * request of @batch was dequeued
  */
 struct crypto_engine {
 	char			name[ENGINE_NAME_LEN];
@@ -69,6 +73,10 @@ struct crypto_engine {
 
 	void				*priv_data;
 	struct crypto_async_request	*cur_req;
+
+	unsigned int			batch_max;
+	void				*batch[CRYPTO_ENGINE_MAX_BATCH];
+	struct crypto_async_request	*batch_backlog[CRYPTO_ENGINE_MAX_BATCH];
 };
 
 #endif
@@ -20,6 +20,17 @@ struct crypto_scomp {
 	struct crypto_tfm base;
 };
 
+/**
+ * struct scomp_stats - acomp request counts of a scomp algorithm, per CPU
+ *
+ * @direct:	Number of acomp requests processed in place
+ * @bounced:	Number of acomp requests copied through the scratch buffers
+ */
+struct scomp_stats {
+	unsigned long direct;
+	unsigned long bounced;
+};
+
 /**
  * struct scomp_alg - synchronous compression algorithm
  *
@@ -27,6 +38,7 @@ struct crypto_scomp {
  * @free_ctx:	Function frees context allocated with alloc_ctx
  * @compress:	Function performs a compress operation
  * @decompress:	Function performs a de-compress operation
+ * @stats:	Per-CPU acomp request counts, allocated on registration
  * @base:	Common crypto API algorithm data structure
  * @calg:	Cmonn algorithm data structure shared with acomp
  */
@@ -40,6 +52,8 @@ struct scomp_alg {
 			  unsigned int slen, u8 *dst, unsigned int *dlen,
 			  void *ctx);
 
+	struct scomp_stats __percpu *stats;
+
 	union {
 		struct COMP_ALG_COMMON;
 		struct comp_alg_common calg;
@@ -16,6 +16,8 @@
 struct pcrypt_request {
 	struct padata_priv	padata;
 	void			*data;
+	atomic_t		*inflight;
+	u64			done_ns;
 	void			*__ctx[] CRYPTO_MINALIGN_ATTR;
 };
 
@@ -100,6 +100,61 @@ static inline bool mem_alloc_profiling_enabled(void)
 				   &mem_alloc_profiling_key);
 }
 
+/*
+ * In sampling mode only about one in 2^alloc_tag_sample_shift slab and percpu
+ * allocations is accounted, with its size and call count scaled up by the same
+ * factor, so that the counters remain unbiased estimates.  The gaps between
+ * samples are random to avoid aliasing with periodic allocation patterns.
+ *
+ * The shift an allocation was accounted with is kept in the low bits of its
+ * codetag_ref, so that it is subtracted with the same weight on free even if
+ * the rate changed in between.  Page allocations are always fully accounted.
+ */
+#define ALLOC_TAG_SAMPLE_SHIFT_MAX	7
+#define ALLOC_TAG_REF_SHIFT_MASK	((unsigned long)ALLOC_TAG_SAMPLE_SHIFT_MAX)
+static_assert(__alignof__(struct alloc_tag) > ALLOC_TAG_REF_SHIFT_MASK);
+
+DECLARE_STATIC_KEY_FALSE(mem_alloc_profiling_sampling);
+DECLARE_PER_CPU(int, alloc_tag_sample_left);
+
+unsigned int alloc_tag_sample_reset(void);
+
+enum alloc_tag_mode {
+	ALLOC_TAG_MODE_OFF,
+	ALLOC_TAG_MODE_FULL,
+	ALLOC_TAG_MODE_SAMPLED,
+};
+
+enum alloc_tag_mode alloc_tag_get_mode(void);
+int alloc_tag_set_mode(enum alloc_tag_mode mode);
+
+static inline struct codetag *codetag_ref_ct(union codetag_ref *ref)
+{
+	return (void *)((unsigned long)ref->ct & ~ALLOC_TAG_REF_SHIFT_MASK);
+}
+
+static inline unsigned int codetag_ref_shift(union codetag_ref *ref)
+{
+	return (unsigned long)ref->ct & ALLOC_TAG_REF_SHIFT_MASK;
+}
+
+/*
+ * Decide whether to account an allocation in sampling mode.  Returns true
+ * with the shift to scale it by in @shift, or false to skip it.
+ */
+static inline bool alloc_tag_sample(unsigned int *shift)
+{
+	*shift = 0;
+	if (!static_branch_unlikely(&mem_alloc_profiling_sampling))
+		return true;
+
+	if (likely(this_cpu_dec_return(alloc_tag_sample_left) > 0))
+		return false;
+
+	*shift = alloc_tag_sample_reset();
+	return true;
+}
+
 static inline struct alloc_tag_counters alloc_tag_read(struct alloc_tag *tag)
 {
 	struct alloc_tag_counters v = { 0, 0 };
@@ -120,7 +175,7 @@ static inline void alloc_tag_add_check(union codetag_ref *ref, struct alloc_tag
 {
 	WARN_ONCE(ref && ref->ct,
 		  "alloc_tag was not cleared (got tag for %s:%u)\n",
-		  ref->ct->filename, ref->ct->lineno);
+		  codetag_ref_ct(ref)->filename, codetag_ref_ct(ref)->lineno);
 
 	WARN_ONCE(!tag, "current->alloc_tag not set\n");
 }
@@ -166,9 +221,30 @@ static inline void alloc_tag_add(union codetag_ref *ref, struct alloc_tag *tag,
 		this_cpu_add(tag->counters->bytes, bytes);
 }
 
+/* Like alloc_tag_add(), but only accounts a sample in sampling mode */
+static inline void alloc_tag_add_sampled(union codetag_ref *ref,
+					 struct alloc_tag *tag, size_t bytes)
+{
+	unsigned int shift;
+
+	if (!alloc_tag_sample(&shift)) {
+		/* Not accounted, but must not look like a missed tag either */
+		set_codetag_empty(ref);
+		return;
+	}
+
+	if (unlikely(!__alloc_tag_ref_set(ref, tag)))
+		return;
+
+	ref->ct = (void *)((unsigned long)ref->ct | shift);
+	this_cpu_add(tag->counters->calls, 1ULL << shift);
+	this_cpu_add(tag->counters->bytes, (u64)bytes << shift);
+}
+
 static inline void alloc_tag_sub(union codetag_ref *ref, size_t bytes)
 {
 	struct alloc_tag *tag;
+	unsigned int shift;
 
 	alloc_tag_sub_check(ref);
 	if (!ref || !ref->ct)
@@ -179,10 +255,11 @@ static inline void alloc_tag_sub(union codetag_ref *ref, size_t bytes)
 		return;
 	}
 
-	tag = ct_to_alloc_tag(ref->ct);
+	tag = ct_to_alloc_tag(codetag_ref_ct(ref));
+	shift = codetag_ref_shift(ref);
 
-	this_cpu_sub(tag->counters->bytes, bytes);
-	this_cpu_dec(tag->counters->calls);
+	this_cpu_sub(tag->counters->bytes, (u64)bytes << shift);
+	this_cpu_sub(tag->counters->calls, 1ULL << shift);
 
 	ref->ct = NULL;
 }
@@ -195,6 +272,8 @@ static inline void alloc_tag_sub(union codetag_ref *ref, size_t bytes)
 static inline bool mem_alloc_profiling_enabled(void) { return false; }
 static inline void alloc_tag_add(union codetag_ref *ref, struct alloc_tag *tag,
 				 size_t bytes) {}
+static inline void alloc_tag_add_sampled(union codetag_ref *ref,
+					 struct alloc_tag *tag, size_t bytes) {}
 static inline void alloc_tag_sub(union codetag_ref *ref, size_t bytes) {}
 #define alloc_tag_record(p)	do {} while (0)
 
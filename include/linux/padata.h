@@ -176,6 +176,7 @@ struct padata_instance {
 #define	PADATA_INIT	1
 #define	PADATA_RESET	2
 #define	PADATA_INVALID	4
+#define	PADATA_CACHE_LOCAL	8
 };
 
 #ifdef CONFIG_PADATA
@@ -190,6 +191,7 @@ extern void padata_do_serial(struct padata_priv *padata);
 extern void __init padata_do_multithreaded(struct padata_mt_job *job);
 extern int padata_set_cpumask(struct padata_instance *pinst, int cpumask_type,
 			      cpumask_var_t cpumask);
+extern int padata_set_cache_local(struct padata_instance *pinst, bool enable);
 #else
 static inline void __init padata_init(void) {}
 static inline void __init padata_do_multithreaded(struct padata_mt_job *job)
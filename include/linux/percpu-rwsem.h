@@ -9,12 +9,21 @@
 #include <linux/rcu_sync.h>
 #include <linux/lockdep.h>
 
+/* Writer-side statistics, updated with the write lock held. */
+struct percpu_rwsem_stats {
+	unsigned long		writes;		/* Write acquisitions */
+	unsigned long		write_gps;	/* ... which waited for a GP */
+	u64			write_wait_ns;	/* Total write acquisition latency */
+	u64			write_wait_max_ns;
+};
+
 struct percpu_rw_semaphore {
 	struct rcu_sync		rss;
 	unsigned int __percpu	*read_count;
 	struct rcuwait		writer;
 	wait_queue_head_t	waiters;
 	atomic_t		block;
+	struct percpu_rwsem_stats stats;
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	struct lockdep_map	dep_map;
 #endif
@@ -124,6 +133,20 @@ static inline void percpu_up_read(struct percpu_rw_semaphore *sem)
 extern bool percpu_is_read_locked(struct percpu_rw_semaphore *);
 extern void percpu_down_write(struct percpu_rw_semaphore *);
 extern void percpu_up_write(struct percpu_rw_semaphore *);
+extern void percpu_rwsem_get_stats(struct percpu_rw_semaphore *,
+				   struct percpu_rwsem_stats *);
+
+/*
+ * Let writers which follow each other within @linger grace periods share
+ * one grace period, and/or use expedited grace periods for writers which
+ * do have to wait. See rcu_sync_set_batching().
+ */
+static inline void percpu_rwsem_set_batching(struct percpu_rw_semaphore *sem,
+					     unsigned short linger,
+					     bool expedited)
+{
+	rcu_sync_set_batching(&sem->rss, linger, expedited);
+}
 
 static inline bool percpu_is_write_locked(struct percpu_rw_semaphore *sem)
 {
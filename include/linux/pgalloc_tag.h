@@ -90,7 +90,7 @@ static inline struct alloc_tag *pgalloc_tag_get(struct page *page)
 		alloc_tag_sub_check(ref);
 		if (ref) {
 			if (ref->ct)
-				tag = ct_to_alloc_tag(ref->ct);
+				tag = ct_to_alloc_tag(codetag_ref_ct(ref));
 			put_page_tag_ref(ref);
 		}
 	}
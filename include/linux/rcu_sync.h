@@ -17,6 +17,9 @@
 struct rcu_sync {
 	int			gp_state;
 	int			gp_count;
+	unsigned short		gp_linger;	/* Extra GPs on the slowpath after exit */
+	unsigned short		gp_linger_left;
+	bool			gp_expedited;	/* Use expedited GPs on enter */
 	wait_queue_head_t	gp_wait;
 
 	struct rcu_head		cb_head;
@@ -37,7 +40,9 @@ static inline bool rcu_sync_is_idle(struct rcu_sync *rsp)
 }
 
 extern void rcu_sync_init(struct rcu_sync *);
-extern void rcu_sync_enter(struct rcu_sync *);
+extern void rcu_sync_set_batching(struct rcu_sync *, unsigned short linger,
+				  bool expedited);
+extern bool rcu_sync_enter(struct rcu_sync *);
 extern void rcu_sync_exit(struct rcu_sync *);
 extern void rcu_sync_dtor(struct rcu_sync *);
 
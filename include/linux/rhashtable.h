@@ -698,6 +698,60 @@ static inline struct rhlist_head *rhltable_lookup(
 	return he ? container_of(he, struct rhlist_head, rhead) : NULL;
 }
 
+/* Internal function, used by __rhashtable_insert_fast() for keyless inserts
+ * into tables with params.lockless_insert set.  Links @obj at the head of an
+ * unlocked bucket with a single cmpxchg() instead of taking the bucket bit
+ * lock.  Returns ERR_PTR(-EAGAIN) if the locked path has to be taken instead.
+ *
+ * The cmpxchg() only succeeds if the bucket is unlocked and its head is the
+ * one @obj was linked to.  Without a key there is no clash to check for, so
+ * it does not matter how the chain changed in between.  Keyed inserts always
+ * take the bucket lock.  The caller holds the RCU read lock across the check
+ * of future_tbl and the cmpxchg(), and a rehash waits for a grace period
+ * before it walks the old table, so the object cannot be left behind.
+ */
+static inline void *__rhashtable_insert_lockless(
+	struct rhashtable *ht, struct rhash_head *obj,
+	const struct rhashtable_params params)
+{
+	struct rhash_lock_head __rcu **bkt;
+	struct rhash_lock_head *old;
+	struct bucket_table *tbl;
+	struct rhash_head *head, *pos;
+	unsigned int hash;
+	int elasticity;
+
+	tbl = rht_dereference_rcu(ht->tbl, ht);
+	if (unlikely(tbl->nest || rcu_access_pointer(tbl->future_tbl) ||
+		     rht_grow_above_100(ht, tbl) ||
+		     rht_grow_above_max(ht, tbl)))
+		return ERR_PTR(-EAGAIN);
+
+	hash = rht_head_hashfn(ht, tbl, obj, params);
+	bkt = &tbl->buckets[hash];
+	old = rcu_dereference(*bkt);
+	if ((unsigned long)old & BIT(0))
+		return ERR_PTR(-EAGAIN);
+
+	head = __rht_ptr(old, bkt);
+	elasticity = RHT_ELASTICITY;
+	rht_for_each_rcu_from(pos, head, tbl, hash) {
+		if (--elasticity <= 0)
+			return ERR_PTR(-EAGAIN);
+	}
+
+	RCU_INIT_POINTER(obj->next, head);
+	if (cmpxchg((unsigned long *)bkt, (unsigned long)old,
+		    (unsigned long)obj) != (unsigned long)old)
+		return ERR_PTR(-EAGAIN);
+
+	atomic_inc(&ht->nelems);
+	if (rht_grow_above_75(ht, tbl))
+		schedule_work(&ht->run_work);
+
+	return NULL;
+}
+
 /* Internal function, please use rhashtable_insert_fast() instead. This
  * function returns the existing element already in hashes if there is a clash,
  * otherwise it returns an error via ERR_PTR().
@@ -721,6 +775,12 @@ static inline void *__rhashtable_insert_fast(
 
 	rcu_read_lock();
 
+	if (params.lockless_insert && !rhlist && !key) {
+		data = __rhashtable_insert_lockless(ht, obj, params);
+		if (data != ERR_PTR(-EAGAIN))
+			goto out;
+	}
+
 	tbl = rht_dereference_rcu(ht->tbl, ht);
 	hash = rht_head_hashfn(ht, tbl, obj, params);
 	elasticity = RHT_ELASTICITY;
@@ -818,7 +878,10 @@ static inline void *__rhashtable_insert_fast(
  *
  * Will take the per bucket bitlock to protect against mutual mutations
  * on the same bucket. Multiple insertions may occur in parallel unless
- * they map to the same bucket.
+ * they map to the same bucket.  If params.lockless_insert is set, an
+ * insertion into an unlocked bucket while no resize is in progress links
+ * the object with cmpxchg() instead.  This only applies here, not to the
+ * keyed insertions that check for an existing object.
  *
  * It is safe to call this function from atomic context.
  *
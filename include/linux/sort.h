@@ -13,4 +13,13 @@ void sort(void *base, size_t num, size_t size,
 	  cmp_func_t cmp_func,
 	  swap_func_t swap_func);
 
+/* Returns the integer sort key of an element, for sort_radix() */
+typedef u64 (*sort_key_func_t)(const void *elem);
+
+void sort_radix(void *base, size_t num, size_t size,
+		sort_key_func_t key_func, unsigned int key_bits);
+
+void sort_parallel(void *base, size_t num, size_t size,
+		   cmp_r_func_t cmp_func, const void *priv);
+
 #endif
@@ -623,6 +623,41 @@ TRACE_EVENT_RCU(rcu_batch_start,
 		  __entry->rcuname, __entry->qlen, __entry->blimit)
 );
 
+/*
+ * Tracepoint for adaptive batch-limit selection in rcu_do_batch().  The
+ * first argument is the name of the RCU flavor, the second is the
+ * average per-callback invocation cost in nanoseconds, the third is the
+ * static batch limit, the fourth is the adaptive batch limit, and the
+ * fifth is true if the RCU callback shrinker reported memory pressure.
+ */
+TRACE_EVENT_RCU(rcu_batch_adapt,
+
+	TP_PROTO(const char *rcuname, unsigned long cost_ns, long blimit,
+		 long ablimit, bool pressure),
+
+	TP_ARGS(rcuname, cost_ns, blimit, ablimit, pressure),
+
+	TP_STRUCT__entry(
+		__field(const char *, rcuname)
+		__field(unsigned long, cost_ns)
+		__field(long, blimit)
+		__field(long, ablimit)
+		__field(bool, pressure)
+	),
+
+	TP_fast_assign(
+		__entry->rcuname = rcuname;
+		__entry->cost_ns = cost_ns;
+		__entry->blimit = blimit;
+		__entry->ablimit = ablimit;
+		__entry->pressure = pressure;
+	),
+
+	TP_printk("%s cost=%luns bl=%ld abl=%ld%s",
+		  __entry->rcuname, __entry->cost_ns, __entry->blimit,
+		  __entry->ablimit, __entry->pressure ? " pressure" : "")
+);
+
 /*
  * Tracepoint for the invocation of a single RCU callback function.
  * The first argument is the type of RCU, and the second argument is
@@ -209,6 +209,10 @@ static u16 have_canfork_callback __read_mostly;
 
 static bool have_favordynmods __ro_after_init = IS_ENABLED(CONFIG_CGROUP_FAVOR_DYNMODS);
 
+/* cgroup_threadgroup_rwsem writer batching, see "cgroup_rwsem_batch=" */
+static unsigned short cgroup_rwsem_linger __initdata;
+static bool cgroup_rwsem_expedited __initdata;
+
 /* cgroup namespace for init task */
 struct cgroup_namespace init_cgroup_ns = {
 	.ns.count	= REFCOUNT_INIT(2),
@@ -6169,6 +6173,9 @@ int __init cgroup_init(void)
 
 	cgroup_rstat_boot();
 
+	percpu_rwsem_set_batching(&cgroup_threadgroup_rwsem,
+				  cgroup_rwsem_linger, cgroup_rwsem_expedited);
+
 	get_user_ns(init_cgroup_ns.user_ns);
 
 	cgroup_lock();
@@ -6864,6 +6871,24 @@ static int __init cgroup_favordynmods_setup(char *str)
 }
 __setup("cgroup_favordynmods=", cgroup_favordynmods_setup);
 
+/*
+ * cgroup_rwsem_batch=<gps>[,expedited]: keep fork/exit on the
+ * cgroup_threadgroup_rwsem slowpath for <gps> grace periods after a
+ * migration, so that back-to-back migrations share a grace period, and
+ * optionally expedite the grace periods that migrations do wait for.
+ */
+static int __init cgroup_rwsem_batch_setup(char *str)
+{
+	char *token = strsep(&str, ",");
+
+	if (kstrtou16(token, 0, &cgroup_rwsem_linger))
+		return 0;
+	if (str && !strcmp(str, "expedited"))
+		cgroup_rwsem_expedited = true;
+	return 1;
+}
+__setup("cgroup_rwsem_batch=", cgroup_rwsem_batch_setup);
+
 /**
  * css_tryget_online_from_dir - get corresponding css from a cgroup dentry
  * @dentry: directory dentry of interest
@@ -268,6 +268,18 @@ static int cgroup_masks_read(struct seq_file *seq, void *v)
 	return 0;
 }
 
+static int threadgroup_rwsem_read(struct seq_file *seq, void *v)
+{
+	struct percpu_rwsem_stats stats;
+
+	percpu_rwsem_get_stats(&cgroup_threadgroup_rwsem, &stats);
+	seq_printf(seq, "writes %lu\n", stats.writes);
+	seq_printf(seq, "write_gps %lu\n", stats.write_gps);
+	seq_printf(seq, "write_wait_ns %llu\n", stats.write_wait_ns);
+	seq_printf(seq, "write_wait_max_ns %llu\n", stats.write_wait_max_ns);
+	return 0;
+}
+
 static u64 releasable_read(struct cgroup_subsys_state *css, struct cftype *cft)
 {
 	return (!cgroup_is_populated(css->cgroup) &&
@@ -318,6 +330,12 @@ static struct cftype debug_legacy_files[] =  {
 		.read_u64 = releasable_read,
 	},
 
+	{
+		.name = "threadgroup_rwsem",
+		.seq_show = threadgroup_rwsem_read,
+		.flags = CFTYPE_ONLY_ON_ROOT,
+	},
+
 	{ }	/* terminate */
 };
 
@@ -360,6 +378,12 @@ static struct cftype debug_files[] =  {
 		.seq_show = cgroup_masks_read,
 	},
 
+	{
+		.name = "threadgroup_rwsem",
+		.seq_show = threadgroup_rwsem_read,
+		.flags = CFTYPE_ONLY_ON_ROOT,
+	},
+
 	{ }	/* terminate */
 };
 
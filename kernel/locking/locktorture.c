@@ -784,6 +784,36 @@ static struct lock_torture_ops rwsem_lock_ops = {
 	.name		= "rwsem_lock"
 };
 
+/*
+ * Short critical sections on both sides, loosely modelling mmap_lock with
+ * page faults as readers and mmap()/munmap() as writers.  Compare the
+ * reader acquisition counts with and without rwsem.reader_spin.
+ */
+static void torture_rwsem_mmap_write_delay(struct torture_random_state *trsp)
+{
+	udelay(5 + torture_random(trsp) % 10);
+	if (!(torture_random(trsp) % (cxt.nrealwriters_stress * 20000)))
+		torture_preempt_schedule();  /* Allow test to be preempted. */
+}
+
+static void torture_rwsem_mmap_read_delay(struct torture_random_state *trsp)
+{
+	udelay(1 + torture_random(trsp) % 3);
+	if (!(torture_random(trsp) % (cxt.nrealreaders_stress * 20000)))
+		torture_preempt_schedule();  /* Allow test to be preempted. */
+}
+
+static struct lock_torture_ops rwsem_mmap_lock_ops = {
+	.writelock	= torture_rwsem_down_write,
+	.write_delay	= torture_rwsem_mmap_write_delay,
+	.task_boost     = torture_rt_boost,
+	.writeunlock	= torture_rwsem_up_write,
+	.readlock       = torture_rwsem_down_read,
+	.read_delay     = torture_rwsem_mmap_read_delay,
+	.readunlock     = torture_rwsem_up_read,
+	.name		= "rwsem_mmap_lock"
+};
+
 #include <linux/percpu-rwsem.h>
 static struct percpu_rw_semaphore pcpu_rwsem;
 
@@ -1175,6 +1205,7 @@ static int __init lock_torture_init(void)
 		&rtmutex_lock_ops,
 #endif
 		&rwsem_lock_ops,
+		&rwsem_mmap_lock_ops,
 		&percpu_rwsem_lock_ops,
 	};
 
@@ -6,6 +6,7 @@
 #include <linux/percpu-rwsem.h>
 #include <linux/rcupdate.h>
 #include <linux/sched.h>
+#include <linux/sched/clock.h>
 #include <linux/sched/task.h>
 #include <linux/sched/debug.h>
 #include <linux/errno.h>
@@ -22,6 +23,7 @@ int __percpu_init_rwsem(struct percpu_rw_semaphore *sem,
 	rcuwait_init(&sem->writer);
 	init_waitqueue_head(&sem->waiters);
 	atomic_set(&sem->block, 0);
+	memset(&sem->stats, 0, sizeof(sem->stats));
 #ifdef CONFIG_DEBUG_LOCK_ALLOC
 	debug_check_no_locks_freed((void *)sem, sizeof(*sem));
 	lockdep_init_map(&sem->dep_map, name, key, 0);
@@ -221,15 +223,43 @@ static bool readers_active_check(struct percpu_rw_semaphore *sem)
 	return true;
 }
 
+/*
+ * Called with the write lock held, which serializes the updates.
+ */
+static void percpu_rwsem_account_write(struct percpu_rw_semaphore *sem,
+				       bool waited_gp, u64 wait_ns)
+{
+	struct percpu_rwsem_stats *stats = &sem->stats;
+
+	WRITE_ONCE(stats->writes, stats->writes + 1);
+	if (waited_gp)
+		WRITE_ONCE(stats->write_gps, stats->write_gps + 1);
+	WRITE_ONCE(stats->write_wait_ns, stats->write_wait_ns + wait_ns);
+	if (wait_ns > stats->write_wait_max_ns)
+		WRITE_ONCE(stats->write_wait_max_ns, wait_ns);
+}
+
+void percpu_rwsem_get_stats(struct percpu_rw_semaphore *sem,
+			    struct percpu_rwsem_stats *stats)
+{
+	stats->writes = READ_ONCE(sem->stats.writes);
+	stats->write_gps = READ_ONCE(sem->stats.write_gps);
+	stats->write_wait_ns = READ_ONCE(sem->stats.write_wait_ns);
+	stats->write_wait_max_ns = READ_ONCE(sem->stats.write_wait_max_ns);
+}
+EXPORT_SYMBOL_GPL(percpu_rwsem_get_stats);
+
 void __sched percpu_down_write(struct percpu_rw_semaphore *sem)
 {
+	u64 start = local_clock();
 	bool contended = false;
+	bool waited_gp;
 
 	might_sleep();
 	rwsem_acquire(&sem->dep_map, 0, 0, _RET_IP_);
 
 	/* Notify readers to take the slow path. */
-	rcu_sync_enter(&sem->rss);
+	waited_gp = rcu_sync_enter(&sem->rss);
 
 	/*
 	 * Try set sem->block; this provides writer-writer exclusion.
@@ -253,6 +283,8 @@ void __sched percpu_down_write(struct percpu_rw_semaphore *sem)
 	rcuwait_wait_event(&sem->writer, readers_active_check(sem), TASK_UNINTERRUPTIBLE);
 	if (contended)
 		trace_contention_end(sem, 0);
+
+	percpu_rwsem_account_write(sem, waited_gp, local_clock() - start);
 }
 EXPORT_SYMBOL_GPL(percpu_down_write);
 
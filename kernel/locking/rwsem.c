@@ -25,6 +25,7 @@
 #include <linux/sched/signal.h>
 #include <linux/sched/clock.h>
 #include <linux/export.h>
+#include <linux/moduleparam.h>
 #include <linux/rwsem.h>
 #include <linux/atomic.h>
 #include <trace/events/lock.h>
@@ -932,6 +933,71 @@ static bool rwsem_optimistic_spin(struct rw_semaphore *sem)
 	return taken;
 }
 
+/*
+ * Reader optimistic spinning: a reader which finds the rwsem owned by a
+ * running writer spins until the writer releases it instead of sleeping.
+ * Off by default, as a stream of spinning readers makes it harder for
+ * waiting writers to get the lock; they are protected by the handoff
+ * bit, which stops reader spinning.
+ */
+static bool reader_spin;
+module_param(reader_spin, bool, 0644);
+
+static inline bool rwsem_reader_spin_enabled(void)
+{
+	return READ_ONCE(reader_spin);
+}
+
+/*
+ * Spin while a writer owns the lock. The reader's RWSEM_READER_BIAS is
+ * already in the count, so the read lock is granted as soon as the writer
+ * bit is cleared while no handoff is pending. On success, *cntp is
+ * updated with the count the lock was acquired with.
+ */
+static bool rwsem_reader_optimistic_spin(struct rw_semaphore *sem, long *cntp)
+{
+	bool taken = false;
+	long count;
+
+	if (!rwsem_can_spin_on_owner(sem))
+		goto done;
+
+	if (!osq_lock(&sem->osq))
+		goto done;
+
+	for (;;) {
+		enum owner_state owner_state;
+
+		owner_state = rwsem_spin_on_owner(sem);
+		if (!(owner_state & OWNER_SPINNABLE))
+			break;
+
+		count = atomic_long_read(&sem->count);
+		if (count & RWSEM_FLAG_HANDOFF) {
+			lockevent_inc(rwsem_rspin_handoff);
+			break;
+		}
+		if (!(count & RWSEM_WRITER_LOCKED)) {
+			/* Provide lock ACQUIRE */
+			smp_acquire__after_ctrl_dep();
+			*cntp = count;
+			taken = true;
+			break;
+		}
+
+		/* See rwsem_optimistic_spin() for the RT task restriction. */
+		if (owner_state != OWNER_WRITER &&
+		    (need_resched() || rt_or_dl_task(current)))
+			break;
+
+		cpu_relax();
+	}
+	osq_unlock(&sem->osq);
+done:
+	lockevent_cond_inc(rwsem_rspin_fail, !taken);
+	return taken;
+}
+
 /*
  * Clear the owner's RWSEM_NONSPINNABLE bit if it is set. This should
  * only be called when the reader count reaches 0.
@@ -943,6 +1009,17 @@ static inline void clear_nonspinnable(struct rw_semaphore *sem)
 }
 
 #else
+static inline bool rwsem_reader_spin_enabled(void)
+{
+	return false;
+}
+
+static inline bool rwsem_reader_optimistic_spin(struct rw_semaphore *sem,
+						long *cntp)
+{
+	return false;
+}
+
 static inline bool rwsem_can_spin_on_owner(struct rw_semaphore *sem)
 {
 	return false;
@@ -987,6 +1064,26 @@ static inline void rwsem_cond_wake_waiter(struct rw_semaphore *sem, long count,
 	rwsem_mark_wake(sem, wake_type, wake_q);
 }
 
+/*
+ * The read lock was acquired without queuing. Wake up other readers in the
+ * wait queue if this is the first reader.
+ */
+static void rwsem_read_lock_unqueued(struct rw_semaphore *sem, long count)
+{
+	long rcnt = (count >> RWSEM_READER_SHIFT);
+	DEFINE_WAKE_Q(wake_q);
+
+	rwsem_set_reader_owned(sem);
+
+	if ((rcnt == 1) && (count & RWSEM_FLAG_WAITERS)) {
+		raw_spin_lock_irq(&sem->wait_lock);
+		if (!list_empty(&sem->wait_list))
+			rwsem_mark_wake(sem, RWSEM_WAKE_READ_OWNED, &wake_q);
+		raw_spin_unlock_irq(&sem->wait_lock);
+		wake_up_q(&wake_q);
+	}
+}
+
 /*
  * Wait for the read lock to be granted
  */
@@ -998,6 +1095,17 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, unsigned int stat
 	struct rwsem_waiter waiter;
 	DEFINE_WAKE_Q(wake_q);
 
+	/*
+	 * Reader optimistic spinning on a running writer owner.
+	 */
+	if ((count & RWSEM_WRITER_LOCKED) && !(count & RWSEM_FLAG_HANDOFF) &&
+	    rwsem_reader_spin_enabled() &&
+	    rwsem_reader_optimistic_spin(sem, &count)) {
+		lockevent_inc(rwsem_rspin_lock);
+		rwsem_read_lock_unqueued(sem, count);
+		return sem;
+	}
+
 	/*
 	 * To prevent a constant stream of readers from starving a sleeping
 	 * writer, don't attempt optimistic lock stealing if the lock is
@@ -1011,21 +1119,8 @@ rwsem_down_read_slowpath(struct rw_semaphore *sem, long count, unsigned int stat
 	 * Reader optimistic lock stealing.
 	 */
 	if (!(count & (RWSEM_WRITER_LOCKED | RWSEM_FLAG_HANDOFF))) {
-		rwsem_set_reader_owned(sem);
 		lockevent_inc(rwsem_rlock_steal);
-
-		/*
-		 * Wake up other readers in the wait queue if it is
-		 * the first reader.
-		 */
-		if ((rcnt == 1) && (count & RWSEM_FLAG_WAITERS)) {
-			raw_spin_lock_irq(&sem->wait_lock);
-			if (!list_empty(&sem->wait_list))
-				rwsem_mark_wake(sem, RWSEM_WAKE_READ_OWNED,
-						&wake_q);
-			raw_spin_unlock_irq(&sem->wait_lock);
-			wake_up_q(&wake_q);
-		}
+		rwsem_read_lock_unqueued(sem, count);
 		return sem;
 	}
 
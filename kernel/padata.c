@@ -433,6 +433,13 @@ static int padata_setup_cpumasks(struct padata_instance *pinst)
 
 	/* Restrict parallel_wq workers to pd->cpumask.pcpu. */
 	cpumask_copy(attrs->cpumask, pinst->cpumask.pcpu);
+
+	/* Keep them in the cache domain of the CPU that queued the work. */
+	if (pinst->flags & PADATA_CACHE_LOCAL) {
+		attrs->affn_scope = WQ_AFFN_CACHE;
+		attrs->affn_strict = true;
+	}
+
 	err = apply_workqueue_attrs(pinst->parallel_wq, attrs);
 	free_workqueue_attrs(attrs);
 
@@ -780,6 +787,36 @@ int padata_set_cpumask(struct padata_instance *pinst, int cpumask_type,
 }
 EXPORT_SYMBOL(padata_set_cpumask);
 
+/**
+ * padata_set_cache_local - keep parallel workers in the submitter's cache domain
+ *
+ * @pinst: padata instance
+ * @enable: whether parallel work may only run on CPUs that share a cache
+ *          with the CPU calling padata_do_parallel()
+ *
+ * Return: 0 on success or negative error code
+ */
+int padata_set_cache_local(struct padata_instance *pinst, bool enable)
+{
+	int err;
+
+	cpus_read_lock();
+	mutex_lock(&pinst->lock);
+
+	if (enable)
+		pinst->flags |= PADATA_CACHE_LOCAL;
+	else
+		pinst->flags &= ~PADATA_CACHE_LOCAL;
+
+	err = padata_setup_cpumasks(pinst);
+
+	mutex_unlock(&pinst->lock);
+	cpus_read_unlock();
+
+	return err;
+}
+EXPORT_SYMBOL(padata_set_cache_local);
+
 #ifdef CONFIG_HOTPLUG_CPU
 
 static int __padata_add_cpu(struct padata_instance *pinst, int cpu)
@@ -708,6 +708,7 @@ torture_param(int, kfree_alloc_num, 8000, "Number of allocations and frees done
 torture_param(int, kfree_loops, 10, "Number of loops doing kfree_alloc_num allocations and frees.");
 torture_param(bool, kfree_rcu_test_double, false, "Do we run a kfree_rcu() double-argument scale test?");
 torture_param(bool, kfree_rcu_test_single, false, "Do we run a kfree_rcu() single-argument scale test?");
+torture_param(int, kfree_cb_ndelay, 0, "Per-callback delay (ns) when emulating kfree_rcu() via call_rcu()");
 
 static struct task_struct **kfree_reader_tasks;
 static int kfree_nrealthreads;
@@ -726,6 +727,10 @@ static void kfree_call_rcu(struct rcu_head *rh)
 {
 	struct kfree_obj *obj = container_of(rh, struct kfree_obj, rh);
 
+	// Emulate heavier callbacks, e.g. file teardown, to exercise
+	// rcutree.rcu_adaptive_blimit.
+	if (kfree_cb_ndelay)
+		ndelay(kfree_cb_ndelay);
 	kfree(obj);
 }
 
@@ -862,8 +867,8 @@ kfree_scale_init(void)
 	unsigned long orig_jif;
 
 	pr_alert("%s" SCALE_FLAG
-		 "--- kfree_rcu_test: kfree_mult=%d kfree_by_call_rcu=%d kfree_nthreads=%d kfree_alloc_num=%d kfree_loops=%d kfree_rcu_test_double=%d kfree_rcu_test_single=%d\n",
-		 scale_type, kfree_mult, kfree_by_call_rcu, kfree_nthreads, kfree_alloc_num, kfree_loops, kfree_rcu_test_double, kfree_rcu_test_single);
+		 "--- kfree_rcu_test: kfree_mult=%d kfree_by_call_rcu=%d kfree_nthreads=%d kfree_alloc_num=%d kfree_loops=%d kfree_rcu_test_double=%d kfree_rcu_test_single=%d kfree_cb_ndelay=%d\n",
+		 scale_type, kfree_mult, kfree_by_call_rcu, kfree_nthreads, kfree_alloc_num, kfree_loops, kfree_rcu_test_double, kfree_rcu_test_single, kfree_cb_ndelay);
 
 	// Also, do a quick self-test to ensure laziness is as much as
 	// expected.
@@ -24,6 +24,27 @@ void rcu_sync_init(struct rcu_sync *rsp)
 	init_waitqueue_head(&rsp->gp_wait);
 }
 
+/**
+ * rcu_sync_set_batching() - Configure grace-period batching of updaters
+ * @rsp: Pointer to rcu_sync structure to be configured
+ * @linger: Number of extra grace periods to keep readers on their slowpath
+ *	after the last rcu_sync_exit()
+ * @expedited: Use expedited grace periods in rcu_sync_enter()
+ *
+ * An rcu_sync_enter() which comes in while readers are still on their
+ * slowpath does not wait for a grace period, so lingering lets frequent
+ * but non-overlapping updaters share one grace period at the expense of
+ * keeping readers off their fastpaths for longer.
+ */
+void rcu_sync_set_batching(struct rcu_sync *rsp, unsigned short linger,
+			   bool expedited)
+{
+	spin_lock_irq(&rsp->rss_lock);
+	rsp->gp_linger = linger;
+	rsp->gp_expedited = expedited;
+	spin_unlock_irq(&rsp->rss_lock);
+}
+
 static void rcu_sync_func(struct rcu_head *rhp);
 
 static void rcu_sync_call(struct rcu_sync *rsp)
@@ -76,6 +97,13 @@ static void rcu_sync_func(struct rcu_head *rhp)
 		 */
 		WRITE_ONCE(rsp->gp_state, GP_EXIT);
 		rcu_sync_call(rsp);
+	} else if (rsp->gp_linger_left) {
+		/*
+		 * Batching was requested; keep the readers on their slowpath
+		 * for another GP so that a new rcu_sync_enter() needn't wait.
+		 */
+		rsp->gp_linger_left--;
+		rcu_sync_call(rsp);
 	} else {
 		/*
 		 * We're at least a GP after the last rcu_sync_exit(); everybody
@@ -101,13 +129,17 @@ static void rcu_sync_func(struct rcu_head *rhp)
  * period, however, closely spaced calls to rcu_sync_enter() can
  * optimize away the grace-period wait via a state machine implemented
  * by rcu_sync_enter(), rcu_sync_exit(), and rcu_sync_func().
+ *
+ * Returns true if the caller had to wait for a grace period.
  */
-void rcu_sync_enter(struct rcu_sync *rsp)
+bool rcu_sync_enter(struct rcu_sync *rsp)
 {
+	bool expedited;
 	int gp_state;
 
 	spin_lock_irq(&rsp->rss_lock);
 	gp_state = rsp->gp_state;
+	expedited = rsp->gp_expedited;
 	if (gp_state == GP_IDLE) {
 		WRITE_ONCE(rsp->gp_state, GP_ENTER);
 		WARN_ON_ONCE(rsp->gp_count);
@@ -130,13 +162,20 @@ void rcu_sync_enter(struct rcu_sync *rsp)
 		 * See the comment above, this simply does the "synchronous"
 		 * call_rcu(rcu_sync_func) which does GP_ENTER -> GP_PASSED.
 		 */
-		synchronize_rcu();
+		if (expedited)
+			synchronize_rcu_expedited();
+		else
+			synchronize_rcu();
 		rcu_sync_func(&rsp->cb_head);
 		/* Not really needed, wait_event() would see GP_PASSED. */
-		return;
+		return true;
 	}
 
+	if (gp_state >= GP_PASSED)
+		return false;
+
 	wait_event(rsp->gp_wait, READ_ONCE(rsp->gp_state) >= GP_PASSED);
+	return true;
 }
 
 /**
@@ -156,6 +195,7 @@ void rcu_sync_exit(struct rcu_sync *rsp)
 	spin_lock_irq(&rsp->rss_lock);
 	WARN_ON_ONCE(rsp->gp_count == 0);
 	if (!--rsp->gp_count) {
+		rsp->gp_linger_left = rsp->gp_linger;
 		if (rsp->gp_state == GP_PASSED) {
 			WRITE_ONCE(rsp->gp_state, GP_EXIT);
 			rcu_sync_call(rsp);
@@ -178,6 +218,7 @@ void rcu_sync_dtor(struct rcu_sync *rsp)
 
 	spin_lock_irq(&rsp->rss_lock);
 	WARN_ON_ONCE(rsp->gp_count);
+	rsp->gp_linger_left = 0;
 	if (rsp->gp_state == GP_REPLAY)
 		WRITE_ONCE(rsp->gp_state, GP_EXIT);
 	gp_state = rsp->gp_state;
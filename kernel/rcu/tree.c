@@ -446,6 +446,17 @@ module_param(rcu_divisor, int, 0644);
 static long rcu_resched_ns = 3 * NSEC_PER_MSEC;
 module_param(rcu_resched_ns, long, 0644);
 
+/*
+ * Size each softirq rcu_do_batch() invocation from the measured
+ * per-callback cost so that a batch roughly fills rcu_resched_ns, and
+ * invoke at the flood limit while the callback shrinker has recently
+ * reported memory pressure.
+ */
+static bool rcu_adaptive_blimit;
+module_param(rcu_adaptive_blimit, bool, 0644);
+#define RCU_CB_PRESSURE_JIFFIES HZ // Stay accelerated this long after a shrink.
+static unsigned long rcu_cb_pressure_end = INITIAL_JIFFIES;
+
 /*
  * How long the grace period must be before we start recruiting
  * quiescent-state help from rcu_note_context_switch().
@@ -2483,14 +2494,46 @@ static bool rcu_do_batch_check_time(long count, long tlimit,
 	       local_clock() >= tlimit;
 }
 
+/*
+ * Compute the adaptive batch limit: enough callbacks to fill the time
+ * limit at this CPU's measured per-callback cost, or the flood limit
+ * while under memory pressure.  Never returns less than @bl.
+ */
+static long rcu_do_batch_adapt(struct rcu_data *rdp, long bl, long rrn,
+			       bool pressure)
+{
+	unsigned long cost = READ_ONCE(rdp->cb_cost_ns);
+	long abl = bl;
+
+	if (pressure)
+		abl = DEFAULT_MAX_RCU_BLIMIT;
+	else if (cost)
+		abl = clamp_t(long, rrn / cost, blimit, DEFAULT_MAX_RCU_BLIMIT);
+	trace_rcu_batch_adapt(rcu_state.name, cost, bl, abl, pressure);
+	return max(bl, abl);
+}
+
+/* Fold the per-callback cost of the batch just invoked into the average. */
+static void rcu_do_batch_update_cost(struct rcu_data *rdp, long count, u64 ns)
+{
+	unsigned long cost = READ_ONCE(rdp->cb_cost_ns);
+	unsigned long sample = max_t(u64, div_u64(ns, count), 1);
+
+	WRITE_ONCE(rdp->cb_cost_ns, cost ? cost - cost / 8 + sample / 8 : sample);
+}
+
 /*
  * Invoke any RCU callbacks that have made it to the end of their grace
- * period.  Throttle as specified by rdp->blimit.
+ * period.  Throttle as specified by rdp->blimit, or adaptively when
+ * rcutree.rcu_adaptive_blimit is set.
  */
 static void rcu_do_batch(struct rcu_data *rdp)
 {
+	bool adaptive;
+	bool pressure = false;
 	long bl;
 	long count = 0;
+	u64 cb_start = 0;
 	int div;
 	bool __maybe_unused empty;
 	unsigned long flags;
@@ -2499,6 +2542,7 @@ static void rcu_do_batch(struct rcu_data *rdp)
 	long pending;
 	struct rcu_cblist rcl = RCU_CBLIST_INITIALIZER(rcl);
 	struct rcu_head *rhp;
+	long rrn;
 	long tlimit = 0;
 
 	/* If no callbacks are ready, just return. */
@@ -2529,12 +2573,19 @@ static void rcu_do_batch(struct rcu_data *rdp)
 	div = READ_ONCE(rcu_divisor);
 	div = div < 0 ? 7 : div > sizeof(long) * 8 - 2 ? sizeof(long) * 8 - 2 : div;
 	bl = max(rdp->blimit, pending >> div);
-	if ((in_serving_softirq() || rdp->rcu_cpu_kthread_status == RCU_KTHREAD_RUNNING) &&
+	rrn = READ_ONCE(rcu_resched_ns);
+	rrn = rrn < NSEC_PER_MSEC ? NSEC_PER_MSEC : rrn > NSEC_PER_SEC ? NSEC_PER_SEC : rrn;
+	adaptive = READ_ONCE(rcu_adaptive_blimit) && in_serving_softirq();
+	if (adaptive) {
+		pressure = time_before(jiffies, READ_ONCE(rcu_cb_pressure_end));
+		bl = rcu_do_batch_adapt(rdp, bl, rrn, pressure);
+	}
+	/* Under memory pressure, only the flood limit bounds the batch. */
+	if (!pressure &&
+	    (in_serving_softirq() || rdp->rcu_cpu_kthread_status == RCU_KTHREAD_RUNNING) &&
 	    (IS_ENABLED(CONFIG_RCU_DOUBLE_CHECK_CB_TIME) || unlikely(bl > 100))) {
 		const long npj = NSEC_PER_SEC / HZ;
-		long rrn = READ_ONCE(rcu_resched_ns);
 
-		rrn = rrn < NSEC_PER_MSEC ? NSEC_PER_MSEC : rrn > NSEC_PER_SEC ? NSEC_PER_SEC : rrn;
 		tlimit = local_clock() + rrn;
 		jlimit = jiffies + (rrn + npj + 1) / npj;
 		jlimit_check = true;
@@ -2550,6 +2601,8 @@ static void rcu_do_batch(struct rcu_data *rdp)
 
 	/* Invoke callbacks. */
 	tick_dep_set_task(current, TICK_DEP_BIT_RCU);
+	if (adaptive)
+		cb_start = local_clock();
 	rhp = rcu_cblist_dequeue(&rcl);
 
 	for (; rhp; rhp = rcu_cblist_dequeue(&rcl)) {
@@ -2598,6 +2651,9 @@ static void rcu_do_batch(struct rcu_data *rdp)
 		}
 	}
 
+	if (adaptive && count)
+		rcu_do_batch_update_cost(rdp, count, local_clock() - cb_start);
+
 	rcu_nocb_lock_irqsave(rdp, flags);
 	rdp->n_cbs_invoked += count;
 	trace_rcu_batch_end(rcu_state.name, count, !!rcl.head, need_resched(),
@@ -3985,6 +4041,41 @@ kfree_rcu_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
 	return freed == 0 ? SHRINK_STOP : freed;
 }
 
+/*
+ * Report ready-to-invoke callbacks to the shrinker so that memory
+ * pressure accelerates rcu_do_batch() when adaptive batching is enabled.
+ */
+static unsigned long
+rcu_cb_shrink_count(struct shrinker *shrink, struct shrink_control *sc)
+{
+	int cpu;
+	unsigned long count = 0;
+
+	if (!READ_ONCE(rcu_adaptive_blimit))
+		return 0;
+
+	for_each_online_cpu(cpu) {
+		struct rcu_data *rdp = per_cpu_ptr(&rcu_data, cpu);
+
+		count += rcu_segcblist_get_seglen(&rdp->cblist, RCU_DONE_TAIL);
+	}
+
+	return count ? count : SHRINK_EMPTY;
+}
+
+static unsigned long
+rcu_cb_shrink_scan(struct shrinker *shrink, struct shrink_control *sc)
+{
+	/*
+	 * Callbacks cannot be invoked from here, so just lift the batch
+	 * limits for the next rcu_do_batch() invocations on all CPUs.
+	 * Report nothing freed rather than SHRINK_STOP so that the scan
+	 * is consumed instead of being deferred to the next reclaim pass.
+	 */
+	WRITE_ONCE(rcu_cb_pressure_end, jiffies + RCU_CB_PRESSURE_JIFFIES);
+	return 0;
+}
+
 void __init kfree_rcu_scheduler_running(void)
 {
 	int cpu;
@@ -5661,6 +5752,7 @@ static void __init kfree_rcu_batch_init(void)
 	int cpu;
 	int i, j;
 	struct shrinker *kfree_rcu_shrinker;
+	struct shrinker *rcu_cb_shrinker;
 
 	/* Clamp it to [0:100] seconds interval. */
 	if (rcu_delay_page_cache_fill_msec < 0 ||
@@ -5703,6 +5795,17 @@ static void __init kfree_rcu_batch_init(void)
 	kfree_rcu_shrinker->scan_objects = kfree_rcu_shrink_scan;
 
 	shrinker_register(kfree_rcu_shrinker);
+
+	rcu_cb_shrinker = shrinker_alloc(0, "rcu-cb");
+	if (!rcu_cb_shrinker) {
+		pr_err("Failed to allocate RCU callback shrinker!\n");
+		return;
+	}
+
+	rcu_cb_shrinker->count_objects = rcu_cb_shrink_count;
+	rcu_cb_shrinker->scan_objects = rcu_cb_shrink_scan;
+
+	shrinker_register(rcu_cb_shrinker);
 }
 
 void __init rcu_init(void)
@@ -204,6 +204,7 @@ struct rcu_data {
 	unsigned long	n_force_qs_snap;
 					/* did other CPU force QS recently? */
 	long		blimit;		/* Upper limit on a processed batch */
+	unsigned long	cb_cost_ns;	/* Average ns per invoked callback. */
 
 	/* 3) dynticks interface. */
 	int  watching_snap;		/* Per-GP tracking for dynticks. */
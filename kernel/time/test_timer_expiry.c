@@ -0,0 +1,214 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Timer wheel expiry benchmark
+ *
+ * Arms a large number of timer_list timers on one CPU, spread over a few
+ * jiffies, and reports how long it took until all of them expired together
+ * with the timer wheel expiry statistics accumulated meanwhile.
+ *
+ * One in eight timers is armed far enough ahead to be queued in wheel
+ * level 1, the others are armed later for the same expiry times and are
+ * queued in level 0. Every callback checks that the timers expire in the
+ * order the wheel defines: clk after clk, and within a clk the timers of
+ * the higher level first.
+ *
+ * The test runs at module load time:
+ *   modprobe test_timer_expiry nr_timers=200000 spread=4 cpu=1 rounds=5
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/atomic.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/jiffies.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/sched.h>
+#include <linux/timer.h>
+#include <linux/vmalloc.h>
+
+#include "tick-internal.h"
+
+/* Mirrors LVL_CLK_SHIFT of the timer wheel */
+#define EXPIRY_LVL_CLK_SHIFT	3
+/* How far ahead level 1 and level 0 timers are armed */
+#define EXPIRY_LVL1_DELTA	100
+#define EXPIRY_LVL0_DELTA	40
+#define EXPIRY_MAX_SPREAD	16
+
+static unsigned int nr_timers = 100000;
+module_param(nr_timers, uint, 0444);
+MODULE_PARM_DESC(nr_timers, "Number of timers armed per round");
+
+static unsigned int spread = 8;
+module_param(spread, uint, 0444);
+MODULE_PARM_DESC(spread, "Number of jiffies the expiry times are spread over (at most 16)");
+
+static unsigned int cpu;
+module_param(cpu, uint, 0444);
+MODULE_PARM_DESC(cpu, "CPU to arm the timers on");
+
+static unsigned int rounds = 3;
+module_param(rounds, uint, 0444);
+MODULE_PARM_DESC(rounds, "Number of measurement rounds");
+
+struct expiry_timer {
+	struct timer_list	timer;
+	unsigned long		bucket_expiry;
+	unsigned int		level;
+};
+
+static struct expiry_timer *timers;
+static atomic_t timers_left;
+static DECLARE_COMPLETION(timers_done);
+
+/* Only touched by the callbacks, which all run on @cpu */
+static unsigned long last_bucket_expiry;
+static unsigned int last_level;
+static unsigned int out_of_order;
+
+static void timer_expiry_fn(struct timer_list *t)
+{
+	struct expiry_timer *et = from_timer(et, t, timer);
+
+	if (time_before(et->bucket_expiry, last_bucket_expiry) ||
+	    (et->bucket_expiry == last_bucket_expiry && et->level > last_level))
+		out_of_order++;
+	last_bucket_expiry = et->bucket_expiry;
+	last_level = et->level;
+
+	if (atomic_dec_and_test(&timers_left))
+		complete(&timers_done);
+}
+
+/* The expiry time rounded up the way the wheel queues it at @level */
+static void timer_expiry_arm(struct expiry_timer *et, unsigned long expires,
+			     unsigned int level)
+{
+	unsigned int shift = level * EXPIRY_LVL_CLK_SHIFT;
+
+	et->bucket_expiry = ((expires >> shift) + 1) << shift;
+	et->level = level;
+	et->timer.expires = expires;
+	add_timer_on(&et->timer, cpu);
+}
+
+static void timer_expiry_reset_stats(void)
+{
+	unsigned int i;
+
+	for (i = 0; !timer_reset_wheel_stats(cpu, i); i++)
+		;
+}
+
+static void timer_expiry_stats(struct timer_wheel_stats *st)
+{
+	struct timer_wheel_stats base;
+	unsigned int i;
+
+	memset(st, 0, sizeof(*st));
+	for (i = 0; !timer_get_wheel_stats(cpu, i, &base); i++) {
+		st->runs += base.runs;
+		st->expired += base.expired;
+		st->upper_level += base.upper_level;
+		st->collect_ns += base.collect_ns;
+		st->max_batch = max(st->max_batch, base.max_batch);
+	}
+}
+
+static int timer_expiry_round(unsigned int round)
+{
+	struct timer_wheel_stats st;
+	unsigned long first;
+	unsigned int i;
+	bool in_time;
+	long delay;
+	u64 start, end;
+
+	reinit_completion(&timers_done);
+	atomic_set(&timers_left, nr_timers);
+	last_bucket_expiry = jiffies;
+	last_level = 0;
+	out_of_order = 0;
+	timer_expiry_reset_stats();
+
+	start = ktime_get_ns();
+	first = jiffies + EXPIRY_LVL1_DELTA;
+	for (i = 0; i < nr_timers; i += 8)
+		timer_expiry_arm(&timers[i], first + (i / 8) % spread, 1);
+
+	delay = first - EXPIRY_LVL0_DELTA - jiffies;
+	if (delay > 0)
+		schedule_timeout_uninterruptible(delay);
+	for (i = 0; i < nr_timers; i++) {
+		if (i % 8)
+			timer_expiry_arm(&timers[i], first + i % spread, 0);
+	}
+	/* Timers armed after their expiry time are queued at the current clk */
+	in_time = time_before(jiffies, first);
+
+	if (!wait_for_completion_timeout(&timers_done,
+					 10 * HZ + EXPIRY_LVL1_DELTA + spread)) {
+		pr_err("round %u: %d timers did not expire\n", round,
+		       atomic_read(&timers_left));
+		for (i = 0; i < nr_timers; i++)
+			timer_delete_sync(&timers[i].timer);
+		return -ETIMEDOUT;
+	}
+	end = ktime_get_ns();
+	timer_expiry_stats(&st);
+
+	pr_info("round %u: %u timers in %llu ns, %lu batches, %lu expired, %lu upper level, %llu ns collecting, max batch %u\n",
+		round, nr_timers, end - start, st.runs, st.expired,
+		st.upper_level, st.collect_ns, st.max_batch);
+
+	if (!in_time) {
+		pr_info("round %u: arming took too long, expiry order not checked\n",
+			round);
+	} else if (out_of_order) {
+		pr_err("round %u: %u timers expired out of order\n", round,
+		       out_of_order);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int __init timer_expiry_test_init(void)
+{
+	unsigned int i;
+	int ret = 0;
+
+	if (!nr_timers || !spread || spread > EXPIRY_MAX_SPREAD ||
+	    cpu >= nr_cpu_ids || !cpu_online(cpu))
+		return -EINVAL;
+
+	timers = vmalloc_array(nr_timers, sizeof(*timers));
+	if (!timers)
+		return -ENOMEM;
+
+	for (i = 0; i < nr_timers; i++)
+		timer_setup(&timers[i].timer, timer_expiry_fn, 0);
+
+	timer_wheel_timing_enable(true);
+	for (i = 0; i < rounds && !ret; i++)
+		ret = timer_expiry_round(i);
+	timer_wheel_timing_enable(false);
+
+	for (i = 0; i < nr_timers; i++)
+		timer_shutdown_sync(&timers[i].timer);
+	vfree(timers);
+
+	return ret;
+}
+
+static void __exit timer_expiry_test_exit(void)
+{
+}
+
+module_init(timer_expiry_test_init);
+module_exit(timer_expiry_test_exit);
+
+MODULE_DESCRIPTION("Timer wheel expiry benchmark");
+MODULE_LICENSE("GPL");
@@ -13,6 +13,31 @@ struct timer_events {
 	u64	global;
 };
 
+/**
+ * struct timer_wheel_stats - Expiry statistics of a timer wheel base
+ * @runs:		Number of expiry batches which were processed
+ * @expired:		Number of expired timers
+ * @upper_level:	Number of expired timers which were queued in a
+ *			wheel level above 0 and thus expired with reduced
+ *			granularity
+ * @collect_ns:		Time spent splicing expired buckets with the
+ *			base lock held, only accounted while enabled with
+ *			timer_wheel_timing_enable()
+ * @max_batch:		Maximum number of timers expired in one batch
+ */
+struct timer_wheel_stats {
+	unsigned long	runs;
+	unsigned long	expired;
+	unsigned long	upper_level;
+	u64		collect_ns;
+	unsigned int	max_batch;
+};
+
+extern void timer_wheel_timing_enable(bool enable);
+extern int timer_reset_wheel_stats(unsigned int cpu, unsigned int index);
+extern int timer_get_wheel_stats(unsigned int cpu, unsigned int index,
+				 struct timer_wheel_stats *stats);
+
 #ifdef CONFIG_GENERIC_CLOCKEVENTS
 
 # define TICK_DO_TIMER_NONE	-1
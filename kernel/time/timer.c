@@ -247,6 +247,7 @@ EXPORT_SYMBOL(jiffies_64);
  * @vectors:		Array of lists; Each array member reflects a bucket
  *			of the timer wheel. The list contains all timers
  *			which are enqueued into a specific bucket.
+ * @stats:		Expiry statistics, reported via /proc/timer_list.
  */
 struct timer_base {
 	raw_spinlock_t		lock;
@@ -263,10 +264,13 @@ struct timer_base {
 	bool			timers_pending;
 	DECLARE_BITMAP(pending_map, WHEEL_SIZE);
 	struct hlist_head	vectors[WHEEL_SIZE];
+	struct timer_wheel_stats stats;
 } ____cacheline_aligned;
 
 static DEFINE_PER_CPU(struct timer_base, timer_bases[NR_BASES]);
 
+static DEFINE_STATIC_KEY_FALSE(timer_wheel_timing);
+
 #ifdef CONFIG_NO_HZ_COMMON
 
 static DEFINE_STATIC_KEY_FALSE(timers_nohz_active);
@@ -1809,7 +1813,8 @@ static void call_timer_fn(struct timer_list *timer,
 	}
 }
 
-static void expire_timers(struct timer_base *base, struct hlist_head *head)
+static unsigned int expire_timers(struct timer_base *base,
+				  struct hlist_head *head)
 {
 	/*
 	 * This value is required only for tracing. base->clk was
@@ -1817,6 +1822,7 @@ static void expire_timers(struct timer_base *base, struct hlist_head *head)
 	 * is related to the old base->clk value.
 	 */
 	unsigned long baseclk = base->clk - 1;
+	unsigned int count = 0;
 
 	while (!hlist_empty(head)) {
 		struct timer_list *timer;
@@ -1835,6 +1841,10 @@ static void expire_timers(struct timer_base *base, struct hlist_head *head)
 			continue;
 		}
 
+		count++;
+		if (timer_get_idx(timer) >= LVL_SIZE)
+			base->stats.upper_level++;
+
 		if (timer->flags & TIMER_IRQSAFE) {
 			raw_spin_unlock(&base->lock);
 			call_timer_fn(timer, fn, baseclk);
@@ -1848,6 +1858,35 @@ static void expire_timers(struct timer_base *base, struct hlist_head *head)
 			timer_sync_wait_running(base);
 		}
 	}
+
+	return count;
+}
+
+/*
+ * Move the timers of bucket @vec behind the ones already collected in
+ * @head, so the buckets expire in the order they were spliced. @tail
+ * points to a timer already on @head, which avoids rewalking the list:
+ * every timer is walked at most once per batch, and only when several
+ * buckets are collected into the same batch.
+ */
+static void splice_expired_bucket(struct hlist_head *vec,
+				  struct hlist_head *head,
+				  struct hlist_node **tail)
+{
+	struct hlist_node *last;
+
+	if (hlist_empty(head)) {
+		hlist_move_list(vec, head);
+		*tail = head->first;
+		return;
+	}
+
+	for (last = *tail; last->next; last = last->next)
+		;
+	last->next = vec->first;
+	vec->first->pprev = &last->next;
+	INIT_HLIST_HEAD(vec);
+	*tail = last;
 }
 
 static int collect_expired_timers(struct timer_base *base,
@@ -2389,6 +2428,11 @@ void timer_clear_idle(void)
 static inline void __run_timers(struct timer_base *base)
 {
 	struct hlist_head heads[LVL_DEPTH];
+	struct hlist_head batch;
+	struct hlist_node *tail = NULL;
+	unsigned int expired;
+	bool timing;
+	u64 start = 0;
 	int levels;
 
 	lockdep_assert_held(&base->lock);
@@ -2398,28 +2442,121 @@ static inline void __run_timers(struct timer_base *base)
 
 	while (time_after_eq(jiffies, base->clk) &&
 	       time_after_eq(jiffies, base->next_expiry)) {
-		levels = collect_expired_timers(base, heads);
-		/*
-		 * The two possible reasons for not finding any expired
-		 * timer at this clk are that all matching timers have been
-		 * dequeued or no timer has been queued since
-		 * base::next_expiry was set to base::clk +
-		 * NEXT_TIMER_MAX_DELTA.
-		 */
-		WARN_ON_ONCE(!levels && !base->next_expiry_recalc
-			     && base->timers_pending);
+		timing = static_branch_unlikely(&timer_wheel_timing);
+		if (timing)
+			start = local_clock();
+		INIT_HLIST_HEAD(&batch);
+
 		/*
-		 * While executing timers, base->clk is set 1 offset ahead of
-		 * jiffies to avoid endless requeuing to current jiffies.
+		 * Splice every bucket which expired up to jiffies before
+		 * running any callback, so that catching up on several clks
+		 * (e.g. after a delayed softirq) is expired as one batch.
 		 */
-		base->clk++;
-		timer_recalc_next_expiry(base);
+		do {
+			levels = collect_expired_timers(base, heads);
+			/*
+			 * The two possible reasons for not finding any expired
+			 * timer at this clk are that all matching timers have
+			 * been dequeued or no timer has been queued since
+			 * base::next_expiry was set to base::clk +
+			 * NEXT_TIMER_MAX_DELTA.
+			 */
+			WARN_ON_ONCE(!levels && !base->next_expiry_recalc
+				     && base->timers_pending);
+			/*
+			 * While executing timers, base->clk is set 1 offset
+			 * ahead of jiffies to avoid endless requeuing to
+			 * current jiffies.
+			 */
+			base->clk++;
+			timer_recalc_next_expiry(base);
+			/*
+			 * Keep the order of expiring one clk at a time: clk
+			 * after clk, and the highest level first within a clk.
+			 */
+			while (levels--)
+				splice_expired_bucket(heads + levels, &batch, &tail);
+		} while (time_after_eq(jiffies, base->clk) &&
+			 time_after_eq(jiffies, base->next_expiry));
+
+		if (timing)
+			base->stats.collect_ns += local_clock() - start;
 
-		while (levels--)
-			expire_timers(base, heads + levels);
+		expired = expire_timers(base, &batch);
+
+		base->stats.runs++;
+		base->stats.expired += expired;
+		base->stats.max_batch = max(base->stats.max_batch, expired);
 	}
 }
 
+/**
+ * timer_wheel_timing_enable - Enable or disable timing of the expiry batches
+ * @enable:	true to take a reference on the timing, false to drop one
+ *
+ * Timing the collection of expired buckets costs two local_clock() calls
+ * per batch, so timer_wheel_stats::collect_ns only accumulates while at
+ * least one user has enabled it.
+ */
+void timer_wheel_timing_enable(bool enable)
+{
+	if (enable)
+		static_branch_inc(&timer_wheel_timing);
+	else
+		static_branch_dec(&timer_wheel_timing);
+}
+EXPORT_SYMBOL_GPL(timer_wheel_timing_enable);
+
+/**
+ * timer_reset_wheel_stats - Clear the expiry statistics of a timer base
+ * @cpu:	CPU the timer base belongs to
+ * @index:	Index of the timer base (BASE_LOCAL, BASE_GLOBAL, BASE_DEF)
+ *
+ * Return: 0 on success, -ENOENT if @index is not a valid timer base.
+ */
+int timer_reset_wheel_stats(unsigned int cpu, unsigned int index)
+{
+	struct timer_base *base;
+	unsigned long flags;
+
+	if (index >= NR_BASES)
+		return -ENOENT;
+
+	base = per_cpu_ptr(&timer_bases[index], cpu);
+	raw_spin_lock_irqsave(&base->lock, flags);
+	memset(&base->stats, 0, sizeof(base->stats));
+	raw_spin_unlock_irqrestore(&base->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(timer_reset_wheel_stats);
+
+/**
+ * timer_get_wheel_stats - Snapshot the expiry statistics of a timer base
+ * @cpu:	CPU the timer base belongs to
+ * @index:	Index of the timer base (BASE_LOCAL, BASE_GLOBAL, BASE_DEF)
+ * @stats:	Where to store the snapshot
+ *
+ * Return: 0 on success, -ENOENT if @index is not a valid timer base.
+ */
+int timer_get_wheel_stats(unsigned int cpu, unsigned int index,
+			  struct timer_wheel_stats *stats)
+{
+	struct timer_base *base;
+	unsigned long flags;
+
+	if (index >= NR_BASES)
+		return -ENOENT;
+
+	base = per_cpu_ptr(&timer_bases[index], cpu);
+	raw_spin_lock_irqsave(&base->lock, flags);
+	*stats = base->stats;
+	raw_spin_unlock_irqrestore(&base->lock, flags);
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(timer_get_wheel_stats);
+
 static void __run_timer_base(struct timer_base *base)
 {
 	/* Can race against a remote CPU updating next_expiry under the lock */
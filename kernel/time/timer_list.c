@@ -174,6 +174,20 @@ static void print_cpu(struct seq_file *m, int cpu, u64 now)
 
 #undef P
 #undef P_ns
+
+	for (i = 0; ; i++) {
+		struct timer_wheel_stats st;
+
+		if (timer_get_wheel_stats(cpu, i, &st))
+			break;
+		SEQ_printf(m, " timer wheel %d:\n", i);
+		SEQ_printf(m, "  .%-15s: %lu\n", "runs", st.runs);
+		SEQ_printf(m, "  .%-15s: %lu\n", "expired", st.expired);
+		SEQ_printf(m, "  .%-15s: %u\n", "max_batch", st.max_batch);
+		SEQ_printf(m, "  .%-15s: %lu\n", "upper_level", st.upper_level);
+		SEQ_printf(m, "  .%-15s: %Lu nsecs\n", "collect_ns",
+			   (unsigned long long)st.collect_ns);
+	}
 	SEQ_printf(m, "\n");
 }
 
@@ -260,7 +274,7 @@ static void timer_list_show_tickdevices_header(struct seq_file *m)
 
 static inline void timer_list_header(struct seq_file *m, u64 now)
 {
-	SEQ_printf(m, "Timer List Version: v0.10\n");
+	SEQ_printf(m, "Timer List Version: v0.11\n");
 	SEQ_printf(m, "HRTIMER_MAX_CLOCK_BASES: %d\n", HRTIMER_MAX_CLOCK_BASES);
 	SEQ_printf(m, "now at %Ld nsecs\n", (unsigned long long)now);
 	SEQ_printf(m, "\n");
@@ -16,6 +16,89 @@ EXPORT_SYMBOL(_shared_alloc_tag);
 DEFINE_STATIC_KEY_MAYBE(CONFIG_MEM_ALLOC_PROFILING_ENABLED_BY_DEFAULT,
 			mem_alloc_profiling_key);
 
+DEFINE_STATIC_KEY_FALSE(mem_alloc_profiling_sampling);
+
+/* Sample about one in 2^alloc_tag_sample_shift allocations */
+static unsigned int alloc_tag_sample_shift = 5;
+static unsigned int alloc_tag_sample_shift_max = ALLOC_TAG_SAMPLE_SHIFT_MAX;
+
+/* Allocations left until the next sample */
+DEFINE_PER_CPU(int, alloc_tag_sample_left);
+static DEFINE_PER_CPU(u32, alloc_tag_sample_rnd);
+
+/* Whether profiling may be switched at runtime, set by alloc_tag_init() */
+static bool mem_profiling_switchable __ro_after_init;
+
+/*
+ * Called when the countdown to the next sample ran out: returns the shift to
+ * account the current allocation with and draws the next gap, uniformly from
+ * [1, 2 * 2^shift - 1] so that its mean is 2^shift.
+ */
+unsigned int alloc_tag_sample_reset(void)
+{
+	unsigned int shift = READ_ONCE(alloc_tag_sample_shift);
+	u32 rnd;
+
+	/* xorshift32, a weak but cheap and allocation free generator */
+	preempt_disable();
+	rnd = __this_cpu_read(alloc_tag_sample_rnd) ?: smp_processor_id() + 1;
+	rnd ^= rnd << 13;
+	rnd ^= rnd >> 17;
+	rnd ^= rnd << 5;
+	__this_cpu_write(alloc_tag_sample_rnd, rnd);
+	__this_cpu_write(alloc_tag_sample_left, 1 + rnd % ((2U << shift) - 1));
+	preempt_enable();
+
+	return shift;
+}
+
+enum alloc_tag_mode alloc_tag_get_mode(void)
+{
+	if (!mem_alloc_profiling_enabled())
+		return ALLOC_TAG_MODE_OFF;
+	if (static_branch_unlikely(&mem_alloc_profiling_sampling))
+		return ALLOC_TAG_MODE_SAMPLED;
+	return ALLOC_TAG_MODE_FULL;
+}
+EXPORT_SYMBOL_GPL(alloc_tag_get_mode);
+
+/**
+ * alloc_tag_set_mode - switch allocation profiling at runtime
+ * @mode: profiling off, accounting every allocation, or sampling
+ *
+ * Does the same as writing the vm.mem_profiling and vm.mem_profiling_sampling
+ * sysctls.  Allocations made in one mode and freed in another are accounted
+ * like with the sysctls, so callers should switch while they hold no tagged
+ * memory of their own.
+ *
+ * Returns -EPERM if profiling cannot be switched at runtime.
+ */
+int alloc_tag_set_mode(enum alloc_tag_mode mode)
+{
+	if (!mem_profiling_switchable)
+		return -EPERM;
+
+	switch (mode) {
+	case ALLOC_TAG_MODE_OFF:
+		static_branch_disable(&mem_alloc_profiling_key);
+		static_branch_disable(&mem_alloc_profiling_sampling);
+		break;
+	case ALLOC_TAG_MODE_FULL:
+		static_branch_disable(&mem_alloc_profiling_sampling);
+		static_branch_enable(&mem_alloc_profiling_key);
+		break;
+	case ALLOC_TAG_MODE_SAMPLED:
+		static_branch_enable(&mem_alloc_profiling_sampling);
+		static_branch_enable(&mem_alloc_profiling_key);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL_GPL(alloc_tag_set_mode);
+
 struct allocinfo_private {
 	struct codetag_iterator iter;
 	bool print_header;
@@ -67,6 +150,9 @@ static void print_allocinfo_header(struct seq_buf *buf)
 {
 	/* Output format version, so we can change it. */
 	seq_buf_printf(buf, "allocinfo - version: 1.0\n");
+	if (static_branch_unlikely(&mem_alloc_profiling_sampling))
+		seq_buf_printf(buf, "# sampling 1 in %u slab and percpu allocations, scaled\n",
+			       1U << READ_ONCE(alloc_tag_sample_shift));
 	seq_buf_printf(buf, "#     <size>  <calls> <tag info>\n");
 }
 
@@ -239,12 +325,29 @@ static struct ctl_table memory_allocation_profiling_sysctls[] = {
 #endif
 		.proc_handler	= proc_do_static_key,
 	},
+	{
+		.procname	= "mem_profiling_sampling",
+		.data		= &mem_alloc_profiling_sampling.key,
+		.mode		= 0644,
+		.proc_handler	= proc_do_static_key,
+	},
+	{
+		.procname	= "mem_profiling_sample_shift",
+		.data		= &alloc_tag_sample_shift,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_douintvec_minmax,
+		.extra1		= SYSCTL_ZERO,
+		.extra2		= &alloc_tag_sample_shift_max,
+	},
 };
 
 static void __init sysctl_init(void)
 {
-	if (!mem_profiling_support)
+	if (!mem_profiling_support) {
 		memory_allocation_profiling_sysctls[0].mode = 0444;
+		memory_allocation_profiling_sysctls[1].mode = 0444;
+	}
 
 	register_sysctl_init("vm", memory_allocation_profiling_sysctls);
 }
@@ -264,6 +367,9 @@ static int __init alloc_tag_init(void)
 	if (IS_ERR(alloc_tag_cttype))
 		return PTR_ERR(alloc_tag_cttype);
 
+	mem_profiling_switchable = mem_profiling_support &&
+				   !IS_ENABLED(CONFIG_MEM_ALLOC_PROFILING_DEBUG);
+
 	sysctl_init();
 	procfs_init();
 
@@ -1,11 +1,13 @@
 // SPDX-License-Identifier: GPL-2.0+
 /*
- * Test cases csum_partial, csum_fold, ip_fast_csum, csum_ipv6_magic
+ * Test cases csum_partial, csum_fold, ip_fast_csum, csum_ipv6_magic,
+ * csum_partial_copy_nocheck
  */
 
 #include <kunit/test.h>
 #include <asm/checksum.h>
 #include <net/ip6_checksum.h>
+#include <linux/vmalloc.h>
 
 #define MAX_LEN 512
 #define MAX_ALIGN 64
@@ -447,6 +449,7 @@ static const u16 expected_fast_csum[] = {
 };
 
 static u8 tmp_buf[TEST_BUFLEN];
+static u8 tmp_dst[TEST_BUFLEN];
 
 #define full_csum(buff, len, sum) csum_fold(csum_partial(buff, len, sum))
 
@@ -619,12 +622,72 @@ static void test_csum_ipv6_magic(struct kunit *test)
 	}
 }
 
+/*
+ * The copying variant must produce the same (folded) sum as csum_partial()
+ * and an exact copy, for any source and destination alignment.
+ */
+static void test_csum_partial_copy(struct kunit *test)
+{
+	int len, align;
+	__wsum sum;
+
+	assert_setup_correct(test);
+	memcpy(tmp_buf, random_buf, MAX_LEN);
+	memcpy(&tmp_buf[MAX_LEN], random_buf, MAX_ALIGN);
+	for (align = 0; align < MAX_ALIGN; ++align) {
+		for (len = 0; len <= MAX_LEN - align; ++len) {
+			memset(tmp_dst, 0, TEST_BUFLEN);
+			sum = csum_partial_copy_nocheck(&tmp_buf[align],
+							&tmp_dst[MAX_ALIGN - align],
+							len);
+			CHECK_EQ(csum_fold(sum),
+				 full_csum(&tmp_buf[align], len, 0));
+			KUNIT_ASSERT_EQ(test, memcmp(&tmp_dst[MAX_ALIGN - align],
+						     &tmp_buf[align], len), 0);
+		}
+	}
+}
+
+/*
+ * Large all ones buffers, so that vectorized implementations run for many
+ * iterations with every lane carrying.
+ */
+static void test_csum_partial_copy_large(struct kunit *test)
+{
+	static const int lens[] = { 4095, 4096, 65535, 65536, 131071,
+				    131072, 131075, 262144, 1 << 20 };
+	u8 *src, *dst;
+	__wsum sum;
+	int i;
+
+	src = vmalloc(lens[ARRAY_SIZE(lens) - 1] + 1);
+	dst = vmalloc(lens[ARRAY_SIZE(lens) - 1] + 1);
+	if (!src || !dst) {
+		vfree(src);
+		vfree(dst);
+		kunit_skip(test, "no memory");
+	}
+
+	memset(src, 0xff, lens[ARRAY_SIZE(lens) - 1] + 1);
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		sum = csum_partial_copy_nocheck(src + (i & 1), dst, lens[i]);
+		KUNIT_EXPECT_EQ(test, (__force u16)csum_fold(sum),
+				(__force u16)full_csum(src + (i & 1), lens[i], 0));
+		KUNIT_EXPECT_EQ(test, memcmp(dst, src + (i & 1), lens[i]), 0);
+	}
+
+	vfree(src);
+	vfree(dst);
+}
+
 static struct kunit_case __refdata checksum_test_cases[] = {
 	KUNIT_CASE(test_csum_fixed_random_inputs),
 	KUNIT_CASE(test_csum_all_carry_inputs),
 	KUNIT_CASE(test_csum_no_carry_inputs),
 	KUNIT_CASE(test_ip_fast_csum),
 	KUNIT_CASE(test_csum_ipv6_magic),
+	KUNIT_CASE(test_csum_partial_copy),
+	KUNIT_CASE(test_csum_partial_copy_large),
 	{}
 };
 
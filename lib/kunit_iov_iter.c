@@ -13,6 +13,8 @@
 #include <linux/uio.h>
 #include <linux/bvec.h>
 #include <linux/folio_queue.h>
+#include <linux/skbuff.h>
+#include <net/checksum.h>
 #include <kunit/test.h>
 
 MODULE_DESCRIPTION("iov_iter testing");
@@ -366,6 +368,100 @@ static void __init iov_kunit_copy_from_bvec(struct kunit *test)
 	KUNIT_SUCCEED(test);
 }
 
+/*
+ * Copy and checksum the content of an iterator into scratch and check both
+ * against a plain copy_from_iter() of the same ranges.
+ */
+static void __init iov_kunit_check_csum_copy(struct kunit *test,
+					     struct iov_iter *iter,
+					     u8 *scratch, u8 *expect,
+					     size_t bufsize)
+{
+	struct iov_iter copy = *iter;
+	size_t size = iter->count;
+	__wsum csum = 0;
+	int i;
+
+	KUNIT_ASSERT_LE(test, size, bufsize);
+	KUNIT_ASSERT_EQ(test, copy_from_iter(expect, size, &copy), size);
+
+	KUNIT_ASSERT_TRUE(test, csum_and_copy_from_iter_full(scratch, size,
+							     &csum, iter));
+	KUNIT_EXPECT_EQ(test, iter->count, 0);
+	KUNIT_EXPECT_EQ(test, (__force u16)csum_fold(csum),
+			(__force u16)csum_fold(csum_partial(expect, size, 0)));
+
+	for (i = 0; i < size; i++) {
+		KUNIT_EXPECT_EQ_MSG(test, scratch[i], expect[i], "at i=%x", i);
+		if (scratch[i] != expect[i])
+			return;
+	}
+
+	KUNIT_SUCCEED(test);
+}
+
+/*
+ * Test checksumming while copying from a ITER_KVEC-type iterator.
+ */
+static void __init iov_kunit_csum_copy_from_kvec(struct kunit *test)
+{
+	struct iov_iter iter;
+	struct page **spages, **bpages, **epages;
+	struct kvec kvec[8];
+	u8 *scratch, *buffer, *expect;
+	size_t bufsize, npages;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_NET))
+		kunit_skip(test, "csum_and_copy_from_iter_full() needs CONFIG_NET");
+
+	bufsize = 0x100000;
+	npages = bufsize / PAGE_SIZE;
+
+	buffer = iov_kunit_create_buffer(test, &bpages, npages);
+	for (i = 0; i < bufsize; i++)
+		buffer[i] = pattern(i * 7 + (i >> 9));
+
+	scratch = iov_kunit_create_buffer(test, &spages, npages);
+	memset(scratch, 0, bufsize);
+	expect = iov_kunit_create_buffer(test, &epages, npages);
+
+	iov_kunit_load_kvec(test, &iter, WRITE, kvec, ARRAY_SIZE(kvec),
+			    buffer, bufsize, kvec_test_ranges);
+	iov_kunit_check_csum_copy(test, &iter, scratch, expect, bufsize);
+}
+
+/*
+ * Test checksumming while copying from a ITER_BVEC-type iterator.
+ */
+static void __init iov_kunit_csum_copy_from_bvec(struct kunit *test)
+{
+	struct iov_iter iter;
+	struct bio_vec bvec[8];
+	struct page **spages, **bpages, **epages;
+	u8 *scratch, *buffer, *expect;
+	size_t bufsize, npages;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_NET))
+		kunit_skip(test, "csum_and_copy_from_iter_full() needs CONFIG_NET");
+
+	bufsize = 0x100000;
+	npages = bufsize / PAGE_SIZE;
+
+	buffer = iov_kunit_create_buffer(test, &bpages, npages);
+	for (i = 0; i < bufsize; i++)
+		buffer[i] = pattern(i * 7 + (i >> 9));
+
+	scratch = iov_kunit_create_buffer(test, &spages, npages);
+	memset(scratch, 0, bufsize);
+	expect = iov_kunit_create_buffer(test, &epages, npages);
+
+	iov_kunit_load_bvec(test, &iter, WRITE, bvec, ARRAY_SIZE(bvec),
+			    bpages, npages, bufsize, bvec_test_ranges);
+	iov_kunit_check_csum_copy(test, &iter, scratch, expect, bufsize);
+}
+
 static void iov_kunit_destroy_folioq(void *data)
 {
 	struct folio_queue *folioq, *next;
@@ -1017,6 +1113,8 @@ static struct kunit_case __refdata iov_kunit_cases[] = {
 	KUNIT_CASE(iov_kunit_copy_from_kvec),
 	KUNIT_CASE(iov_kunit_copy_to_bvec),
 	KUNIT_CASE(iov_kunit_copy_from_bvec),
+	KUNIT_CASE(iov_kunit_csum_copy_from_kvec),
+	KUNIT_CASE(iov_kunit_csum_copy_from_bvec),
 	KUNIT_CASE(iov_kunit_copy_to_folioq),
 	KUNIT_CASE(iov_kunit_copy_from_folioq),
 	KUNIT_CASE(iov_kunit_copy_to_xarray),
@@ -12,6 +12,7 @@
  */
 
 #include <linux/atomic.h>
+#include <linux/completion.h>
 #include <linux/kernel.h>
 #include <linux/init.h>
 #include <linux/log2.h>
@@ -226,10 +227,10 @@ static struct bucket_table *rhashtable_last_table(struct rhashtable *ht,
 }
 
 static int rhashtable_rehash_one(struct rhashtable *ht,
+				 struct bucket_table *old_tbl,
 				 struct rhash_lock_head __rcu **bkt,
 				 unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl = rhashtable_last_table(ht, old_tbl);
 	int err = -EAGAIN;
 	struct rhash_head *head, *next, *entry;
@@ -278,9 +279,9 @@ static int rhashtable_rehash_one(struct rhashtable *ht,
 }
 
 static int rhashtable_rehash_chain(struct rhashtable *ht,
+				    struct bucket_table *old_tbl,
 				    unsigned int old_hash)
 {
-	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct rhash_lock_head __rcu **bkt = rht_bucket_var(old_tbl, old_hash);
 	unsigned long flags;
 	int err;
@@ -289,7 +290,7 @@ static int rhashtable_rehash_chain(struct rhashtable *ht,
 		return 0;
 	flags = rht_lock(old_tbl, bkt);
 
-	while (!(err = rhashtable_rehash_one(ht, bkt, old_hash)))
+	while (!(err = rhashtable_rehash_one(ht, old_tbl, bkt, old_hash)))
 		;
 
 	if (err == -ENOENT)
@@ -316,24 +317,159 @@ static int rhashtable_rehash_attach(struct rhashtable *ht,
 	return 0;
 }
 
+/*
+ * Large tables are rehashed in chunks of buckets by several workers at once.
+ * Each old bucket is moved under its own bucket lock, so chunks can be moved
+ * in any order and concurrently with each other, just as a single rehash
+ * runs concurrently with insertions and removals.  The worker holding
+ * ht->mutex takes part itself and waits for the helpers before the new
+ * table is published.
+ */
+#define RHT_REHASH_CHUNK	1024U
+#define RHT_REHASH_PARALLEL_MIN	(16 * RHT_REHASH_CHUNK)
+#define RHT_REHASH_MAX_HELPERS	8U
+
+struct rhashtable_rehash_work {
+	struct work_struct		work;
+	struct rhashtable_rehash_ctx	*ctx;
+};
+
+struct rhashtable_rehash_ctx {
+	struct rhashtable		*ht;
+	struct bucket_table		*old_tbl;
+	atomic_t			next_chunk;
+	atomic_t			pending;
+	int				err;
+	struct completion		done;
+	struct rhashtable_rehash_work	helper[];
+};
+
+static int rhashtable_rehash_chunks(struct rhashtable_rehash_ctx *ctx)
+{
+	unsigned int size = ctx->old_tbl->size;
+	unsigned int chunk, old_hash, end;
+	int err;
+
+	while (!READ_ONCE(ctx->err)) {
+		chunk = atomic_inc_return(&ctx->next_chunk) - 1;
+		if (chunk >= DIV_ROUND_UP(size, RHT_REHASH_CHUNK))
+			break;
+
+		old_hash = chunk * RHT_REHASH_CHUNK;
+		end = min(size, old_hash + RHT_REHASH_CHUNK);
+		for (; old_hash < end; old_hash++) {
+			/* Helpers do not hold ht->mutex, RCU keeps the
+			 * future tables alive for rhashtable_last_table().
+			 */
+			rcu_read_lock();
+			err = rhashtable_rehash_chain(ctx->ht, ctx->old_tbl,
+						      old_hash);
+			rcu_read_unlock();
+			if (err) {
+				cmpxchg(&ctx->err, 0, err);
+				return err;
+			}
+		}
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static void rhashtable_rehash_helper(struct work_struct *work)
+{
+	struct rhashtable_rehash_ctx *ctx =
+		container_of(work, struct rhashtable_rehash_work, work)->ctx;
+
+	rhashtable_rehash_chunks(ctx);
+	if (atomic_dec_and_test(&ctx->pending))
+		complete(&ctx->done);
+}
+
+static int rhashtable_rehash_serial(struct rhashtable *ht,
+				    struct bucket_table *old_tbl)
+{
+	unsigned int old_hash;
+	int err;
+
+	for (old_hash = 0; old_hash < old_tbl->size; old_hash++) {
+		err = rhashtable_rehash_chain(ht, old_tbl, old_hash);
+		if (err)
+			return err;
+		cond_resched();
+	}
+
+	return 0;
+}
+
+static int rhashtable_rehash_parallel(struct rhashtable *ht,
+				      struct bucket_table *old_tbl)
+{
+	struct rhashtable_rehash_ctx *ctx;
+	unsigned int i, helpers;
+	int err;
+
+	if (old_tbl->size < RHT_REHASH_PARALLEL_MIN)
+		return rhashtable_rehash_serial(ht, old_tbl);
+
+	helpers = min(num_online_cpus() - 1, RHT_REHASH_MAX_HELPERS);
+	if (!helpers)
+		return rhashtable_rehash_serial(ht, old_tbl);
+
+	ctx = kzalloc(struct_size(ctx, helper, helpers), GFP_KERNEL);
+	if (!ctx)
+		return rhashtable_rehash_serial(ht, old_tbl);
+
+	ctx->ht = ht;
+	ctx->old_tbl = old_tbl;
+	atomic_set(&ctx->next_chunk, 0);
+	atomic_set(&ctx->pending, helpers + 1);
+	init_completion(&ctx->done);
+
+	for (i = 0; i < helpers; i++) {
+		ctx->helper[i].ctx = ctx;
+		INIT_WORK(&ctx->helper[i].work, rhashtable_rehash_helper);
+		queue_work(system_unbound_wq, &ctx->helper[i].work);
+	}
+
+	rhashtable_rehash_chunks(ctx);
+
+	/* Helpers that have not started yet have nothing left to do */
+	for (i = 0; i < helpers; i++) {
+		if (cancel_work(&ctx->helper[i].work))
+			atomic_dec(&ctx->pending);
+	}
+	if (!atomic_dec_and_test(&ctx->pending))
+		wait_for_completion(&ctx->done);
+
+	err = ctx->err;
+	kfree(ctx);
+
+	return err;
+}
+
 static int rhashtable_rehash_table(struct rhashtable *ht)
 {
 	struct bucket_table *old_tbl = rht_dereference(ht->tbl, ht);
 	struct bucket_table *new_tbl;
 	struct rhashtable_walker *walker;
-	unsigned int old_hash;
 	int err;
 
 	new_tbl = rht_dereference(old_tbl->future_tbl, ht);
 	if (!new_tbl)
 		return 0;
 
-	for (old_hash = 0; old_hash < old_tbl->size; old_hash++) {
-		err = rhashtable_rehash_chain(ht, old_hash);
-		if (err)
-			return err;
-		cond_resched();
-	}
+	/* Lockless inserts check future_tbl and link the object within one
+	 * RCU read-side section.  Once a grace period has passed, all those
+	 * that missed the new table have finished, and their objects will be
+	 * moved by the walk below.
+	 */
+	if (ht->p.lockless_insert)
+		synchronize_rcu();
+
+	err = rhashtable_rehash_parallel(ht, old_tbl);
+	if (err)
+		return err;
 
 	/* Publish the new table pointer. */
 	rcu_assign_pointer(ht->tbl, new_tbl);
@@ -13,6 +13,15 @@
 #include <linux/types.h>
 #include <linux/export.h>
 #include <linux/sort.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/math.h>
+#include <linux/minmax.h>
+#include <linux/slab.h>
+#include <linux/string.h>
+#include <linux/workqueue.h>
 
 /**
  * is_aligned - is this pointer & size okay for word-wide copying?
@@ -300,3 +309,279 @@ void sort(void *base, size_t num, size_t size,
 	return sort_r(base, num, size, _CMP_WRAPPER, SWAP_WRAPPER, &w);
 }
 EXPORT_SYMBOL(sort);
+
+#define RADIX_BITS	8
+#define RADIX_SIZE	(1U << RADIX_BITS)
+#define RADIX_MASK	(RADIX_SIZE - 1)
+/* Below this many elements heapsort is as fast and needs no memory */
+#define RADIX_MIN	64
+
+struct radix_item {
+	u64 key;
+	size_t idx;
+};
+
+struct radix_wrapper {
+	sort_key_func_t key_func;
+	u64 mask;
+};
+
+static int radix_cmp(const void *a, const void *b, const void *priv)
+{
+	const struct radix_wrapper *w = priv;
+	u64 ka = w->key_func(a) & w->mask, kb = w->key_func(b) & w->mask;
+
+	return ka < kb ? -1 : ka > kb;
+}
+
+/**
+ * sort_radix - sort an array of elements by an integer key
+ * @base: pointer to data to sort
+ * @num: number of elements
+ * @size: size of each element
+ * @key_func: pointer to function returning the key of an element
+ * @key_bits: number of low bits of the keys to sort by, at most 64
+ *
+ * This does a least significant digit radix sort on the keys, 8 bits per
+ * pass, which takes O(n * key_bits / 8) time and calls @key_func only once
+ * per element.  Passes over digits that are the same in all keys are
+ * skipped, so sorting e.g. page offsets of a single file costs a few passes
+ * regardless of @key_bits.  The elements are moved with memcpy() once, at
+ * the end.  Key bits above @key_bits are ignored.
+ *
+ * It needs about num * (size + 32) bytes of memory.  If that cannot be
+ * allocated, or the array is small, this falls back to a heapsort by key.
+ * The relative order of elements with equal keys is therefore undefined.
+ *
+ * Must be called from a context that may sleep.
+ */
+void sort_radix(void *base, size_t num, size_t size,
+		sort_key_func_t key_func, unsigned int key_bits)
+{
+	unsigned int passes = DIV_ROUND_UP(min(key_bits, 64U), RADIX_BITS);
+	struct radix_wrapper w = {
+		.key_func = key_func,
+		.mask = key_bits < 64 ? BIT_ULL(key_bits) - 1 : U64_MAX,
+	};
+	struct radix_item *items = NULL, *src, *dst;
+	size_t (*count)[RADIX_SIZE] = NULL;
+	void *elems = NULL;
+	unsigned int p;
+	size_t i;
+
+	if (num < 2 || !size || !passes)
+		return;
+	if (num < RADIX_MIN)
+		goto fallback;
+
+	might_sleep();
+	items = kvmalloc_array(num, 2 * sizeof(*items), GFP_KERNEL);
+	count = kcalloc(passes, sizeof(*count), GFP_KERNEL);
+	elems = kvmalloc_array(num, size, GFP_KERNEL);
+	if (!items || !count || !elems)
+		goto free_fallback;
+
+	/* Read every key once and build the histograms of all digits */
+	for (i = 0; i < num; i++) {
+		u64 key = key_func(base + i * size) & w.mask;
+
+		items[i].key = key;
+		items[i].idx = i;
+		for (p = 0; p < passes; p++)
+			count[p][(key >> (p * RADIX_BITS)) & RADIX_MASK]++;
+	}
+
+	src = items;
+	dst = items + num;
+	for (p = 0; p < passes; p++) {
+		unsigned int shift = p * RADIX_BITS, d;
+		size_t *c = count[p], sum = 0, n;
+
+		/* The digit is the same in all keys, nothing would move */
+		if (c[(src[0].key >> shift) & RADIX_MASK] == num)
+			continue;
+
+		for (d = 0; d < RADIX_SIZE; d++) {
+			n = c[d];
+			c[d] = sum;
+			sum += n;
+		}
+		for (i = 0; i < num; i++)
+			dst[c[(src[i].key >> shift) & RADIX_MASK]++] = src[i];
+		swap(src, dst);
+	}
+
+	for (i = 0; i < num; i++)
+		memcpy(elems + i * size, base + src[i].idx * size, size);
+	memcpy(base, elems, num * size);
+
+	kvfree(elems);
+	kfree(count);
+	kvfree(items);
+	return;
+
+free_fallback:
+	kvfree(elems);
+	kfree(count);
+	kvfree(items);
+fallback:
+	sort_r(base, num, size, radix_cmp, NULL, &w);
+}
+EXPORT_SYMBOL(sort_radix);
+
+/* Chunks smaller than this are sorted faster than handed to another CPU */
+#define PARALLEL_MIN	8192
+
+struct parallel_sort {
+	void *base;
+	size_t size;
+	cmp_r_func_t cmp_func;
+	const void *priv;
+	atomic_t pending;
+	struct completion done;
+};
+
+struct parallel_sort_work {
+	struct work_struct work;
+	struct parallel_sort *ps;
+	size_t lo, mid, hi;		/* element indexes */
+	const void *src;		/* NULL to sort [lo, hi) of base */
+	void *dst;
+};
+
+/* Merge the sorted runs [lo, mid) and [mid, hi) of @src into @dst */
+static void parallel_merge(const struct parallel_sort *ps, const void *src,
+			   void *dst, size_t lo, size_t mid, size_t hi)
+{
+	const size_t size = ps->size;
+	const void *a = src + lo * size, *a_end = src + mid * size;
+	const void *b = a_end, *b_end = src + hi * size;
+	void *out = dst + lo * size;
+
+	while (a < a_end && b < b_end) {
+		/* if equal, take 'a' -- keeps the merge itself stable */
+		if (ps->cmp_func(a, b, ps->priv) <= 0) {
+			memcpy(out, a, size);
+			a += size;
+		} else {
+			memcpy(out, b, size);
+			b += size;
+		}
+		out += size;
+	}
+	memcpy(out, a, a_end - a);
+	memcpy(out + (a_end - a), b, b_end - b);
+}
+
+static void parallel_sort_work_fn(struct work_struct *work)
+{
+	struct parallel_sort_work *pw =
+		container_of(work, struct parallel_sort_work, work);
+	struct parallel_sort *ps = pw->ps;
+
+	if (pw->src)
+		parallel_merge(ps, pw->src, pw->dst, pw->lo, pw->mid, pw->hi);
+	else
+		sort_r(ps->base + pw->lo * ps->size, pw->hi - pw->lo, ps->size,
+		       ps->cmp_func, NULL, ps->priv);
+
+	if (atomic_dec_and_test(&ps->pending))
+		complete(&ps->done);
+}
+
+/* Run @n work items and wait for them, the last one on this CPU */
+static void parallel_sort_run(struct parallel_sort *ps,
+			      struct parallel_sort_work *pw, unsigned int n)
+{
+	unsigned int i;
+
+	reinit_completion(&ps->done);
+	atomic_set(&ps->pending, n);
+	for (i = 0; i < n - 1; i++)
+		queue_work(system_unbound_wq, &pw[i].work);
+	parallel_sort_work_fn(&pw[n - 1].work);
+	wait_for_completion(&ps->done);
+}
+
+/**
+ * sort_parallel - sort a large array of elements on several CPUs
+ * @base: pointer to data to sort
+ * @num: number of elements
+ * @size: size of each element
+ * @cmp_func: pointer to comparison function
+ * @priv: third argument passed to comparison function
+ *
+ * The array is split into a power of two number of chunks, at most one per
+ * online CPU, which are sorted concurrently with sort_r().  The chunks are
+ * then merged pairwise through a temporary buffer, all merges of a level
+ * concurrently.  Elements are moved with memcpy(), so there is no swap
+ * function.
+ *
+ * Arrays too small to be worth splitting, or for which the temporary buffer
+ * cannot be allocated, are sorted with sort_r() in the calling context.
+ * Like sort_r(), this is not a stable sort.
+ *
+ * Must be called from a context that may sleep, and @cmp_func must be safe
+ * to call from other threads.
+ */
+void sort_parallel(void *base, size_t num, size_t size,
+		   cmp_r_func_t cmp_func, const void *priv)
+{
+	struct parallel_sort ps = {
+		.base = base,
+		.size = size,
+		.cmp_func = cmp_func,
+		.priv = priv,
+	};
+	struct parallel_sort_work *pw = NULL;
+	unsigned int chunks, n, i;
+	void *tmp = NULL, *src, *dst;
+
+	might_sleep();
+	chunks = min_t(size_t, num_online_cpus(), num / PARALLEL_MIN);
+	if (chunks < 2 || !size)
+		goto serial;
+	chunks = rounddown_pow_of_two(chunks);
+
+	tmp = kvmalloc_array(num, size, GFP_KERNEL);
+	pw = kcalloc(chunks, sizeof(*pw), GFP_KERNEL);
+	if (!tmp || !pw)
+		goto free_serial;
+
+	init_completion(&ps.done);
+	for (i = 0; i < chunks; i++) {
+		INIT_WORK(&pw[i].work, parallel_sort_work_fn);
+		pw[i].ps = &ps;
+		pw[i].lo = mult_frac(num, i, chunks);
+		pw[i].hi = mult_frac(num, i + 1, chunks);
+	}
+	parallel_sort_run(&ps, pw, chunks);
+
+	/* Run boundaries stay where the chunk boundaries were */
+	src = base;
+	dst = tmp;
+	for (n = chunks / 2; n; n /= 2) {
+		for (i = 0; i < n; i++) {
+			pw[i].lo = mult_frac(num, 2 * i, 2 * n);
+			pw[i].mid = mult_frac(num, 2 * i + 1, 2 * n);
+			pw[i].hi = mult_frac(num, 2 * i + 2, 2 * n);
+			pw[i].src = src;
+			pw[i].dst = dst;
+		}
+		parallel_sort_run(&ps, pw, n);
+		swap(src, dst);
+	}
+	if (src != base)
+		memcpy(base, src, num * size);
+
+	kfree(pw);
+	kvfree(tmp);
+	return;
+
+free_serial:
+	kfree(pw);
+	kvfree(tmp);
+serial:
+	sort_r(base, num, size, cmp_func, NULL, priv);
+}
+EXPORT_SYMBOL(sort_parallel);
@@ -22,6 +22,7 @@
 #include <linux/list.h>
 #include <linux/mm.h>
 #include <linux/mutex.h>
+#include <linux/percpu.h>
 #include <linux/poison.h>
 #include <linux/printk.h>
 #include <linux/rculist.h>
@@ -74,6 +75,37 @@ static LIST_HEAD(free_stacks);
 /* The lock must be held when performing pool or freelist modifications. */
 static DEFINE_RAW_SPINLOCK(pool_lock);
 
+/*
+ * Each CPU reserves a chunk of the current pool under pool_lock and carves
+ * stack records out of it without taking the lock.  The handle of a record
+ * only depends on its pool and offset, so records from different chunks of
+ * the same pool are indistinguishable from records allocated one by one.
+ */
+#define DEPOT_CHUNK_SIZE (DEPOT_POOL_SIZE / 4)
+
+struct depot_chunk {
+	u32 pool_index;
+	u32 offset;	/* Offset to the unused space in the chunk */
+	u32 end;	/* End of the chunk within the pool */
+};
+static DEFINE_PER_CPU(struct depot_chunk, depot_chunk);
+
+/*
+ * Insertion into and removal from hash table buckets is serialized by a
+ * small array of locks, indexed by the low bits of the hash.  There are
+ * always more buckets than locks, so a bucket maps to a single lock.
+ */
+#define DEPOT_BUCKET_LOCKS 256
+static raw_spinlock_t bucket_locks[DEPOT_BUCKET_LOCKS] = {
+	[0 ... DEPOT_BUCKET_LOCKS - 1] = __RAW_SPIN_LOCK_UNLOCKED(bucket_locks),
+};
+static_assert(DEPOT_BUCKET_LOCKS <= 1 << STACK_BUCKET_NUMBER_ORDER_MIN);
+
+static inline raw_spinlock_t *bucket_lock(u32 hash)
+{
+	return &bucket_locks[hash & (DEPOT_BUCKET_LOCKS - 1)];
+}
+
 /* Statistics counters for debugfs. */
 enum depot_counter_id {
 	DEPOT_COUNTER_REFD_ALLOCS,
@@ -82,9 +114,13 @@ enum depot_counter_id {
 	DEPOT_COUNTER_FREELIST_SIZE,
 	DEPOT_COUNTER_PERSIST_COUNT,
 	DEPOT_COUNTER_PERSIST_BYTES,
+	DEPOT_COUNTER_CHUNK_REFILLS,
 	DEPOT_COUNTER_COUNT,
 };
-static long counters[DEPOT_COUNTER_COUNT];
+struct depot_counters {
+	long count[DEPOT_COUNTER_COUNT];
+};
+static DEFINE_PER_CPU(struct depot_counters, counters);
 static const char *const counter_names[] = {
 	[DEPOT_COUNTER_REFD_ALLOCS]	= "refcounted_allocations",
 	[DEPOT_COUNTER_REFD_FREES]	= "refcounted_frees",
@@ -92,9 +128,15 @@ static const char *const counter_names[] = {
 	[DEPOT_COUNTER_FREELIST_SIZE]	= "freelist_size",
 	[DEPOT_COUNTER_PERSIST_COUNT]	= "persistent_count",
 	[DEPOT_COUNTER_PERSIST_BYTES]	= "persistent_bytes",
+	[DEPOT_COUNTER_CHUNK_REFILLS]	= "percpu_chunk_refills",
 };
 static_assert(ARRAY_SIZE(counter_names) == DEPOT_COUNTER_COUNT);
 
+static inline void depot_counter_add(enum depot_counter_id id, long val)
+{
+	this_cpu_add(counters.count[id], val);
+}
+
 static int __init disable_stack_depot(char *str)
 {
 	return kstrtobool(str, &stack_depot_disabled);
@@ -304,38 +346,65 @@ static void depot_keep_new_pool(void **prealloc)
 }
 
 /*
- * Try to initialize a new stack record from the current pool, a cached pool, or
- * the current pre-allocation.
+ * Reserve a new chunk for this CPU from the current pool, or from a new pool
+ * made of a cached pool or the current pre-allocation.
  */
+static bool depot_refill_chunk(struct depot_chunk *chunk, void **prealloc,
+			       size_t size)
+{
+	bool ret = false;
+
+	raw_spin_lock(&pool_lock);
+
+	if (pool_offset + size > DEPOT_POOL_SIZE) {
+		if (!depot_init_pool(prealloc))
+			goto out_unlock;
+	}
+
+	if (WARN_ON_ONCE(pools_num < 1))
+		goto out_unlock;
+
+	/* Whatever is left in the previous chunk stays unused. */
+	chunk->pool_index = pools_num - 1;
+	chunk->offset = pool_offset;
+	chunk->end = min_t(size_t, pool_offset + DEPOT_CHUNK_SIZE, DEPOT_POOL_SIZE);
+	pool_offset = chunk->end;
+
+	depot_counter_add(DEPOT_COUNTER_CHUNK_REFILLS, 1);
+	ret = true;
+
+out_unlock:
+	raw_spin_unlock(&pool_lock);
+	return ret;
+}
+
+/* Try to initialize a new stack record from the chunk of this CPU. */
 static struct stack_record *depot_pop_free_pool(void **prealloc, size_t size)
 {
+	struct depot_chunk *chunk = this_cpu_ptr(&depot_chunk);
 	struct stack_record *stack;
 	void *current_pool;
-	u32 pool_index;
 
-	lockdep_assert_held(&pool_lock);
+	lockdep_assert_irqs_disabled();
 
-	if (pool_offset + size > DEPOT_POOL_SIZE) {
-		if (!depot_init_pool(prealloc))
+	if (chunk->offset + size > chunk->end) {
+		if (!depot_refill_chunk(chunk, prealloc, size))
 			return NULL;
 	}
 
-	if (WARN_ON_ONCE(pools_num < 1))
-		return NULL;
-	pool_index = pools_num - 1;
-	current_pool = stack_pools[pool_index];
+	current_pool = stack_pools[chunk->pool_index];
 	if (WARN_ON_ONCE(!current_pool))
 		return NULL;
 
-	stack = current_pool + pool_offset;
+	stack = current_pool + chunk->offset;
 
 	/* Pre-initialize handle once. */
-	stack->handle.pool_index_plus_1 = pool_index + 1;
-	stack->handle.offset = pool_offset >> DEPOT_STACK_ALIGN;
+	stack->handle.pool_index_plus_1 = chunk->pool_index + 1;
+	stack->handle.offset = chunk->offset >> DEPOT_STACK_ALIGN;
 	stack->handle.extra = 0;
 	INIT_LIST_HEAD(&stack->hash_list);
 
-	pool_offset += size;
+	chunk->offset += size;
 
 	return stack;
 }
@@ -361,7 +430,7 @@ static struct stack_record *depot_pop_free(void)
 		return NULL;
 
 	list_del(&stack->free_list);
-	counters[DEPOT_COUNTER_FREELIST_SIZE]--;
+	depot_counter_add(DEPOT_COUNTER_FREELIST_SIZE, -1);
 
 	return stack;
 }
@@ -383,7 +452,7 @@ depot_alloc_stack(unsigned long *entries, unsigned int nr_entries, u32 hash, dep
 	struct stack_record *stack = NULL;
 	size_t record_size;
 
-	lockdep_assert_held(&pool_lock);
+	lockdep_assert_held(bucket_lock(hash));
 
 	/* This should already be checked by public API entry points. */
 	if (WARN_ON_ONCE(!nr_entries))
@@ -399,7 +468,11 @@ depot_alloc_stack(unsigned long *entries, unsigned int nr_entries, u32 hash, dep
 		 * safely be re-used by differently sized allocations.
 		 */
 		record_size = depot_stack_record_size(stack, CONFIG_STACKDEPOT_MAX_FRAMES);
-		stack = depot_pop_free();
+		if (!list_empty(&free_stacks)) {
+			raw_spin_lock(&pool_lock);
+			stack = depot_pop_free();
+			raw_spin_unlock(&pool_lock);
+		}
 	} else {
 		record_size = depot_stack_record_size(stack, nr_entries);
 	}
@@ -418,13 +491,13 @@ depot_alloc_stack(unsigned long *entries, unsigned int nr_entries, u32 hash, dep
 
 	if (flags & STACK_DEPOT_FLAG_GET) {
 		refcount_set(&stack->count, 1);
-		counters[DEPOT_COUNTER_REFD_ALLOCS]++;
-		counters[DEPOT_COUNTER_REFD_INUSE]++;
+		depot_counter_add(DEPOT_COUNTER_REFD_ALLOCS, 1);
+		depot_counter_add(DEPOT_COUNTER_REFD_INUSE, 1);
 	} else {
 		/* Warn on attempts to switch to refcounting this entry. */
 		refcount_set(&stack->count, REFCOUNT_SATURATED);
-		counters[DEPOT_COUNTER_PERSIST_COUNT]++;
-		counters[DEPOT_COUNTER_PERSIST_BYTES] += record_size;
+		depot_counter_add(DEPOT_COUNTER_PERSIST_COUNT, 1);
+		depot_counter_add(DEPOT_COUNTER_PERSIST_BYTES, record_size);
 	}
 
 	/*
@@ -467,11 +540,12 @@ static struct stack_record *depot_fetch_stack(depot_stack_handle_t handle)
 /* Links stack into the freelist. */
 static void depot_free_stack(struct stack_record *stack)
 {
+	raw_spinlock_t *lock = bucket_lock(stack->hash);
 	unsigned long flags;
 
 	lockdep_assert_not_held(&pool_lock);
 
-	raw_spin_lock_irqsave(&pool_lock, flags);
+	raw_spin_lock_irqsave(lock, flags);
 	printk_deferred_enter();
 
 	/*
@@ -481,6 +555,8 @@ static void depot_free_stack(struct stack_record *stack)
 	 */
 	list_del_rcu(&stack->hash_list);
 
+	raw_spin_lock(&pool_lock);
+
 	/*
 	 * Due to being used from constrained contexts such as the allocators,
 	 * NMI, or even RCU itself, stack depot cannot rely on primitives that
@@ -500,12 +576,14 @@ static void depot_free_stack(struct stack_record *stack)
 	 */
 	list_add_tail(&stack->free_list, &free_stacks);
 
-	counters[DEPOT_COUNTER_FREELIST_SIZE]++;
-	counters[DEPOT_COUNTER_REFD_FREES]++;
-	counters[DEPOT_COUNTER_REFD_INUSE]--;
+	raw_spin_unlock(&pool_lock);
+
+	depot_counter_add(DEPOT_COUNTER_FREELIST_SIZE, 1);
+	depot_counter_add(DEPOT_COUNTER_REFD_FREES, 1);
+	depot_counter_add(DEPOT_COUNTER_REFD_INUSE, -1);
 
 	printk_deferred_exit();
-	raw_spin_unlock_irqrestore(&pool_lock, flags);
+	raw_spin_unlock_irqrestore(lock, flags);
 }
 
 /* Calculates the hash for a stack. */
@@ -592,6 +670,7 @@ depot_stack_handle_t stack_depot_save_flags(unsigned long *entries,
 	struct page *page = NULL;
 	void *prealloc = NULL;
 	bool can_alloc = depot_flags & STACK_DEPOT_FLAG_CAN_ALLOC;
+	raw_spinlock_t *lock;
 	unsigned long flags;
 	u32 hash;
 
@@ -613,6 +692,7 @@ depot_stack_handle_t stack_depot_save_flags(unsigned long *entries,
 
 	hash = hash_stack(entries, nr_entries);
 	bucket = &stack_table[hash & stack_hash_mask];
+	lock = bucket_lock(hash);
 
 	/* Fast path: look the stack trace up without locking. */
 	found = find_stack(bucket, entries, nr_entries, hash, depot_flags);
@@ -630,7 +710,11 @@ depot_stack_handle_t stack_depot_save_flags(unsigned long *entries,
 			prealloc = page_address(page);
 	}
 
-	raw_spin_lock_irqsave(&pool_lock, flags);
+	/*
+	 * Only the bucket is locked: the record comes from this CPU's chunk,
+	 * and pool_lock is taken only to refill it.
+	 */
+	raw_spin_lock_irqsave(lock, flags);
 	printk_deferred_enter();
 
 	/* Try to find again, to avoid concurrently inserting duplicates. */
@@ -655,11 +739,13 @@ depot_stack_handle_t stack_depot_save_flags(unsigned long *entries,
 		 * depot_alloc_stack() did not consume the preallocated memory.
 		 * Try to keep the preallocated memory for future.
 		 */
+		raw_spin_lock(&pool_lock);
 		depot_keep_new_pool(&prealloc);
+		raw_spin_unlock(&pool_lock);
 	}
 
 	printk_deferred_exit();
-	raw_spin_unlock_irqrestore(&pool_lock, flags);
+	raw_spin_unlock_irqrestore(lock, flags);
 exit:
 	if (prealloc) {
 		/* Stack depot didn't use this memory, free it. */
@@ -788,8 +874,14 @@ static int stats_show(struct seq_file *seq, void *v)
 	 * statistics are ok for debugging.
 	 */
 	seq_printf(seq, "pools: %d\n", data_race(pools_num));
-	for (int i = 0; i < DEPOT_COUNTER_COUNT; i++)
-		seq_printf(seq, "%s: %ld\n", counter_names[i], data_race(counters[i]));
+	for (int i = 0; i < DEPOT_COUNTER_COUNT; i++) {
+		long sum = 0;
+		int cpu;
+
+		for_each_possible_cpu(cpu)
+			sum += data_race(per_cpu(counters, cpu).count[i]);
+		seq_printf(seq, "%s: %ld\n", counter_names[i], sum);
+	}
 
 	return 0;
 }
@@ -8,6 +8,8 @@
 #include <linux/printk.h>
 #include <linux/slab.h>
 #include <linux/random.h>
+#include <linux/ktime.h>
+#include <linux/vmalloc.h>
 
 /*
  * The pattern of set bits in the list length determines which cases
@@ -107,8 +109,74 @@ static void list_sort_test(struct kunit *test)
 			    "list length changed after sorting!");
 }
 
+#define TEST_BENCH_LEN (1 << 18)
+
+struct bench_el {
+	struct list_head list;
+	u32 value;
+};
+
+static int bench_cmp(void *priv, const struct list_head *a,
+		     const struct list_head *b)
+{
+	const struct bench_el *ela = container_of(a, struct bench_el, list);
+	const struct bench_el *elb = container_of(b, struct bench_el, list);
+
+	return ela->value < elb->value ? -1 : ela->value > elb->value;
+}
+
+static void bench_vfree(void *p)
+{
+	vfree(p);
+}
+
+/*
+ * Not a pass/fail test, reports how long list_sort() takes on a list of the
+ * size the array sorts are benchmarked with in test_sort.c.  The elements
+ * are linked in a random order, as they would be after a while in a real
+ * list, so the walk misses the cache like it would there.
+ */
+static void list_sort_bench(struct kunit *test)
+{
+	struct bench_el *els;
+	struct list_head *cur;
+	u32 i, j, *order;
+	LIST_HEAD(head);
+	u64 t0, t;
+
+	els = vmalloc_array(TEST_BENCH_LEN, sizeof(*els));
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, els);
+	KUNIT_ASSERT_EQ(test, kunit_add_action_or_reset(test, bench_vfree, els), 0);
+	order = vmalloc_array(TEST_BENCH_LEN, sizeof(*order));
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, order);
+	KUNIT_ASSERT_EQ(test, kunit_add_action_or_reset(test, bench_vfree, order), 0);
+
+	for (i = 0; i < TEST_BENCH_LEN; i++)
+		order[i] = i;
+	for (i = TEST_BENCH_LEN - 1; i > 0; i--) {
+		j = get_random_u32_below(i + 1);
+		swap(order[i], order[j]);
+	}
+
+	for (i = 0; i < TEST_BENCH_LEN; i++) {
+		els[order[i]].value = get_random_u32();
+		list_add_tail(&els[order[i]].list, &head);
+	}
+
+	t0 = ktime_get_ns();
+	list_sort(NULL, &head, bench_cmp);
+	t = ktime_get_ns() - t0;
+
+	for (cur = head.next; cur->next != &head; cur = cur->next)
+		KUNIT_ASSERT_LE(test, bench_cmp(NULL, cur, cur->next), 0);
+
+	kunit_info(test, "%d elements: list_sort %llu us\n", TEST_BENCH_LEN,
+		   t / NSEC_PER_USEC);
+}
+
 static struct kunit_case list_sort_cases[] = {
 	KUNIT_CASE(list_sort_test),
+	KUNIT_CASE_SLOW(list_sort_bench),
 	{}
 };
 
@@ -55,6 +55,10 @@ static bool enomem_retry = false;
 module_param(enomem_retry, bool, 0);
 MODULE_PARM_DESC(enomem_retry, "Retry insert even if -ENOMEM was returned (default: off)");
 
+static bool lockless = false;
+module_param(lockless, bool, 0);
+MODULE_PARM_DESC(lockless, "Insert without taking the bucket lock where possible (default: off)");
+
 struct test_obj_val {
 	int	id;
 	int	tid;
@@ -75,6 +79,7 @@ struct thread_data {
 	int id;
 	struct task_struct *task;
 	struct test_obj *objs;
+	u64 insert_ns;
 };
 
 static u32 my_hashfn(const void *data, u32 len, u32 seed)
@@ -618,6 +623,7 @@ static int threadfunc(void *data)
 {
 	int i, step, err = 0, insert_retries = 0;
 	struct thread_data *tdata = data;
+	u64 start;
 
 	if (atomic_dec_and_test(&startup_count))
 		wake_up(&startup_wait);
@@ -626,6 +632,7 @@ static int threadfunc(void *data)
 		goto out;
 	}
 
+	start = ktime_get_ns();
 	for (i = 0; i < tdata->entries; i++) {
 		tdata->objs[i].value.id = i;
 		tdata->objs[i].value.tid = tdata->id;
@@ -638,6 +645,7 @@ static int threadfunc(void *data)
 			goto out;
 		}
 	}
+	tdata->insert_ns = ktime_get_ns() - start;
 	if (insert_retries)
 		pr_info("  thread[%d]: %u insertions retried due to memory pressure\n",
 			tdata->id, insert_retries);
@@ -683,7 +691,7 @@ static int __init test_rht_init(void)
 {
 	unsigned int entries;
 	int i, err, started_threads = 0, failed_threads = 0;
-	u64 total_time = 0;
+	u64 total_time = 0, insert_max = 0;
 	struct thread_data *tdata;
 	struct test_obj *objs;
 
@@ -693,6 +701,7 @@ static int __init test_rht_init(void)
 	entries = min(parm_entries, MAX_ENTRIES);
 
 	test_rht_params.automatic_shrinking = shrinking;
+	test_rht_params.lockless_insert = lockless;
 	test_rht_params.max_size = max_size ? : roundup_pow_of_two(entries);
 	test_rht_params.nelem_hint = size;
 
@@ -701,8 +710,8 @@ static int __init test_rht_init(void)
 	if (!objs)
 		return -ENOMEM;
 
-	pr_info("Running rhashtable test nelem=%d, max_size=%d, shrinking=%d\n",
-		size, max_size, shrinking);
+	pr_info("Running rhashtable test nelem=%d, max_size=%d, shrinking=%d, lockless=%d\n",
+		size, max_size, shrinking, lockless);
 
 	for (i = 0; i < runs; i++) {
 		s64 time;
@@ -789,7 +798,10 @@ static int __init test_rht_init(void)
 			        i, err);
 			failed_threads++;
 		}
+		insert_max = max(insert_max, tdata[i].insert_ns);
 	}
+	pr_info("Concurrent insertion of %u entries took %llu ns\n",
+		tcount * entries, insert_max);
 	rhashtable_destroy(&ht);
 	vfree(tdata);
 	vfree(objs);
@@ -5,6 +5,9 @@
 #include <linux/sort.h>
 #include <linux/slab.h>
 #include <linux/module.h>
+#include <linux/random.h>
+#include <linux/vmalloc.h>
+#include <linux/ktime.h>
 
 /* a simple boot-time regression test */
 
@@ -45,8 +48,160 @@ static void test_sort(struct kunit *test)
 		KUNIT_ASSERT_LE(test, a[i], a[i + 1]);
 }
 
+#define TEST_LARGE_LEN (1 << 18)
+
+struct test_el {
+	u32 key;
+	u32 serial;
+};
+
+static u64 test_el_key(const void *a)
+{
+	return ((const struct test_el *)a)->key;
+}
+
+static int test_el_cmp(const void *a, const void *b, const void *priv)
+{
+	const struct test_el *ea = a, *eb = b;
+
+	return ea->key < eb->key ? -1 : ea->key > eb->key;
+}
+
+static void test_vfree(void *p)
+{
+	vfree(p);
+}
+
+static void *test_vmalloc(struct kunit *test, size_t bytes)
+{
+	void *p = vmalloc(bytes);
+
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, p);
+	KUNIT_ASSERT_EQ(test, kunit_add_action_or_reset(test, test_vfree, p), 0);
+	return p;
+}
+
+static struct test_el *test_alloc_els(struct kunit *test, size_t num,
+				      u32 key_mask)
+{
+	struct test_el *a;
+	size_t i;
+
+	a = test_vmalloc(test, num * sizeof(*a));
+
+	for (i = 0; i < num; i++) {
+		a[i].key = get_random_u32() & key_mask;
+		a[i].serial = i;
+	}
+	return a;
+}
+
+/*
+ * Sorted by the key bits in @key_mask, and still a permutation of the
+ * serial numbers
+ */
+static void test_check_els_masked(struct kunit *test, struct test_el *a,
+				  size_t num, u32 key_mask)
+{
+	unsigned long *seen;
+	size_t i;
+
+	seen = kunit_kcalloc(test, BITS_TO_LONGS(num), sizeof(long), GFP_KERNEL);
+	KUNIT_ASSERT_NOT_ERR_OR_NULL(test, seen);
+
+	for (i = 0; i < num; i++) {
+		if (i)
+			KUNIT_ASSERT_LE(test, a[i - 1].key & key_mask,
+					a[i].key & key_mask);
+		KUNIT_ASSERT_LT(test, a[i].serial, num);
+		KUNIT_ASSERT_FALSE(test, __test_and_set_bit(a[i].serial, seen));
+	}
+}
+
+static void test_check_els(struct kunit *test, struct test_el *a, size_t num)
+{
+	test_check_els_masked(test, a, num, U32_MAX);
+}
+
+static void test_sort_radix(struct kunit *test)
+{
+	/* Full keys, keys with constant digits and few distinct keys */
+	static const u32 masks[] = { U32_MAX, 0x00ff0f00, 0x7 };
+	static const size_t lens[] = { 1, 2, 63, 64, 1000, 65537 };
+	struct test_el *a;
+	size_t i, j, num;
+
+	for (i = 0; i < ARRAY_SIZE(masks); i++) {
+		for (j = 0; j < ARRAY_SIZE(lens); j++) {
+			num = lens[j];
+			a = test_alloc_els(test, num, masks[i]);
+			sort_radix(a, num, sizeof(*a), test_el_key, 32);
+			test_check_els(test, a, num);
+		}
+	}
+
+	/*
+	 * Only the low key_bits count, both for the radix passes and for
+	 * the heapsort used below RADIX_MIN elements.
+	 */
+	for (j = 0; j < ARRAY_SIZE(lens); j++) {
+		num = lens[j];
+		a = test_alloc_els(test, num, U32_MAX);
+		sort_radix(a, num, sizeof(*a), test_el_key, 12);
+		test_check_els_masked(test, a, num, GENMASK(11, 0));
+	}
+}
+
+static void test_sort_parallel(struct kunit *test)
+{
+	static const size_t lens[] = { 1, 1000, 8192 * 2 + 1, TEST_LARGE_LEN + 3 };
+	struct test_el *a;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(lens); i++) {
+		a = test_alloc_els(test, lens[i], U32_MAX);
+		sort_parallel(a, lens[i], sizeof(*a), test_el_cmp, NULL);
+		test_check_els(test, a, lens[i]);
+	}
+}
+
+/* Not a pass/fail test, reports the time each sort takes on a large array */
+static void test_sort_bench(struct kunit *test)
+{
+	struct test_el *a, *orig;
+	u64 t0, t_heap, t_radix, t_par;
+	size_t bytes = TEST_LARGE_LEN * sizeof(*a);
+
+	orig = test_alloc_els(test, TEST_LARGE_LEN, U32_MAX);
+	a = test_vmalloc(test, bytes);
+
+	memcpy(a, orig, bytes);
+	t0 = ktime_get_ns();
+	sort_r(a, TEST_LARGE_LEN, sizeof(*a), test_el_cmp, NULL, NULL);
+	t_heap = ktime_get_ns() - t0;
+
+	memcpy(a, orig, bytes);
+	t0 = ktime_get_ns();
+	sort_radix(a, TEST_LARGE_LEN, sizeof(*a), test_el_key, 32);
+	t_radix = ktime_get_ns() - t0;
+	test_check_els(test, a, TEST_LARGE_LEN);
+
+	memcpy(a, orig, bytes);
+	t0 = ktime_get_ns();
+	sort_parallel(a, TEST_LARGE_LEN, sizeof(*a), test_el_cmp, NULL);
+	t_par = ktime_get_ns() - t0;
+	test_check_els(test, a, TEST_LARGE_LEN);
+
+	kunit_info(test, "%d elements: sort_r %llu us, sort_radix %llu us, sort_parallel %llu us on %u CPUs\n",
+		   TEST_LARGE_LEN, t_heap / NSEC_PER_USEC, t_radix / NSEC_PER_USEC,
+		   t_par / NSEC_PER_USEC, num_online_cpus());
+}
+
 static struct kunit_case sort_test_cases[] = {
 	KUNIT_CASE(test_sort),
+	KUNIT_CASE(test_sort_radix),
+	KUNIT_CASE(test_sort_parallel),
+	KUNIT_CASE_SLOW(test_sort_bench),
 	{}
 };
 
@@ -0,0 +1,162 @@
+// SPDX-License-Identifier: GPL-2.0-only
+/*
+ * Stack depot benchmark
+ *
+ * Saves synthetic stack traces from a thread on each online CPU at the same
+ * time, like allocation profiling does on a busy machine, and reports how
+ * long a save takes.  Each thread picks stacks at random from a shared set
+ * of nr_stacks, so the first round mostly inserts and later ones mostly look
+ * up.  With evict=1 the stacks are saved refcounted and put right away,
+ * which exercises the freelist instead.
+ *
+ * The test runs at module load time:
+ *   modprobe test_stackdepot nr_stacks=65536 saves=1000000 evict=0
+ *
+ * The stacks are made up and never printed.  Unless evict is set, they stay
+ * in stack depot until reboot, nr_stacks * (depth * sizeof(long) + 32) bytes.
+ */
+
+#define pr_fmt(fmt) KBUILD_MODNAME ": " fmt
+
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/stackdepot.h>
+
+#define BENCH_DEPTH_MAX	32
+
+static unsigned int nr_stacks = 16384;
+module_param(nr_stacks, uint, 0444);
+MODULE_PARM_DESC(nr_stacks, "Number of distinct stacks");
+
+static unsigned int depth = 16;
+module_param(depth, uint, 0444);
+MODULE_PARM_DESC(depth, "Number of frames per stack");
+
+static unsigned int saves = 200000;
+module_param(saves, uint, 0444);
+MODULE_PARM_DESC(saves, "Number of saves per CPU");
+
+static bool evict;
+module_param(evict, bool, 0444);
+MODULE_PARM_DESC(evict, "Save refcounted stacks and put them again");
+
+struct bench_thread {
+	unsigned int cpu;
+	bool started;
+	u64 ns;
+	unsigned int failed;
+	struct completion done;
+};
+
+static void bench_fill(unsigned long *entries, u32 idx)
+{
+	unsigned int i;
+
+	/* Distinct and never in the irqentry text, which is all that matters */
+	for (i = 0; i < depth; i++)
+		entries[i] = ((unsigned long)idx << 8) | (i + 1);
+}
+
+static int bench_thread_fn(void *data)
+{
+	struct bench_thread *bt = data;
+	unsigned long entries[BENCH_DEPTH_MAX];
+	depot_flags_t flags = STACK_DEPOT_FLAG_CAN_ALLOC;
+	depot_stack_handle_t handle;
+	u32 state = bt->cpu * 2654435761U + 1;
+	unsigned int i;
+	u64 start;
+
+	if (evict)
+		flags |= STACK_DEPOT_FLAG_GET;
+
+	start = ktime_get_ns();
+	for (i = 0; i < saves; i++) {
+		/* xorshift32 */
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+
+		bench_fill(entries, state % nr_stacks);
+		handle = stack_depot_save_flags(entries, depth, GFP_KERNEL, flags);
+		if (!handle)
+			bt->failed++;
+		else if (evict)
+			stack_depot_put(handle);
+
+		if (!(i & 1023))
+			cond_resched();
+	}
+	bt->ns = ktime_get_ns() - start;
+
+	kthread_complete_and_exit(&bt->done, 0);
+}
+
+static int __init stackdepot_bench_init(void)
+{
+	struct bench_thread *bts;
+	struct task_struct *tsk;
+	unsigned int cpu, n = 0;
+	u64 total_ns = 0, max_ns = 0;
+	unsigned long failed = 0;
+	int ret;
+
+	if (!nr_stacks || !saves || !depth || depth > BENCH_DEPTH_MAX)
+		return -EINVAL;
+
+	ret = stack_depot_init();
+	if (ret)
+		return ret;
+
+	bts = kcalloc(nr_cpu_ids, sizeof(*bts), GFP_KERNEL);
+	if (!bts)
+		return -ENOMEM;
+
+	cpus_read_lock();
+	for_each_online_cpu(cpu) {
+		bts[cpu].cpu = cpu;
+		init_completion(&bts[cpu].done);
+		tsk = kthread_create_on_cpu(bench_thread_fn, &bts[cpu], cpu,
+					    "stackdepot_bench/%u");
+		if (IS_ERR(tsk)) {
+			ret = PTR_ERR(tsk);
+			break;
+		}
+		bts[cpu].started = true;
+		wake_up_process(tsk);
+		n++;
+	}
+	cpus_read_unlock();
+
+	for_each_possible_cpu(cpu) {
+		if (!bts[cpu].started)
+			continue;
+		wait_for_completion(&bts[cpu].done);
+		total_ns += bts[cpu].ns;
+		max_ns = max(max_ns, bts[cpu].ns);
+		failed += bts[cpu].failed;
+	}
+
+	if (n)
+		pr_info("%u threads, %u stacks of %u frames%s: %llu ns per save, %llu ms wall, %lu failed\n",
+			n, nr_stacks, depth, evict ? ", evicting" : "",
+			div64_u64(total_ns, (u64)n * saves),
+			div_u64(max_ns, NSEC_PER_MSEC), failed);
+
+	kfree(bts);
+	return ret;
+}
+
+static void __exit stackdepot_bench_exit(void)
+{
+}
+
+module_init(stackdepot_bench_init);
+module_exit(stackdepot_bench_exit);
+
+MODULE_DESCRIPTION("Stack depot benchmark");
+MODULE_LICENSE("GPL");
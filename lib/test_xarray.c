@@ -1783,6 +1783,130 @@ static noinline void check_store_range(struct xarray *xa)
 	}
 }
 
+#define STORE_MANY_MAX	300
+static void *store_many_entries[STORE_MANY_MAX];
+static void *load_many_entries[STORE_MANY_MAX];
+
+static noinline void __check_store_many(struct xarray *xa, unsigned long first,
+		unsigned int nr)
+{
+	unsigned int i, present = 0;
+
+	for (i = 0; i < nr; i++) {
+		/* Leave every seventh index empty */
+		store_many_entries[i] = (i % 7 == 6) ? NULL :
+					xa_mk_index(first + i);
+		present += store_many_entries[i] != NULL;
+	}
+
+	XA_BUG_ON(xa, xa_store_many(xa, first, store_many_entries, nr,
+				GFP_KERNEL) != 0);
+	for (i = 0; i < nr; i++)
+		XA_BUG_ON(xa, xa_load(xa, first + i) != store_many_entries[i]);
+	if (first)
+		XA_BUG_ON(xa, xa_load(xa, first - 1) != NULL);
+	XA_BUG_ON(xa, xa_load(xa, first + nr) != NULL);
+
+	XA_BUG_ON(xa, xa_load_many(xa, first, load_many_entries, nr) !=
+			present);
+	for (i = 0; i < nr; i++)
+		XA_BUG_ON(xa, load_many_entries[i] != store_many_entries[i]);
+
+	/* Overwrite with NULL entries to erase the range again */
+	for (i = 0; i < nr; i++)
+		store_many_entries[i] = NULL;
+	XA_BUG_ON(xa, xa_store_many(xa, first, store_many_entries, nr,
+				GFP_KERNEL) != 0);
+	XA_BUG_ON(xa, xa_load_many(xa, first, load_many_entries, nr) != 0);
+	/* Allocating arrays keep NULL stores as reserved entries */
+	if (!xa_track_free(xa))
+		XA_BUG_ON(xa, !xa_empty(xa));
+	xa_destroy(xa);
+}
+
+static noinline void check_store_many(struct xarray *xa)
+{
+	unsigned int nr;
+
+	XA_BUG_ON(xa, xa_store_many(xa, ULONG_MAX, store_many_entries, 2,
+				GFP_KERNEL) != -EINVAL);
+	/* A wrapping load must not pick up the entry at index 0 */
+	xa_store_index(xa, 0, GFP_KERNEL);
+	XA_BUG_ON(xa, xa_load_many(xa, ULONG_MAX, load_many_entries, 2) != 0);
+	xa_erase_index(xa, 0);
+	XA_BUG_ON(xa, xa_store_many(xa, 0, store_many_entries, 0,
+				GFP_KERNEL) != 0);
+	XA_BUG_ON(xa, !xa_empty(xa));
+
+	for (nr = 1; nr <= STORE_MANY_MAX; nr += 37) {
+		__check_store_many(xa, 0, nr);
+		__check_store_many(xa, 1, nr);
+		__check_store_many(xa, 63, nr);
+		__check_store_many(xa, 4095, nr);
+		__check_store_many(xa, (1UL << 24) - 5, nr);
+		__check_store_many(xa, ULONG_MAX - nr + 1, nr);
+	}
+
+#ifdef CONFIG_XARRAY_MULTI
+	/* Loading across a multi-index entry returns it for every index */
+	xa_store_order(xa, 64, 4, xa_mk_index(64), GFP_KERNEL);
+	XA_BUG_ON(xa, xa_load_many(xa, 60, load_many_entries, 24) != 16);
+	for (nr = 0; nr < 24; nr++)
+		XA_BUG_ON(xa, load_many_entries[nr] !=
+				((nr >= 4 && nr < 20) ? xa_mk_index(64) : NULL));
+	xa_destroy(xa);
+#endif
+}
+
+#ifdef __KERNEL__
+#include <linux/ktime.h>
+
+/*
+ * Compare filling and reading back a run of consecutive indices one entry
+ * at a time against the bulk interfaces.
+ */
+static noinline void bench_store_many(struct xarray *xa)
+{
+	const unsigned int nr = STORE_MANY_MAX;
+	const unsigned int loops = 200;
+	u64 t0, t_store = 0, t_store_many = 0, t_load = 0, t_load_many = 0;
+	unsigned int i, j;
+
+	for (i = 0; i < nr; i++)
+		store_many_entries[i] = xa_mk_index(i);
+
+	for (j = 0; j < loops; j++) {
+		unsigned long first = j * 4096UL;
+
+		t0 = ktime_get_ns();
+		for (i = 0; i < nr; i++)
+			xa_store(xa, first + i, store_many_entries[i],
+					GFP_KERNEL);
+		t_store += ktime_get_ns() - t0;
+
+		t0 = ktime_get_ns();
+		for (i = 0; i < nr; i++)
+			load_many_entries[i] = xa_load(xa, first + i);
+		t_load += ktime_get_ns() - t0;
+		xa_destroy(xa);
+
+		t0 = ktime_get_ns();
+		xa_store_many(xa, first, store_many_entries, nr, GFP_KERNEL);
+		t_store_many += ktime_get_ns() - t0;
+
+		t0 = ktime_get_ns();
+		xa_load_many(xa, first, load_many_entries, nr);
+		t_load_many += ktime_get_ns() - t0;
+		xa_destroy(xa);
+	}
+
+	printk("XArray: %u x %u entries: xa_store %llu ns, xa_store_many %llu ns, xa_load %llu ns, xa_load_many %llu ns\n",
+			loops, nr, t_store, t_store_many, t_load, t_load_many);
+}
+#else
+static void bench_store_many(struct xarray *xa) { }
+#endif
+
 #ifdef CONFIG_XARRAY_MULTI
 static void check_split_1(struct xarray *xa, unsigned long index,
 				unsigned int order, unsigned int new_order)
@@ -2154,6 +2278,8 @@ static int xarray_checks(void)
 	check_move(&array);
 	check_create_range(&array);
 	check_store_range(&array);
+	check_store_many(&array);
+	check_store_many(&xa0);
 	check_store_iter(&array);
 	check_align(&xa0);
 	check_split(&array);
@@ -2162,6 +2288,8 @@ static int xarray_checks(void)
 	check_workingset(&array, 64);
 	check_workingset(&array, 4096);
 
+	bench_store_many(&array);
+
 	printk("XArray: %u of %u tests passed\n", tests_passed, tests_run);
 	return (tests_run == tests_passed) ? 0 : -EINVAL;
 }
@@ -1765,6 +1765,62 @@ void *xa_store_range(struct xarray *xa, unsigned long first,
 }
 EXPORT_SYMBOL(xa_store_range);
 
+/**
+ * xa_store_many() - Store consecutive entries in the XArray.
+ * @xa: XArray.
+ * @first: Index of the first entry.
+ * @entries: Array of @nr entries to store.
+ * @nr: Number of entries.
+ * @gfp: Memory allocation flags.
+ *
+ * Stores @entries[i] at index @first + i.  This is equivalent to calling
+ * xa_store() for each index, but walks the tree only once: successive
+ * entries in the same node are stored without descending from the root
+ * again, and the xa_lock is only dropped to allocate memory.
+ *
+ * Context: Any context.  Takes and releases the xa_lock.
+ * May sleep if the @gfp flags permit.
+ * Return: 0 on success, -EINVAL if an entry cannot be stored in an XArray
+ * or the range wraps, -ENOMEM if memory allocation failed.  On failure,
+ * the entries before the failing index have been stored.
+ */
+int xa_store_many(struct xarray *xa, unsigned long first,
+		void * const *entries, unsigned int nr, gfp_t gfp)
+{
+	XA_STATE(xas, xa, first);
+	unsigned int i;
+
+	if (!nr)
+		return 0;
+	if (first + nr - 1 < first)
+		return -EINVAL;
+	for (i = 0; i < nr; i++)
+		if (WARN_ON_ONCE(xa_is_advanced(entries[i])))
+			return -EINVAL;
+
+	i = 0;
+	do {
+		xas_lock(&xas);
+		while (i < nr) {
+			void *entry = entries[i];
+
+			if (xa_track_free(xa) && !entry)
+				entry = XA_ZERO_ENTRY;
+			xas_store(&xas, entry);
+			if (xas_error(&xas))
+				break;
+			if (xa_track_free(xa))
+				xas_clear_mark(&xas, XA_FREE_MARK);
+			if (++i < nr)
+				xas_next(&xas);
+		}
+		xas_unlock(&xas);
+	} while (xas_nomem(&xas, gfp));
+
+	return xas_error(&xas);
+}
+EXPORT_SYMBOL(xa_store_many);
+
 /**
  * xas_get_order() - Get the order of an entry.
  * @xas: XArray operation state.
@@ -2204,6 +2260,61 @@ unsigned int xa_extract(struct xarray *xa, void **dst, unsigned long start,
 }
 EXPORT_SYMBOL(xa_extract);
 
+/**
+ * xa_load_many() - Load consecutive entries from the XArray.
+ * @xa: XArray.
+ * @first: Index of the first entry.
+ * @entries: Array to fill with @nr entries.
+ * @nr: Number of entries.
+ *
+ * Sets @entries[i] to the entry at index @first + i, or %NULL if there is
+ * no entry at that index.  Unlike xa_extract(), absent entries are not
+ * skipped, so the position in @entries always matches the index.  The
+ * tree is walked only once for the whole range.
+ *
+ * As with xa_extract(), the entries returned may not represent a snapshot
+ * of the XArray at a moment in time.
+ *
+ * Context: Any context.  Takes and releases the RCU lock.
+ * Return: The number of non-%NULL entries loaded.  If the range wraps past
+ * %ULONG_MAX, nothing is loaded, @entries is left untouched and 0 is returned.
+ */
+unsigned int xa_load_many(struct xarray *xa, unsigned long first,
+		void **entries, unsigned int nr)
+{
+	XA_STATE(xas, xa, first);
+	unsigned int i = 0, found = 0;
+	void *entry;
+
+	if (!nr)
+		return 0;
+	if (first + nr - 1 < first)
+		return 0;
+
+	rcu_read_lock();
+	entry = xas_load(&xas);
+	for (;;) {
+		if (xa_is_retry(entry)) {
+			xas_reset(&xas);
+			entry = xas_load(&xas);
+			continue;
+		}
+		if (xa_is_sibling(entry))
+			entry = xa_entry(xa, xas.xa_node, xa_to_sibling(entry));
+		if (xa_is_zero(entry))
+			entry = NULL;
+		entries[i] = entry;
+		found += !!entry;
+		if (++i == nr)
+			break;
+		entry = xas_next(&xas);
+	}
+	rcu_read_unlock();
+
+	return found;
+}
+EXPORT_SYMBOL(xa_load_many);
+
 /**
  * xa_delete_node() - Private interface for workingset code.
  * @node: Node to be removed from the tree.
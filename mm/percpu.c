@@ -1704,8 +1704,8 @@ static void pcpu_alloc_tag_alloc_hook(struct pcpu_chunk *chunk, int off,
 				      size_t size)
 {
 	if (mem_alloc_profiling_enabled() && likely(chunk->obj_exts)) {
-		alloc_tag_add(&chunk->obj_exts[off >> PCPU_MIN_ALLOC_SHIFT].tag,
-			      current->alloc_tag, size);
+		alloc_tag_add_sampled(&chunk->obj_exts[off >> PCPU_MIN_ALLOC_SHIFT].tag,
+				      current->alloc_tag, size);
 	}
 }
 
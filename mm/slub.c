@@ -2094,7 +2094,7 @@ alloc_tagging_slab_alloc_hook(struct kmem_cache *s, void *object, gfp_t flags)
 		 * check should be added before alloc_tag_add().
 		 */
 		if (likely(obj_exts))
-			alloc_tag_add(&obj_exts->ref, current->alloc_tag, s->size);
+			alloc_tag_add_sampled(&obj_exts->ref, current->alloc_tag, s->size);
 	}
 }
 